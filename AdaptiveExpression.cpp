@@ -0,0 +1,8 @@
+#include "AdaptiveExpression.h"
+
+//The adaptive expressions of the standard numeric policies are instantiated
+//here once rather than in every file that uses them
+
+#define EVALUATOR_INSTANTIATE_ADAPTIVE(P) template class BasicAdaptiveExpression<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_ADAPTIVE)
+#undef EVALUATOR_INSTANTIATE_ADAPTIVE
\ No newline at end of file
@@ -0,0 +1,366 @@
+#ifndef ADAPTIVE_EXPRESSION_H
+#define ADAPTIVE_EXPRESSION_H
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Arena.h"
+#include "Ast.h"
+#include "CompiledExpression.h"
+#include "EvalError.h"
+#include "Evaluator.h"
+#include "NumericPolicy.h"
+#include "Operations.h"
+#include "SmallStack.h"
+#include "Translator.h"
+
+//What a BasicAdaptiveExpression has observed about one operand of an && or
+//|| chain
+struct AdaptiveClauseStats {
+    size_t chain = 0;        ///< Chain the operand belongs to (0 is the outermost)
+    Op op = Op::And;         ///< And or Or
+    size_t slot = 0;         ///< Place in the chain's current evaluation order
+    uint32_t position = 0;   ///< Source offset where the operand starts
+    bool pinned = false;     ///< Can raise an error, so it keeps its written place
+    uint64_t evaluated = 0;  ///< Times evaluated (halved at every reorder)
+    uint64_t passed = 0;     ///< Times it didn't decide the chain (true for &&, false for ||)
+    double cost = 0;         ///< Instructions executed per evaluation
+    double rank = 0;         ///< Expected cost per decision; lower ranks are evaluated first
+};
+
+//class BasicAdaptiveExpression
+//A compiled expression whose && / || chains reorder their operands to the
+//data they see, the way a database orders predicates: every operand counts
+//the instructions it executes and how often it lets the chain continue,
+//and every ReorderInterval runs each chain is sorted so the operands that
+//decide it most cheaply come first. Statistics decay at each reorder, so
+//the order follows data that drifts.
+//
+//Reordering never changes a result: a chain is 0 or 1 whatever its order.
+//Operands that can raise an error (division by an unknown divisor,
+//overflow under a checked policy, ...) are pinned: nothing moves across
+//them, so they run in exactly the cases they ran as written. Runs with
+//unbound variables use the program as written.
+//
+//run() updates the statistics, so an adaptive expression is used by one
+//thread at a time; give each thread its own copy.
+template <class Policy>
+class BasicAdaptiveExpression {
+public:
+    using value_type = typename Policy::value_type;
+    using Compiled = BasicCompiledExpression<Policy>;
+
+    //Runs between reorders
+    static constexpr uint64_t ReorderInterval = 1024;
+
+    //Chains nested deeper than this are compiled as single operands
+    static constexpr size_t MaxChainNesting = 32;
+
+private:
+    using Node = BasicNode<value_type>;
+
+    //An operand of a chain: a nested chain or a program
+    struct Clause {
+        int chain = -1;          ///< Nested chain, or -1 for a program
+        uint32_t first = 0;      ///< Program: first instruction in code
+        uint32_t count = 0;      ///< Program: number of instructions
+        uint32_t position = 0;   ///< Source offset where the operand starts
+        bool pinned = false;     ///< Can raise an error with every variable bound
+        uint64_t estimate = 0;   ///< Instructions, for ranking before it was ever evaluated
+        uint64_t evaluated = 0;  ///< Times evaluated
+        uint64_t passed = 0;     ///< Times it didn't decide its chain
+        uint64_t cost = 0;       ///< Instructions executed over those evaluations
+    };
+
+    //Operands joined by one operator, in their current evaluation order
+    struct Chain {
+        Op op;
+        std::vector<uint32_t> order;  ///< Indices in clauses
+    };
+
+    Compiled compiled;                  ///< The whole expression as written
+    std::vector<Instruction> code;      ///< Programs of every program operand
+    std::vector<value_type> constants;  ///< Literals of those programs
+    std::vector<Clause> clauses;
+    std::vector<Chain> chains;
+    int root = -1;                      ///< Clause of the whole expression, -1 if it is empty
+    std::vector<value_type> stack;      ///< Operand stack shared by the programs
+    uint64_t runs = 0;
+    uint64_t reorderCount = 0;
+
+    //Can evaluating a subtree raise an error once every variable is bound?
+    static bool mayFaultWhenBound(const Node* node);
+
+    //Turn a subtree into a clause; returns its index
+    uint32_t build(const Node* node, size_t nesting);
+
+    //Evaluate a clause, adding the instructions it executes to cost
+    value_type evaluate(uint32_t clause, std::span<const value_type> variables, uint64_t& cost);
+
+    //Expected cost of a clause per decision of its chain
+    static double rank(const Clause& clause);
+
+public:
+    //Compile an expression (throws EvalError on a syntax error)
+    explicit BasicAdaptiveExpression(std::string_view expr);
+
+    //Execute the expression with values for its variables (in variables()
+    //order); same result or error as BasicCompiledExpression::run
+    value_type run(std::span<const value_type> variables = {});
+
+    //Reorder every chain by the statistics so far (run() does this every
+    //ReorderInterval runs) and halve the statistics
+    void reorder();
+
+    //Statistics of every chain operand, chain by chain in evaluation order
+    std::vector<AdaptiveClauseStats> statistics() const;
+
+    //Number of times reorder() changed an evaluation order
+    uint64_t reorders() const { return reorderCount; }
+
+    //Number of && / || chains that adapt
+    size_t chainCount() const { return chains.size(); }
+
+    //Names of the variables the expression uses, in order of first use
+    const std::vector<std::string>& variables() const { return compiled.variables(); }
+
+    //Index of a variable in variables(), or -1 when the expression doesn't use it
+    int variableIndex(std::string_view name) const { return compiled.variableIndex(name); }
+};
+
+//Adaptive expression of the default (32-bit int) evaluator
+using AdaptiveExpression = BasicAdaptiveExpression<Int32Policy>;
+
+//Compile an expression
+
+template <class Policy>
+BasicAdaptiveExpression<Policy>::BasicAdaptiveExpression(std::string_view expr)
+    : compiled(BasicEvaluator<Policy>().compile(expr)) {
+    // Same tree as compile() built, so both agree on every result
+    Arena arena(expr.size() * 2 * sizeof(Node) + 256);
+    std::vector<std::string> names;
+    AstBuilder<Policy> builder(arena, names);
+    translate(expr, builder);
+    const Node* tree = AstOptimizer<Policy>(arena).optimize(builder.root());
+    if (tree) root = static_cast<int>(build(tree, 0));
+    stack.resize(std::max<size_t>(stack.size(), 1));
+}
+
+/**
+ * Can evaluating a subtree raise an error once every variable is bound?
+ * Mirrors NodeFactory, except that a variable can't fail: run() falls back
+ * to the program as written when one isn't bound.
+ */
+template <class Policy>
+bool BasicAdaptiveExpression<Policy>::mayFaultWhenBound(const Node* node) {
+    SmallStack<const Node*, 64> pending;
+    pending.push(node);
+    while (!pending.empty()) {
+        const Node* n = pending.top();
+        pending.pop();
+        switch (n->kind) {
+        case NodeKind::Constant:
+        case NodeKind::Variable:
+            break;
+        case NodeKind::Unary:
+            if (Policy::canFail && (n->op == Op::Negate || n->op == Op::Increment || n->op == Op::Decrement)) {
+                return true;
+            }
+            break;
+        case NodeKind::Power:
+            if (Policy::canFail) return true;
+            break;
+        case NodeKind::Binary:
+            if (NodeFactory<Policy>::operatorMayFail(n->op, n->left, n->right)) return true;
+            break;
+        }
+        if (n->left) pending.push(n->left);
+        if (n->right) pending.push(n->right);
+    }
+    return false;
+}
+
+/**
+ * Turn a subtree into a clause
+ * An && or || node becomes a chain of every operand reached through nodes
+ * of the same operator, left to right ((a && b) && c and a && (b && c) are
+ * both the chain a, b, c); each operand becomes a clause in turn. Anything
+ * else, and chains nested deeper than MaxChainNesting, is emitted as a
+ * program.
+ */
+template <class Policy>
+uint32_t BasicAdaptiveExpression<Policy>::build(const Node* node, size_t nesting) {
+    Clause clause;
+    clause.pinned = mayFaultWhenBound(node);
+    bool isChain = node->kind == NodeKind::Binary && (node->op == Op::And || node->op == Op::Or);
+
+    if (!isChain || nesting >= MaxChainNesting) {
+        std::vector<Instruction> program;
+        size_t depth = 0;
+        emitProgram(node, program, constants, depth);
+        stack.resize(std::max(stack.size(), depth));
+        clause.first = static_cast<uint32_t>(code.size());
+        clause.count = static_cast<uint32_t>(program.size());
+        clause.position = program.front().position;
+        clause.estimate = program.size();
+        code.insert(code.end(), program.begin(), program.end());
+        clauses.push_back(clause);
+        return static_cast<uint32_t>(clauses.size() - 1);
+    }
+
+    // Operands in source order, gathered without recursion
+    std::vector<const Node*> operands;
+    SmallStack<const Node*, 64> pending;
+    pending.push(node);
+    while (!pending.empty()) {
+        const Node* n = pending.top();
+        pending.pop();
+        if (n->kind == NodeKind::Binary && n->op == node->op) {
+            pending.push(n->right);
+            pending.push(n->left);
+        } else {
+            operands.push_back(n);
+        }
+    }
+
+    size_t chain = chains.size();
+    chains.push_back({node->op, {}});
+    clause.chain = static_cast<int>(chain);
+    for (const Node* operand : operands) {
+        uint32_t index = build(operand, nesting + 1);
+        chains[chain].order.push_back(index);
+        clause.estimate += clauses[index].estimate;
+    }
+    clause.position = clauses[chains[chain].order.front()].position;
+    clauses.push_back(clause);
+    return static_cast<uint32_t>(clauses.size() - 1);
+}
+
+/**
+ * Evaluate a clause
+ * A chain evaluates its operands in their current order until one decides
+ * it, recording for each operand what it cost and whether it let the chain
+ * continue. The value is 0 or 1, as the program as written produces.
+ */
+template <class Policy>
+typename Policy::value_type BasicAdaptiveExpression<Policy>::evaluate(uint32_t index,
+                                                                      std::span<const value_type> variables,
+                                                                      uint64_t& cost) {
+    const Clause& clause = clauses[index];
+    if (clause.chain < 0) {
+        cost += clause.count;
+        return executeProgram<Policy>(std::span<const Instruction>(code).subspan(clause.first, clause.count),
+                                      constants.data(), variables, stack.data());
+    }
+
+    const Chain& chain = chains[clause.chain];
+    bool isAnd = chain.op == Op::And;
+    for (uint32_t k : chain.order) {
+        Instrumentation::countOperator(chain.op);
+        uint64_t before = cost;
+        value_type value = evaluate(k, variables, cost);
+        Clause& operand = clauses[k];
+        operand.evaluated++;
+        operand.cost += cost - before;
+        if (Policy::truthy(value) != isAnd) return isAnd ? 0 : 1;
+        operand.passed++;
+    }
+    return isAnd ? 1 : 0;
+}
+
+//Execute the expression with values for its variables
+
+template <class Policy>
+typename Policy::value_type BasicAdaptiveExpression<Policy>::run(std::span<const value_type> variables) {
+    if (variables.size() < compiled.variables().size()) return compiled.run(variables);
+    if (root < 0) return 0;
+
+    Instrumentation::PhaseTimer timer(Phase::Run);
+    uint64_t cost = 0;
+    value_type result = evaluate(static_cast<uint32_t>(root), variables, cost);
+    if (++runs % ReorderInterval == 0) reorder();
+    return result;
+}
+
+/**
+ * Expected cost of a clause per decision of its chain
+ * An operand decides an && chain when it is false and an || chain when it
+ * is true. For operands that are independent, running them in increasing
+ * order of cost / P(decides) minimizes the expected cost of the chain.
+ * The pass rate is smoothed (one pass and one decision assumed up front)
+ * so an operand seen a few times, or never, still gets a finite rank.
+ */
+template <class Policy>
+double BasicAdaptiveExpression<Policy>::rank(const Clause& clause) {
+    double cost = clause.evaluated ? double(clause.cost) / clause.evaluated : double(clause.estimate);
+    double decides = 1 - (clause.passed + 1.0) / (clause.evaluated + 2.0);
+    return cost / decides;
+}
+
+/**
+ * Reorder every chain by the statistics so far
+ * Pinned operands split a chain into segments. Only operands within one
+ * segment trade places, so every operand that can fail is still reached
+ * exactly when the operands before it as written let the chain continue.
+ * The sort is stable, so operands with equal ranks keep their order.
+ */
+template <class Policy>
+void BasicAdaptiveExpression<Policy>::reorder() {
+    bool changed = false;
+    for (Chain& chain : chains) {
+        auto begin = chain.order.begin();
+        while (begin != chain.order.end()) {
+            auto end = std::find_if(begin, chain.order.end(), [&](uint32_t k) { return clauses[k].pinned; });
+            if (end - begin > 1) {
+                std::vector<uint32_t> before(begin, end);
+                std::stable_sort(begin, end, [&](uint32_t a, uint32_t b) {
+                    return rank(clauses[a]) < rank(clauses[b]);
+                });
+                changed = changed || !std::equal(begin, end, before.begin());
+            }
+            begin = end == chain.order.end() ? end : end + 1;
+        }
+    }
+    if (changed) reorderCount++;
+
+    for (Clause& clause : clauses) {
+        clause.evaluated /= 2;
+        clause.passed /= 2;
+        clause.cost /= 2;
+    }
+}
+
+//Statistics of every chain operand
+
+template <class Policy>
+std::vector<AdaptiveClauseStats> BasicAdaptiveExpression<Policy>::statistics() const {
+    std::vector<AdaptiveClauseStats> stats;
+    for (size_t c = 0; c < chains.size(); c++) {
+        const Chain& chain = chains[c];
+        for (size_t slot = 0; slot < chain.order.size(); slot++) {
+            const Clause& clause = clauses[chain.order[slot]];
+            AdaptiveClauseStats entry;
+            entry.chain = c;
+            entry.op = chain.op;
+            entry.slot = slot;
+            entry.position = clause.position;
+            entry.pinned = clause.pinned;
+            entry.evaluated = clause.evaluated;
+            entry.passed = clause.passed;
+            entry.cost = clause.evaluated ? double(clause.cost) / clause.evaluated : double(clause.estimate);
+            entry.rank = rank(clause);
+            stats.push_back(entry);
+        }
+    }
+    return stats;
+}
+
+// The standard policies are instantiated once, in AdaptiveExpression.cpp
+#define EVALUATOR_EXTERN_ADAPTIVE(P) extern template class BasicAdaptiveExpression<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_ADAPTIVE)
+#undef EVALUATOR_EXTERN_ADAPTIVE
+
+#endif // ADAPTIVE_EXPRESSION_H
\ No newline at end of file
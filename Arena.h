@@ -0,0 +1,73 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//class Arena
+//Bump allocator: objects are carved out of large blocks and all of them are
+//released together when the arena is destroyed. Only trivially destructible
+//types may be allocated, since no destructors are run.
+class Arena {
+private:
+    //Header placed at the start of every block
+    struct Block {
+        Block* previous;
+        size_t size;
+    };
+
+    Block* current = nullptr;  ///< Block being carved up
+    char* next = nullptr;      ///< First free byte in the current block
+    char* end = nullptr;       ///< One past the last byte of the current block
+
+    //Start a new block with room for at least bytes more
+    void grow(size_t bytes) {
+        size_t size = sizeof(Block) + std::max(bytes, current ? current->size * 2 : bytes);
+        // Through operator new, so allocation counting (see bench/) sees the blocks
+        Block* block = static_cast<Block*>(::operator new(size));
+        block->previous = current;
+        block->size = size - sizeof(Block);
+        current = block;
+        next = reinterpret_cast<char*>(block + 1);
+        end = next + block->size;
+    }
+
+public:
+    //Reserve the first block up front; size it so one expression needs one block
+    explicit Arena(size_t initialBytes = 1024) { grow(initialBytes); }
+
+    ~Arena() {
+        while (current) {
+            Block* previous = current->previous;
+            ::operator delete(current);
+            current = previous;
+        }
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    //Allocate raw, suitably aligned memory
+    void* allocate(size_t bytes, size_t alignment) {
+        size_t padding = (alignment - reinterpret_cast<size_t>(next) % alignment) % alignment;
+        if (static_cast<size_t>(end - next) < padding + bytes) {
+            grow(bytes + alignment);
+            padding = (alignment - reinterpret_cast<size_t>(next) % alignment) % alignment;
+        }
+        void* result = next + padding;
+        next += padding + bytes;
+        return result;
+    }
+
+    //Construct an object in the arena
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+        return new (allocate(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+    }
+};
+
+#endif // ARENA_H
\ No newline at end of file
@@ -0,0 +1,455 @@
+#ifndef AST_H
+#define AST_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "Arena.h"
+#include "CompiledExpression.h"
+#include "Lexer.h"
+#include "NumericPolicy.h"
+#include "Operations.h"
+#include "SmallStack.h"
+
+//Kinds of expression tree nodes
+enum class NodeKind : uint8_t {
+    Constant,   ///< Literal (constant)
+    Variable,   ///< Variable (value = index in the variable table)
+    Unary,      ///< op applied to left
+    Binary,     ///< op applied to left and right
+    Power       ///< left raised to a small constant exponent (value), lowered to multiplications
+};
+
+//A node of the expression tree over values of type T. Nodes live in an
+//Arena and are never freed individually, so they hold plain pointers.
+template <class T>
+struct BasicNode {
+    NodeKind kind;
+    Op op;               ///< Operator for Unary/Binary nodes
+    bool mayFault;       ///< Evaluating this subtree can raise an error
+    uint32_t position;   ///< Source offset of the operator or operand
+    T constant;          ///< Value of a Constant
+    int value;           ///< See NodeKind
+    BasicNode* left;
+    BasicNode* right;
+};
+
+//class NodeFactory
+//Creates nodes in an arena, working out whether each one can fail under the
+//numeric policy (division by zero, overflow, unbound variables)
+template <class Policy>
+class NodeFactory {
+public:
+    using T = typename Policy::value_type;
+    using Node = BasicNode<T>;
+
+private:
+    Arena& arena;
+
+public:
+    //Check whether applying op to these operands can raise an error by itself
+    static bool operatorMayFail(Op op, const Node* left, const Node* right) {
+        bool known = right->kind == NodeKind::Constant;
+        T c = right->constant;
+        switch (op) {
+        case Op::Add:
+        case Op::Subtract:
+        case Op::Multiply:
+            return Policy::canFail;
+        case Op::Divide:
+            // Division fails on a zero divisor, and overflows only as x / -1
+            return !known || c == 0 || (Policy::canFail && c == -1);
+        case Op::Modulo:
+            return !known || c == 0;
+        case Op::Power:
+            if (known && (c == 0 || c == 1)) return false;
+            if (Policy::canFail) return true;
+            // An integer zero raised to a negative exponent divides by zero
+            if (std::is_floating_point_v<T>) return false;
+            return !(known && c > 0) && !(left->kind == NodeKind::Constant && left->constant != 0);
+        default:
+            return false;
+        }
+    }
+
+    explicit NodeFactory(Arena& nodeArena) : arena(nodeArena) {}
+
+    Node* constant(T value, uint32_t position) {
+        return arena.make<Node>(NodeKind::Constant, Op::Count, false, position, value, 0, nullptr, nullptr);
+    }
+
+    //Evaluating a variable fails when no value is bound to it
+    Node* variable(int index, uint32_t position) {
+        return arena.make<Node>(NodeKind::Variable, Op::Count, true, position, T(0), index, nullptr, nullptr);
+    }
+
+    Node* unary(Op op, Node* operand, uint32_t position) {
+        bool fails = Policy::canFail && (op == Op::Negate || op == Op::Increment || op == Op::Decrement);
+        return arena.make<Node>(NodeKind::Unary, op, operand->mayFault || fails, position, T(0), 0, operand, nullptr);
+    }
+
+    Node* binary(Op op, Node* left, Node* right, uint32_t position) {
+        bool fails = left->mayFault || right->mayFault || operatorMayFail(op, left, right);
+        return arena.make<Node>(NodeKind::Binary, op, fails, position, T(0), 0, left, right);
+    }
+
+    //x^exponent for a small exponent, computed with multiplications
+    Node* power(Node* base, int exponent, uint32_t position) {
+        return arena.make<Node>(NodeKind::Power, Op::Power, base->mayFault || Policy::canFail, position,
+                                T(0), exponent, base, nullptr);
+    }
+};
+
+//class AstBuilder
+//Sink for translate() that builds an expression tree in an arena
+template <class Policy>
+class AstBuilder {
+public:
+    using T = typename Policy::value_type;
+    using Node = BasicNode<T>;
+
+private:
+    NodeFactory<Policy> make;
+    std::vector<std::string>& variableNames;  ///< Variables in order of first use
+    SmallStack<Node*, 64> nodes;              ///< Subtrees waiting for their operator
+
+public:
+    AstBuilder(Arena& nodeArena, std::vector<std::string>& variables)
+        : make(nodeArena), variableNames(variables) {}
+
+    //Add a literal
+    ErrorKind operand(std::string_view digits, size_t offset) {
+        T value;
+        ErrorKind error = Policy::parseLiteral(digits, value);
+        if (error == ErrorKind::None) {
+            nodes.push(make.constant(value, offset));
+        }
+        return error;
+    }
+
+    //Add a variable reference, numbering variables in order of first use
+    void variable(std::string_view name, size_t offset) {
+        auto found = std::find(variableNames.begin(), variableNames.end(), name);
+        if (found == variableNames.end()) {
+            found = variableNames.emplace(variableNames.end(), name);
+        }
+        nodes.push(make.variable(static_cast<int>(found - variableNames.begin()), offset));
+    }
+
+    //Combine the newest subtrees under an operator
+    void apply(Op op, size_t offset) {
+        Node* right = nodes.top();
+        nodes.pop();
+        if (opInfo(op).arity == 1) {
+            nodes.push(make.unary(op, right, offset));
+            return;
+        }
+        Node* left = nodes.top();
+        nodes.pop();
+        nodes.push(make.binary(op, left, right, offset));
+    }
+
+    void shortCircuit(Op, size_t) {}
+
+    //The finished tree (nullptr for an expression without tokens)
+    Node* root() { return nodes.empty() ? nullptr : nodes.top(); }
+};
+
+//class AstOptimizer
+//Simplifies a tree without changing its results or errors under the policy
+template <class Policy>
+class AstOptimizer {
+public:
+    using T = typename Policy::value_type;
+    using Node = BasicNode<T>;
+
+private:
+    //Largest exponent x^n that is lowered to repeated multiplication
+    static constexpr int MaxUnrolledPower = 4;
+
+    NodeFactory<Policy> make;
+
+    static bool isConstant(const Node* node, T value) {
+        return node->kind == NodeKind::Constant && node->constant == value;
+    }
+
+    //Check whether a node only ever evaluates to 0 or 1
+    static bool isBooleanValued(const Node* node) {
+        switch (node->kind) {
+        case NodeKind::Constant: return node->constant == 0 || node->constant == 1;
+        case NodeKind::Unary:    return node->op == Op::Not;
+        case NodeKind::Binary:   return node->op >= Op::Greater && node->op <= Op::Or;
+        default:                 return false;
+        }
+    }
+
+    //The 0/1 truth value of a node
+    Node* truthValue(Node* node) {
+        if (isBooleanValued(node)) return node;
+        return make.binary(Op::NotEqual, node, make.constant(0, node->position), node->position);
+    }
+
+    //Simplify a node whose value is only used as true/false (operand of &&, || or !)
+    static Node* simplifyCondition(Node* node) {
+        for (;;) {
+            if (node->kind == NodeKind::Unary && node->op == Op::Not &&
+                node->left->kind == NodeKind::Unary && node->left->op == Op::Not) {
+                node = node->left->left;   // !!x -> x
+            } else if (node->kind == NodeKind::Unary && node->op == Op::Negate && !Policy::canFail) {
+                node = node->left;         // -x is non-zero exactly when x is (unless negating can overflow)
+            } else if (node->kind == NodeKind::Binary && node->op == Op::NotEqual && isConstant(node->right, 0)) {
+                node = node->left;         // x != 0 -> x
+            } else {
+                return node;
+            }
+        }
+    }
+
+    //Simplify one node whose children are already simplified
+    Node* simplify(Node* node);
+
+public:
+    explicit AstOptimizer(Arena& arena) : make(arena) {}
+
+    //Simplify a whole tree; returns the new root
+    Node* optimize(Node* root);
+};
+
+//Simplify one node whose children are already simplified
+
+template <class Policy>
+typename AstOptimizer<Policy>::Node* AstOptimizer<Policy>::simplify(Node* node) {
+    if (node->kind == NodeKind::Unary) {
+        Node* operand = node->left;
+
+        // Constant folding; an operation that fails is left for run time
+        T folded;
+        if (operand->kind == NodeKind::Constant &&
+            tryUnaryOperation<Policy>(node->op, operand->constant, folded) == ErrorKind::None) {
+            return make.constant(folded, node->position);
+        }
+        switch (node->op) {
+        case Op::Plus:
+            return operand;                       // +x -> x
+        case Op::Negate:
+            // Not under saturation, where -(-minValue) is -maxValue
+            if (operand->kind == NodeKind::Unary && operand->op == Op::Negate && Policy::involutiveNegate) {
+                return operand->left;             // --x (two negations) -> x
+            }
+            return node;
+        case Op::Not:
+            node->left = operand = simplifyCondition(operand);
+            if (operand->kind == NodeKind::Unary && operand->op == Op::Not && isBooleanValued(operand->left)) {
+                return operand->left;             // !!(a < b) -> a < b
+            }
+            return node;
+        default:
+            return node;
+        }
+    }
+
+    if (node->kind != NodeKind::Binary) return node;
+
+    Op op = node->op;
+    Node* left = node->left;
+    Node* right = node->right;
+
+    // Constant folding; an operation that fails (division by zero, overflow)
+    // is left for run time
+    T folded;
+    if (left->kind == NodeKind::Constant && right->kind == NodeKind::Constant &&
+        tryOperation<Policy>(op, left->constant, right->constant, folded) == ErrorKind::None) {
+        return make.constant(folded, node->position);
+    }
+
+    // Keep constants on the right of commutative operators (constants can't fault,
+    // so evaluating them later changes nothing)
+    if ((op == Op::Add || op == Op::Multiply || op == Op::Equal || op == Op::NotEqual) &&
+        left->kind == NodeKind::Constant) {
+        std::swap(left, right);
+        node->left = left;
+        node->right = right;
+    }
+
+    if (op == Op::And || op == Op::Or) {
+        node->left = left = simplifyCondition(left);
+        node->right = right = simplifyCondition(right);
+        bool isAnd = (op == Op::And);
+
+        // A constant left operand either decides the result (0 && x, 1 || x),
+        // so x is never evaluated, or leaves just the truth value of x
+        if (left->kind == NodeKind::Constant) {
+            if (!Policy::truthy(left->constant) == isAnd) return make.constant(isAnd ? 0 : 1, node->position);
+            return truthValue(right);
+        }
+        // x && 1 and x || 0 are the truth value of x; x && 0 and x || 1 are
+        // constant, but x still has to run if it can fail
+        if (right->kind == NodeKind::Constant) {
+            if (!Policy::truthy(right->constant) != isAnd) return truthValue(left);
+            if (!left->mayFault) return make.constant(isAnd ? 0 : 1, node->position);
+        }
+        return node;
+    }
+
+    if (right->kind != NodeKind::Constant) return node;
+    T c = right->constant;
+
+    // Identity elimination (x + 0 would turn a floating -0 into +0)
+    if (op == Op::Add && c == 0 && !std::is_floating_point_v<T>) return left;
+    if (op == Op::Subtract && c == 0) return left;
+    if ((op == Op::Multiply || op == Op::Divide || op == Op::Power) && c == 1) return left;
+
+    // (x + c1) + c2 -> x + (c1 + c2), likewise for *; only where regrouping
+    // can't change the result (no overflow checks, clamping or rounding)
+    if (Policy::associative && (op == Op::Add || op == Op::Multiply) &&
+        left->kind == NodeKind::Binary && left->op == op && left->right->kind == NodeKind::Constant) {
+        T merged = performOperation<Policy>(op, left->right->constant, c, node->position);
+        Node* combined = make.binary(op, left->left, make.constant(merged, right->position), node->position);
+        return simplify(combined);
+    }
+
+    // Strength reduction of small constant powers
+    if (op == Op::Power) {
+        if (c == 0 && !left->mayFault) return make.constant(1, node->position);
+        for (int exponent = 2; exponent <= MaxUnrolledPower; exponent++) {
+            if (c == exponent) return make.power(left, exponent, node->position);
+        }
+    }
+
+    return node;
+}
+
+/**
+ * Simplify a tree without changing its results or errors
+ * The tree is walked bottom-up with an explicit stack (generated expressions
+ * can nest far deeper than the machine stack allows recursion), and every
+ * node is simplified once its children are:
+ * - constant subtrees are folded (except operations that fail, which must still fail at run time)
+ * - x+0, x-0, x*1, x/1, x^1 and +x collapse to x, and so do two negations
+ *   where negating twice gives back every value
+ * - !!x, -x and x!=0 collapse to x where only the truth value is used
+ * - x^0 becomes 1 unless x can fail, and x^2..x^4 become multiplications
+ * - constants in + and * chains are combined (wrap-around integer policies only)
+ */
+template <class Policy>
+typename AstOptimizer<Policy>::Node* AstOptimizer<Policy>::optimize(Node* root) {
+    if (!root) return root;
+
+    struct Frame {
+        Node** slot;    ///< Where the node hangs in the tree
+        bool expanded;  ///< Children already pushed
+    };
+
+    Node* result = root;
+    SmallStack<Frame, 64> stack;
+    stack.push({&result, false});
+
+    while (!stack.empty()) {
+        Frame& frame = stack.top();
+        Node* node = *frame.slot;
+        if (!frame.expanded) {
+            frame.expanded = true;
+            if (node->right) stack.push({&node->right, false});
+            if (node->left) stack.push({&node->left, false});
+            continue;
+        }
+        stack.pop();
+        *frame.slot = simplify(node);
+    }
+    return result;
+}
+
+/**
+ * Lower a tree into postfix instructions, tracking the deepest operand stack
+ * Literals are appended to the constant pool as they are emitted.
+ * && and || become conditional jumps around their right operand:
+ *   a && b  ->  a  JumpIfFalse L  b  ToBool  L:
+ *   a || b  ->  a  JumpIfTrue L   b  ToBool  L:
+ * so the right operand (and any error it could raise) is skipped whenever
+ * the left operand decides the result.
+ */
+template <class T>
+void emitProgram(const BasicNode<T>* root, std::vector<Instruction>& program, std::vector<T>& constants,
+                 size_t& maxDepth) {
+    if (!root) return;
+
+    struct Frame {
+        const BasicNode<T>* node;
+        uint8_t stage;   ///< 0: nothing emitted, 1: left emitted, 2: both emitted
+        size_t jump;     ///< Index of the short-circuit jump to patch
+    };
+
+    size_t depth = 0;
+    SmallStack<Frame, 64> stack;
+    stack.push({root, 0, 0});
+
+    auto emit = [&](OpCode code, uint32_t position, int value, int stackChange) {
+        program.push_back({code, position, value});
+        depth += stackChange;
+        maxDepth = std::max(maxDepth, depth);
+    };
+
+    while (!stack.empty()) {
+        Frame& frame = stack.top();
+        const BasicNode<T>* node = frame.node;
+        bool shortCircuit = node->kind == NodeKind::Binary && (node->op == Op::And || node->op == Op::Or);
+
+        // Emit the left operand, then the right one (left is evaluated first)
+        if (frame.stage == 0 && node->left) {
+            frame.stage = 1;
+            stack.push({node->left, 0, 0});
+            continue;
+        }
+        if (frame.stage <= 1 && node->right) {
+            frame.stage = 2;
+            if (shortCircuit) {
+                frame.jump = program.size();
+                // The jump pops the left operand when it falls through to the right one
+                emit(node->op == Op::And ? OpCode::JumpIfFalse : OpCode::JumpIfTrue, node->position, 0, -1);
+            }
+            stack.push({node->right, 0, 0});
+            continue;
+        }
+
+        size_t jump = frame.jump;
+        stack.pop();
+
+        switch (node->kind) {
+        case NodeKind::Constant:
+            constants.push_back(node->constant);
+            emit(OpCode::Push, node->position, static_cast<int>(constants.size() - 1), 1);
+            break;
+        case NodeKind::Variable:
+            emit(OpCode::Load, node->position, node->value, 1);
+            break;
+        case NodeKind::Unary:
+            emit(static_cast<OpCode>(node->op), node->position, 0, 0);
+            break;
+        case NodeKind::Binary:
+            if (shortCircuit) {
+                emit(OpCode::ToBool, node->position, 0, 0);
+                program[jump].value = static_cast<int>(program.size());
+            } else {
+                emit(static_cast<OpCode>(node->op), node->position, 0, -1);
+            }
+            break;
+        case NodeKind::Power:
+            // x^2: x x *   x^3: x x x * *   x^4: (x x *) (x x *) * via duplication
+            if (node->value == 4) {
+                emit(OpCode::Dup, node->position, 0, 1);
+                emit(OpCode::Multiply, node->position, 0, -1);
+                emit(OpCode::Dup, node->position, 0, 1);
+                emit(OpCode::Multiply, node->position, 0, -1);
+            } else {
+                for (int i = 1; i < node->value; i++) emit(OpCode::Dup, node->position, 0, 1);
+                for (int i = 1; i < node->value; i++) emit(OpCode::Multiply, node->position, 0, -1);
+            }
+            break;
+        }
+    }
+}
+
+#endif // AST_H
\ No newline at end of file
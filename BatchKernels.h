@@ -0,0 +1,227 @@
+#ifndef BATCH_KERNELS_H
+#define BATCH_KERNELS_H
+
+//Column kernels behind BasicCompiledExpression::runBatch(); included at the
+//end of CompiledExpression.h, which declares everything used here
+
+#include <algorithm>
+#include <cstring>
+
+//class BatchKernels
+//Loops applying one operator to a chunk of rows under a numeric policy
+template <class Policy>
+struct BatchKernels {
+    using T = typename Policy::value_type;
+
+    //Apply f element-wise: a[i] = f(a[i], b[i]), then raise the first error
+    //of a row in active (every row when active is null).
+    //For policies whose operation can't fail, f always returns None, the error
+    //tracking folds away and the compiler emits SSE/AVX2 code for the
+    //arithmetic, comparison and logical kernels (scalar code otherwise).
+    template <class F>
+    static void binary(T* __restrict a, const T* __restrict b, size_t n,
+                       const uint8_t* active, uint32_t position, F f) {
+        ErrorKind error = ErrorKind::None;
+        for (size_t i = 0; i < n; i++) {
+            T result = 0;
+            ErrorKind e = f(a[i], b[i], result);
+            if (e != ErrorKind::None && error == ErrorKind::None && (!active || active[i])) error = e;
+            a[i] = result;
+        }
+        if (error != ErrorKind::None) {
+            throw EvalError(error, position);
+        }
+    }
+
+    //Apply f element-wise in place: a[i] = f(a[i]), like binary()
+    template <class F>
+    static void unary(T* __restrict a, size_t n, const uint8_t* active, uint32_t position, F f) {
+        ErrorKind error = ErrorKind::None;
+        for (size_t i = 0; i < n; i++) {
+            T result = 0;
+            ErrorKind e = f(a[i], result);
+            if (e != ErrorKind::None && error == ErrorKind::None && (!active || active[i])) error = e;
+            a[i] = result;
+        }
+        if (error != ErrorKind::None) {
+            throw EvalError(error, position);
+        }
+    }
+
+    //Apply one operator to a chunk of rows; rows outside active (when given)
+    //are computed but can't raise errors
+    static void apply(OpCode code, T* __restrict a, const T* __restrict b, size_t n,
+                      const uint8_t* active, uint32_t position) {
+        switch (code) {
+        case OpCode::Add:          binary(a, b, n, active, position, [](T x, T y, T& r) { return Policy::add(x, y, r); }); break;
+        case OpCode::Subtract:     binary(a, b, n, active, position, [](T x, T y, T& r) { return Policy::subtract(x, y, r); }); break;
+        case OpCode::Multiply:     binary(a, b, n, active, position, [](T x, T y, T& r) { return Policy::multiply(x, y, r); }); break;
+        // A zero divisor is reported by the policy before it divides
+        case OpCode::Divide:       binary(a, b, n, active, position, [](T x, T y, T& r) { return Policy::divide(x, y, r); }); break;
+        case OpCode::Modulo:       binary(a, b, n, active, position, [](T x, T y, T& r) { return Policy::modulo(x, y, r); }); break;
+        case OpCode::Power:        binary(a, b, n, active, position, [](T x, T y, T& r) { return Policy::power(x, y, r); }); break;
+        case OpCode::Greater:      binary(a, b, n, active, position, [](T x, T y, T& r) { r = x > y;  return ErrorKind::None; }); break;
+        case OpCode::GreaterEqual: binary(a, b, n, active, position, [](T x, T y, T& r) { r = x >= y; return ErrorKind::None; }); break;
+        case OpCode::Less:         binary(a, b, n, active, position, [](T x, T y, T& r) { r = x < y;  return ErrorKind::None; }); break;
+        case OpCode::LessEqual:    binary(a, b, n, active, position, [](T x, T y, T& r) { r = x <= y; return ErrorKind::None; }); break;
+        case OpCode::Equal:        binary(a, b, n, active, position, [](T x, T y, T& r) { r = x == y; return ErrorKind::None; }); break;
+        case OpCode::NotEqual:     binary(a, b, n, active, position, [](T x, T y, T& r) { r = x != y; return ErrorKind::None; }); break;
+        case OpCode::And:
+            binary(a, b, n, active, position, [](T x, T y, T& r) { r = Policy::truthy(x) & Policy::truthy(y); return ErrorKind::None; });
+            break;
+        case OpCode::Or:
+            binary(a, b, n, active, position, [](T x, T y, T& r) { r = Policy::truthy(x) | Policy::truthy(y); return ErrorKind::None; });
+            break;
+        case OpCode::Not:       unary(a, n, active, position, [](T x, T& r) { r = !Policy::truthy(x); return ErrorKind::None; }); break;
+        case OpCode::Increment: unary(a, n, active, position, [](T x, T& r) { return Policy::increment(x, r); }); break;
+        case OpCode::Decrement: unary(a, n, active, position, [](T x, T& r) { return Policy::decrement(x, r); }); break;
+        case OpCode::Negate:    unary(a, n, active, position, [](T x, T& r) { return Policy::negate(x, r); }); break;
+        case OpCode::ToBool:    unary(a, n, active, position, [](T x, T& r) { r = Policy::truthy(x); return ErrorKind::None; }); break;
+        default: break;  // Unary plus leaves the values unchanged
+        }
+    }
+};
+
+/**
+ * Execute the program once per row
+ * The rows are processed in chunks of BatchChunkSize. Every operand stack
+ * slot is a column of one chunk, so each instruction becomes a tight loop
+ * over that chunk instead of one interpreter dispatch per row.
+ *
+ * Short-circuit jumps are taken per chunk: when the left operand of && / ||
+ * decides every row the right operand is skipped outright. When it decides
+ * only some rows, the right operand runs with those rows masked out (they
+ * can't raise errors) and their verdict is merged back at the jump target.
+ */
+template <class Policy>
+void BasicCompiledExpression<Policy>::runBatch(std::span<const std::span<const value_type>> columns,
+                                               std::span<value_type> out) const {
+    using Kernels = BatchKernels<Policy>;
+    constexpr size_t Chunk = BatchChunkSize;
+    Instrumentation::PhaseTimer timer(Phase::RunBatch);
+    Instrumentation::noteStackDepth(maxDepth);
+
+    if (columns.size() < variableNames.size()) {
+        throwUnboundVariable(columns.size());
+    }
+    for (size_t i = 0; i < variableNames.size(); i++) {
+        if (columns[i].size() < out.size()) {
+            throw std::invalid_argument("Column for variable '" + variableNames[i] + "' is shorter than the output");
+        }
+    }
+    if (program.empty()) {
+        std::fill(out.begin(), out.end(), 0);
+        return;
+    }
+
+    // One chunk-sized column per operand stack slot
+    std::vector<value_type> slots(maxDepth * Chunk);
+    auto slot = [&](size_t index) { return slots.data() + index * Chunk; };
+
+    // A && / || whose left operand decided only some of the rows
+    struct Pending {
+        size_t target;                ///< Jump target where the rows are merged back
+        value_type verdict;           ///< Result of the decided rows (0 for &&, 1 for ||)
+        bool wasMasked;               ///< Mask state to restore
+        uint8_t decided[Chunk];       ///< Rows the left operand decided
+        uint8_t wasActive[Chunk];
+    };
+    std::vector<Pending> pending;
+    uint8_t active[Chunk] = {};  // Rows still being computed (valid when masked)
+    bool masked = false;
+
+    auto merge = [&](size_t top) {
+        Pending& p = pending.back();
+        value_type* values = slot(top - 1);
+        for (size_t i = 0; i < Chunk; i++) {
+            values[i] = p.decided[i] ? p.verdict : values[i];
+            active[i] = p.wasActive[i];
+        }
+        masked = p.wasMasked;
+        pending.pop_back();
+    };
+
+    for (size_t base = 0; base < out.size(); base += Chunk) {
+        size_t n = std::min(Chunk, out.size() - base);
+        size_t top = 0;  // Number of slots currently on the stack
+        masked = false;
+
+        for (size_t pc = 0; pc < program.size(); pc++) {
+            while (!pending.empty() && pending.back().target == pc) merge(top);
+            const Instruction& ins = program[pc];
+            const uint8_t* mask = masked ? active : nullptr;
+
+            switch (ins.code) {
+            case OpCode::Push:
+                std::fill(slot(top), slot(top) + n, constants[ins.value]);
+                top++;
+                break;
+            case OpCode::Load:
+                std::memcpy(slot(top), columns[ins.value].data() + base, n * sizeof(value_type));
+                top++;
+                break;
+            case OpCode::Dup:
+                std::memcpy(slot(top), slot(top - 1), n * sizeof(value_type));
+                top++;
+                break;
+            case OpCode::ToBool:
+                Kernels::apply(OpCode::ToBool, slot(top - 1), nullptr, n, mask, ins.position);
+                break;
+
+            case OpCode::JumpIfFalse:
+            case OpCode::JumpIfTrue: {
+                bool isAnd = (ins.code == OpCode::JumpIfFalse);
+                const value_type* left = slot(top - 1);
+                uint8_t decided[Chunk];
+                size_t live = 0, decidedCount = 0;
+                for (size_t i = 0; i < n; i++) {
+                    uint8_t on = masked ? active[i] : 1;
+                    decided[i] = on & static_cast<uint8_t>(!Policy::truthy(left[i]) == isAnd);
+                    live += on;
+                    decidedCount += decided[i];
+                }
+
+                if (decidedCount == live) {
+                    // Every row is decided: skip the right operand
+                    if (isAnd) {
+                        std::fill(slot(top - 1), slot(top - 1) + n, value_type(0));
+                    } else {
+                        Kernels::apply(OpCode::ToBool, slot(top - 1), nullptr, n, mask, ins.position);
+                    }
+                    pc = ins.value - 1;
+                } else if (decidedCount == 0) {
+                    top--;  // No row is decided: evaluate the right operand for all of them
+                } else {
+                    Pending& p = pending.emplace_back();
+                    p.target = ins.value;
+                    p.verdict = isAnd ? 0 : 1;
+                    p.wasMasked = masked;
+                    for (size_t i = 0; i < Chunk; i++) {
+                        p.decided[i] = (i < n) ? decided[i] : 0;
+                        p.wasActive[i] = active[i];
+                        active[i] = (i < n) && (masked ? active[i] : 1) && !p.decided[i];
+                    }
+                    masked = true;
+                    top--;
+                }
+                break;
+            }
+
+            default:
+                Instrumentation::countOperator(static_cast<Op>(ins.code), n);
+                if (opInfo(static_cast<Op>(ins.code)).arity == 1) {
+                    Kernels::apply(ins.code, slot(top - 1), nullptr, n, mask, ins.position);
+                    break;
+                }
+                top--;
+                Kernels::apply(ins.code, slot(top - 1), slot(top), n, mask, ins.position);
+                break;
+            }
+        }
+        while (!pending.empty()) merge(top);
+
+        std::memcpy(out.data() + base, slot(0), n * sizeof(value_type));
+    }
+}
+
+#endif // BATCH_KERNELS_H
\ No newline at end of file
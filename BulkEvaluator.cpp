@@ -0,0 +1,8 @@
+#include "BulkEvaluator.h"
+
+//The bulk evaluators of the standard numeric policies are instantiated here
+//once rather than in every file that uses them
+
+#define EVALUATOR_INSTANTIATE_BULK(P) template class BasicBulkEvaluator<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_BULK)
+#undef EVALUATOR_INSTANTIATE_BULK
\ No newline at end of file
@@ -0,0 +1,191 @@
+#ifndef BULK_EVALUATOR_H
+#define BULK_EVALUATOR_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BulkIO.h"
+#include "EvalError.h"
+#include "Evaluator.h"
+#include "ThreadPool.h"
+
+//Append the decimal form of a value
+template <class T>
+inline void appendValue(std::string& out, T value) {
+    char digits[64];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+//std::to_chars has no __int128 overload
+inline void appendValue(std::string& out, __int128 value) {
+    char digits[48];
+    char* start = digits + sizeof(digits);
+    // Work on the magnitude as unsigned so the smallest value negates cleanly
+    unsigned __int128 magnitude = value < 0 ? -static_cast<unsigned __int128>(value)
+                                            : static_cast<unsigned __int128>(value);
+    do {
+        *--start = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) *--start = '-';
+    out.append(start, digits + sizeof(digits));
+}
+
+//Totals of a BasicBulkEvaluator run
+struct BulkStats {
+    uint64_t expressions = 0;  ///< Lines evaluated
+    uint64_t errors = 0;       ///< Lines that produced an error
+    uint64_t bytes = 0;        ///< Input bytes consumed
+};
+
+//class BasicBulkEvaluator
+//Evaluates newline-delimited expressions and writes one output line per
+//input line: the result, or "error@<position> <description>" (without the
+//"@<position>" when the error isn't tied to a position). Lines are read in
+//place and never copied; a trailing '\r' is ignored.
+//With a thread pool, each window of input is split into line ranges that
+//are evaluated in parallel and written back in input order.
+template <class Policy>
+class BasicBulkEvaluator {
+public:
+    //Input handled per round of parallel work; bounds the buffered output
+    static constexpr size_t WindowBytes = 16 << 20;
+
+    //Smallest window worth splitting across threads
+    static constexpr size_t MinShardBytes = 64 << 10;
+
+private:
+    //Output and counters of one line range
+    struct Shard {
+        std::string output;
+        uint64_t expressions = 0;
+        uint64_t errors = 0;
+    };
+
+    const BasicEvaluator<Policy>& evaluator;
+    ThreadPool* pool;
+    std::vector<Shard> shards;  ///< Kept between windows so their buffers are reused
+    BulkStats totals;
+
+    //Offset just past the line containing offset at
+    static size_t lineEnd(std::string_view text, size_t at);
+
+    //Evaluate every line of text into a shard
+    void evaluateLines(std::string_view text, Shard& shard) const;
+
+public:
+    //Evaluate with evaluator, splitting the work over pool when one is given
+    explicit BasicBulkEvaluator(const BasicEvaluator<Policy>& expressionEvaluator, ThreadPool* threads = nullptr)
+        : evaluator(expressionEvaluator), pool(threads) {}
+
+    //Evaluate every line of text and append the results to out. text should
+    //end on a line boundary; a last line without newline counts as a line.
+    void process(std::string_view text, OutputBuffer& out);
+
+    //Totals over every process() call so far
+    const BulkStats& stats() const { return totals; }
+};
+
+//Bulk evaluator of the default (32-bit int) evaluator
+using BulkEvaluator = BasicBulkEvaluator<Int32Policy>;
+
+//Offset just past the line containing offset at
+
+template <class Policy>
+size_t BasicBulkEvaluator<Policy>::lineEnd(std::string_view text, size_t at) {
+    size_t newline = text.find('\n', at);
+    return newline == std::string_view::npos ? text.size() : newline + 1;
+}
+
+//Evaluate every line of text into a shard
+
+template <class Policy>
+void BasicBulkEvaluator<Policy>::evaluateLines(std::string_view text, Shard& shard) const {
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = lineEnd(text, begin);
+        std::string_view line = text.substr(begin, end - begin);
+        if (!line.empty() && line.back() == '\n') line.remove_suffix(1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        begin = end;
+
+        try {
+            appendValue(shard.output, evaluator.eval(line));
+        } catch (const EvalError& e) {
+            shard.errors++;
+            shard.output += "error";
+            if (e.position() != EvalError::npos) {
+                shard.output += '@';
+                appendValue(shard.output, e.position());
+            }
+            shard.output += ' ';
+            shard.output += EvalError::describe(e.kind());
+        }
+        shard.output += '\n';
+        shard.expressions++;
+    }
+}
+
+/**
+ * Evaluate every line of text and append the results to out
+ * The text is walked in windows of WindowBytes cut at line boundaries. With
+ * a pool, each window is split into a few line ranges per thread (so work
+ * stealing can even out slow ranges); every range formats its results into
+ * its own buffer and the buffers are written out in order.
+ */
+template <class Policy>
+void BasicBulkEvaluator<Policy>::process(std::string_view text, OutputBuffer& out) {
+    totals.bytes += text.size();
+
+    while (!text.empty()) {
+        std::string_view window = text.substr(0, lineEnd(text, std::min(text.size(), WindowBytes) - 1));
+        text.remove_prefix(window.size());
+
+        size_t count = 1;
+        if (pool && pool->size() > 1 && window.size() >= MinShardBytes) {
+            count = std::min(pool->size() * 4, window.size() / (MinShardBytes / 4));
+        }
+        if (shards.size() < count) shards.resize(count);
+
+        // Line ranges of roughly equal size
+        std::vector<std::string_view> ranges(count);
+        size_t begin = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t end = (i + 1 == count) ? window.size()
+                                          : std::max(begin, lineEnd(window, window.size() * (i + 1) / count));
+            ranges[i] = window.substr(begin, end - begin);
+            begin = end;
+        }
+
+        auto evaluateRanges = [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                shards[i].output.clear();
+                shards[i].expressions = 0;
+                shards[i].errors = 0;
+                evaluateLines(ranges[i], shards[i]);
+            }
+        };
+        if (count == 1) {
+            evaluateRanges(0, 1);
+        } else {
+            pool->parallelFor(count, 1, evaluateRanges);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            out.append(shards[i].output);
+            totals.expressions += shards[i].expressions;
+            totals.errors += shards[i].errors;
+        }
+    }
+}
+
+// The standard policies are instantiated once, in BulkEvaluator.cpp
+#define EVALUATOR_EXTERN_BULK(P) extern template class BasicBulkEvaluator<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_BULK)
+#undef EVALUATOR_EXTERN_BULK
+
+#endif // BULK_EVALUATOR_H
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "BulkIO.h"
+#include <cerrno>
+#include <system_error>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Map a regular file
+
+MappedFile::MappedFile(const std::string& path, MapAccess access) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Can't open " + path);
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Can't stat " + path);
+    }
+
+    // An empty file can't be mapped, and there is nothing to read anyway
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Can't map " + path);
+        }
+        ::madvise(mapping, length, access == MapAccess::Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+        data = static_cast<const char*>(mapping);
+    }
+    ::close(fd);  // The mapping stays valid without the descriptor
+}
+
+MappedFile::~MappedFile() {
+    if (data) ::munmap(const_cast<char*>(data), length);
+}
+
+ChunkReader::ChunkReader(int input, size_t chunkSize) : fd(input), buffer(chunkSize > 0 ? chunkSize : 1) {}
+
+/**
+ * Produce the next run of complete lines
+ * The buffer is filled completely before it is handed out, so a pipe that
+ * delivers a few KiB per read() still yields large chunks. A line longer
+ * than the buffer makes the buffer grow until the whole line fits.
+ */
+bool ChunkReader::next(std::string_view& lines) {
+    // Move the unfinished line left over from the previous chunk to the front
+    std::memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+    filled -= consumed;
+    consumed = 0;
+
+    while (!atEnd) {
+        if (filled == buffer.size()) {
+            size_t newline = std::string_view(buffer.data(), filled).rfind('\n');
+            if (newline != std::string_view::npos) {
+                consumed = newline + 1;
+                lines = std::string_view(buffer.data(), consumed);
+                return true;
+            }
+            buffer.resize(buffer.size() * 2);
+        }
+
+        ssize_t count = ::read(fd, buffer.data() + filled, buffer.size() - filled);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "Can't read input");
+        }
+        if (count == 0) atEnd = true;
+        filled += static_cast<size_t>(count);
+    }
+
+    // End of the stream: whatever is left is the last chunk
+    consumed = filled;
+    lines = std::string_view(buffer.data(), filled);
+    return filled > 0;
+}
+
+OutputBuffer::OutputBuffer(int output, size_t size) : fd(output), capacity(size) {
+    buffer.reserve(capacity);
+}
+
+OutputBuffer::~OutputBuffer() {
+    try {
+        flush();
+    } catch (const std::system_error&) {
+        // Nowhere left to report it; callers that care flush() explicitly
+    }
+}
+
+//Write bytes to the descriptor, retrying short writes
+
+void OutputBuffer::writeAll(std::string_view bytes) {
+    while (!bytes.empty()) {
+        ssize_t count = ::write(fd, bytes.data(), bytes.size());
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "Can't write output");
+        }
+        bytes.remove_prefix(static_cast<size_t>(count));
+    }
+}
+
+//Queue bytes for output
+
+void OutputBuffer::append(std::string_view bytes) {
+    if (buffer.size() + bytes.size() > capacity) {
+        flush();
+        if (bytes.size() > capacity) {
+            writeAll(bytes);
+            return;
+        }
+    }
+    buffer.append(bytes);
+}
+
+//Write everything queued so far
+
+void OutputBuffer::flush() {
+    writeAll(buffer);
+    buffer.clear();
+}
\ No newline at end of file
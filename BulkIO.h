@@ -0,0 +1,82 @@
+#ifndef BULK_IO_H
+#define BULK_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//How a mapped file is going to be read
+enum class MapAccess : uint8_t {
+    Sequential,  ///< Front to back, once (pages behind the reader can be dropped)
+    Random       ///< Anywhere, repeatedly (the whole file is read ahead)
+};
+
+//class MappedFile
+//Read-only memory map of a whole file; the text is read straight from the
+//page cache without being copied, and processes mapping the same file
+//share its pages
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+
+public:
+    //Map a regular file (throws std::system_error if it can't be opened or mapped)
+    explicit MappedFile(const std::string& path, MapAccess access = MapAccess::Sequential);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    //The file contents
+    std::string_view text() const { return {data, length}; }
+};
+
+//class ChunkReader
+//Reads a stream (such as stdin) in large chunks that always end on a line
+//boundary; the unfinished last line is carried over to the next chunk
+class ChunkReader {
+private:
+    int fd;
+    std::vector<char> buffer;
+    size_t filled = 0;     ///< Bytes of buffer holding data
+    size_t consumed = 0;   ///< Bytes handed out by the last next()
+    bool atEnd = false;
+
+public:
+    //Read from fd in chunks of about chunkSize bytes
+    explicit ChunkReader(int fd, size_t chunkSize = 16 << 20);
+
+    //Produce the next run of complete lines (the last one may lack its
+    //newline at the end of the stream); false once the stream is exhausted
+    bool next(std::string_view& lines);
+};
+
+//class OutputBuffer
+//Collects output and writes it to a file descriptor in large blocks
+class OutputBuffer {
+private:
+    int fd;
+    std::string buffer;
+    size_t capacity;
+
+    //Write bytes to the descriptor, retrying short writes
+    void writeAll(std::string_view bytes);
+
+public:
+    explicit OutputBuffer(int fd, size_t capacity = 1 << 20);
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    //Queue bytes for output; blocks larger than the buffer are written directly
+    void append(std::string_view bytes);
+
+    //Write everything queued so far
+    void flush();
+};
+
+#endif // BULK_IO_H
\ No newline at end of file
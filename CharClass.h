@@ -0,0 +1,129 @@
+#ifndef CHAR_CLASS_H
+#define CHAR_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+//Character classes of the expression syntax. Unlike <cctype> these are
+//constexpr; for ASCII they match the "C" locale.
+constexpr bool isSpaceChar(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+constexpr bool isDigitChar(char c) { return c >= '0' && c <= '9'; }
+constexpr bool isAlphaChar(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+constexpr bool isNameChar(char c) { return isAlphaChar(c) || isDigitChar(c) || c == '_'; }
+
+//Runs of one class are scanned a vector at a time: 32 bytes with AVX2
+//(when the build enables it, e.g. -mavx2 or -march=native), 16 bytes with
+//SSE2 (every x86-64), and a byte at a time elsewhere.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define EVALUATOR_SCAN_WIDTH 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define EVALUATOR_SCAN_WIDTH 16
+#else
+#define EVALUATOR_SCAN_WIDTH 0
+#endif
+
+namespace charscan {
+
+#if EVALUATOR_SCAN_WIDTH == 32
+using Vector = __m256i;
+inline Vector load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline Vector splat(char c) { return _mm256_set1_epi8(c); }
+inline Vector equal(Vector a, Vector b) { return _mm256_cmpeq_epi8(a, b); }
+inline Vector either(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+inline Vector minimum(Vector a, Vector b) { return _mm256_min_epu8(a, b); }
+inline Vector minus(Vector a, Vector b) { return _mm256_sub_epi8(a, b); }
+inline uint32_t bits(Vector v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+#elif EVALUATOR_SCAN_WIDTH == 16
+using Vector = __m128i;
+inline Vector load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline Vector splat(char c) { return _mm_set1_epi8(c); }
+inline Vector equal(Vector a, Vector b) { return _mm_cmpeq_epi8(a, b); }
+inline Vector either(Vector a, Vector b) { return _mm_or_si128(a, b); }
+inline Vector minimum(Vector a, Vector b) { return _mm_min_epu8(a, b); }
+inline Vector minus(Vector a, Vector b) { return _mm_sub_epi8(a, b); }
+inline uint32_t bits(Vector v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+#endif
+
+#if EVALUATOR_SCAN_WIDTH
+//Bytes in [low, low + span], compared unsigned after shifting low to 0
+inline Vector inRange(Vector bytes, char low, char span) {
+    Vector shifted = minus(bytes, splat(low));
+    return equal(minimum(shifted, splat(span)), shifted);
+}
+#endif
+
+//The classes scanned: a scalar test and the same test on a whole vector
+struct Spaces {
+    static constexpr bool test(char c) { return isSpaceChar(c); }
+#if EVALUATOR_SCAN_WIDTH
+    static Vector match(Vector b) { return either(equal(b, splat(' ')), inRange(b, '\t', '\r' - '\t')); }
+#endif
+};
+
+struct Digits {
+    static constexpr bool test(char c) { return isDigitChar(c); }
+#if EVALUATOR_SCAN_WIDTH
+    static Vector match(Vector b) { return inRange(b, '0', 9); }
+#endif
+};
+
+struct NameChars {
+    static constexpr bool test(char c) { return isNameChar(c); }
+#if EVALUATOR_SCAN_WIDTH
+    // Setting bit 5 folds upper case onto lower case and nothing else onto a-z
+    static Vector match(Vector b) {
+        return either(either(Digits::match(b), inRange(either(b, splat(0x20)), 'a', 25)), equal(b, splat('_')));
+    }
+#endif
+};
+
+/**
+ * Offset of the first character at or after pos whose membership in Class
+ * differs from Inside (text.size() if there is none)
+ * Whole vectors are classified into a bitmask (bit i for character i) and
+ * the first differing character is found with a bit scan, so a run costs a
+ * few instructions per vector and the loop branch only depends on whether
+ * the run is longer than a vector. Only the last partial vector of the
+ * text is done a byte at a time, so nothing past its end is read.
+ */
+template <class Class, bool Inside>
+inline size_t scan(std::string_view text, size_t pos) {
+#if EVALUATOR_SCAN_WIDTH
+    constexpr uint32_t all = EVALUATOR_SCAN_WIDTH == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+    while (pos + EVALUATOR_SCAN_WIDTH <= text.size()) {
+        uint32_t members = bits(Class::match(load(text.data() + pos)));
+        uint32_t stops = Inside ? ~members & all : members;
+        if (stops != 0) return pos + static_cast<size_t>(__builtin_ctz(stops));
+        pos += EVALUATOR_SCAN_WIDTH;
+    }
+#endif
+    while (pos < text.size() && Class::test(text[pos]) == Inside) pos++;
+    return pos;
+}
+
+} // namespace charscan
+
+//Offset of the first character at or after pos that isn't whitespace
+inline size_t skipSpaces(std::string_view text, size_t pos) {
+    return charscan::scan<charscan::Spaces, true>(text, pos);
+}
+
+//Offset of the first character at or after pos that isn't a digit
+inline size_t skipDigits(std::string_view text, size_t pos) {
+    return charscan::scan<charscan::Digits, true>(text, pos);
+}
+
+//Offset of the first character at or after pos that can't be part of a name
+inline size_t skipNameChars(std::string_view text, size_t pos) {
+    return charscan::scan<charscan::NameChars, true>(text, pos);
+}
+
+//Offset of the first whitespace character at or after pos
+inline size_t findSpace(std::string_view text, size_t pos) {
+    return charscan::scan<charscan::Spaces, false>(text, pos);
+}
+
+#endif // CHAR_CLASS_H
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include "CompiledExpression.h"
+
+//The programs and batch kernels of the standard numeric policies are
+//instantiated here once rather than in every file that runs them
+
+#define EVALUATOR_INSTANTIATE_COMPILED(P) template class BasicCompiledExpression<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_COMPILED)
+#undef EVALUATOR_INSTANTIATE_COMPILED
\ No newline at end of file
@@ -0,0 +1,241 @@
+#ifndef COMPILED_EXPRESSION_H
+#define COMPILED_EXPRESSION_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+#include "Lexer.h"
+#include "EvalError.h"
+#include "Instrumentation.h"
+#include "NumericPolicy.h"
+#include "Operations.h"
+
+//Instructions of a compiled (postfix) expression program.
+//The operator entries mirror Op so an operator converts with a cast.
+enum class OpCode : uint8_t {
+    Add, Subtract, Multiply, Divide, Modulo, Power,
+    Greater, GreaterEqual, Less, LessEqual, Equal, NotEqual,
+    And, Or,
+    Not, Increment, Decrement, Plus, Negate,  // Unary operators
+    Push,           // Push the constant whose index is stored in the instruction
+    Load,           // Push the variable whose index is stored in the instruction
+    Dup,            // Push a copy of the top of the stack
+    JumpIfFalse,    // && : if the top is zero make it 0 and jump to value, else pop it
+    JumpIfTrue,     // || : if the top is non-zero make it 1 and jump to value, else pop it
+    ToBool          // Replace the top with 1 if it is non-zero
+};
+static_assert(static_cast<int>(OpCode::Negate) == static_cast<int>(Op::Negate),
+              "OpCode operator entries must mirror Op");
+
+//A single instruction of a compiled expression
+struct Instruction {
+    OpCode code;        ///< What to do
+    uint32_t position;  ///< Source offset of the operator, used for error messages
+    int value;          ///< Constant index (Push), variable index (Load) or target instruction (jumps)
+};
+
+template <class Policy> class BasicEvaluator;
+
+//Operand stack slots runProgram() keeps on the machine stack
+inline constexpr size_t ProgramInlineStackSize = 64;
+
+//class BasicCompiledExpression
+//A validated expression converted once into a flat postfix program.
+//run() executes it without parsing, string comparisons or heap allocation.
+//Values and arithmetic follow the numeric policy the expression was compiled for.
+template <class Policy>
+class BasicCompiledExpression {
+public:
+    using value_type = typename Policy::value_type;
+
+private:
+    friend class BasicEvaluator<Policy>;
+
+    std::vector<Instruction> program;  ///< Postfix instruction stream
+    std::vector<value_type> constants; ///< Literals referenced by Push instructions
+    size_t maxDepth = 0;               ///< Deepest operand stack the program needs
+    std::vector<std::string> variableNames;  ///< Variables in order of first use
+
+    //Report the first variable that has no value bound
+    [[noreturn]] void throwUnboundVariable(size_t bound) const;
+
+public:
+    //Operand stack slots kept on the machine stack by run()
+    static constexpr size_t InlineStackSize = ProgramInlineStackSize;
+
+    //Rows evaluated together by runBatch(); one chunk of every operand stack
+    //slot (2 KiB each for 64-bit values) stays resident in L1/L2 while a
+    //program runs over it
+    static constexpr size_t BatchChunkSize = 256;
+
+    //Execute the program and return its result
+    value_type run() const { return run({}); }
+
+    //Execute the program with values for its variables (in variables() order)
+    value_type run(std::span<const value_type> variables) const;
+
+    //Execute the program once per row. columns[i] holds the values of
+    //variables()[i] and must have at least out.size() entries; each result
+    //(0/1 for comparisons and logical operators) is written to out.
+    void runBatch(std::span<const std::span<const value_type>> columns, std::span<value_type> out) const;
+
+    //Names of the variables the expression uses, in order of first use
+    const std::vector<std::string>& variables() const { return variableNames; }
+
+    //Index of a variable in variables(), or -1 when the expression doesn't use it
+    int variableIndex(std::string_view name) const;
+
+    //Number of instructions in the program
+    size_t size() const { return program.size(); }
+
+    //The postfix program, its literals and the deepest operand stack it needs,
+    //for backends that translate the program further (see NativeExpression)
+    std::span<const Instruction> instructions() const { return program; }
+    std::span<const value_type> literals() const { return constants; }
+    size_t stackDepth() const { return maxDepth; }
+};
+
+//Compiled expressions of the default (32-bit int) evaluator
+using CompiledExpression = BasicCompiledExpression<Int32Policy>;
+
+/**
+ * Execute a postfix program against a caller provided operand stack
+ * Instructions refer to constants and variables by index and jump to
+ * instruction indices within the program, so a program runs unchanged
+ * wherever it is stored (see ExpressionImage.h).
+ */
+template <class Policy>
+typename Policy::value_type executeProgram(std::span<const Instruction> program,
+                                           const typename Policy::value_type* constants,
+                                           std::span<const typename Policy::value_type> variables,
+                                           typename Policy::value_type* stack) {
+    using value_type = typename Policy::value_type;
+    size_t top = 0;  // Number of values currently on the stack
+    size_t count = program.size();
+
+    for (size_t pc = 0; pc < count; pc++) {
+        const Instruction& ins = program[pc];
+
+        switch (ins.code) {
+        case OpCode::Push:
+            stack[top++] = constants[ins.value];
+            continue;
+
+        case OpCode::Load:
+            // Checked when reached, so errors surface in evaluation order like eval()
+            if (static_cast<size_t>(ins.value) >= variables.size()) {
+                throw EvalError(ErrorKind::UnknownVariable, ins.position);
+            }
+            stack[top++] = variables[ins.value];
+            continue;
+
+        case OpCode::Dup:
+            stack[top] = stack[top - 1];
+            top++;
+            continue;
+
+        // Short-circuit: the right operand is skipped once the left decides
+        case OpCode::JumpIfFalse:
+            Instrumentation::countOperator(Op::And);
+            if (!Policy::truthy(stack[top - 1])) {
+                stack[top - 1] = 0;
+                pc = ins.value - 1;
+            } else {
+                top--;
+            }
+            continue;
+
+        case OpCode::JumpIfTrue:
+            Instrumentation::countOperator(Op::Or);
+            if (Policy::truthy(stack[top - 1])) {
+                stack[top - 1] = 1;
+                pc = ins.value - 1;
+            } else {
+                top--;
+            }
+            continue;
+
+        case OpCode::ToBool:
+            stack[top - 1] = Policy::truthy(stack[top - 1]);
+            continue;
+
+        default:
+            break;
+        }
+
+        Op op = static_cast<Op>(ins.code);
+        Instrumentation::countOperator(op);
+        if (opInfo(op).arity == 1) {
+            // Unary operators replace the top of the stack
+            stack[top - 1] = performUnaryOperation<Policy>(op, stack[top - 1], ins.position);
+            continue;
+        }
+
+        // Binary operators consume two values and push one
+        value_type b = stack[--top];  // Right operand
+        stack[top - 1] = performOperation<Policy>(op, stack[top - 1], b, ins.position);
+    }
+
+    return top == 0 ? 0 : stack[top - 1];
+}
+
+//Report the first variable that has no value bound
+
+template <class Policy>
+void BasicCompiledExpression<Policy>::throwUnboundVariable(size_t bound) const {
+    for (const Instruction& ins : program) {
+        if (ins.code == OpCode::Load && static_cast<size_t>(ins.value) >= bound) {
+            throw EvalError(ErrorKind::UnknownVariable, ins.position);
+        }
+    }
+    throw EvalError(ErrorKind::UnknownVariable);
+}
+
+//Execute a program that needs at most maxDepth operand stack slots
+
+template <class Policy>
+typename Policy::value_type runProgram(std::span<const Instruction> program,
+                                       const typename Policy::value_type* constants,
+                                       std::span<const typename Policy::value_type> variables, size_t maxDepth) {
+    // Typical expressions fit in a small stack array; only pathological
+    // nesting falls back to a heap buffer
+    Instrumentation::PhaseTimer timer(Phase::Run);
+    Instrumentation::noteStackDepth(maxDepth);
+    if (maxDepth <= ProgramInlineStackSize) {
+        typename Policy::value_type stack[ProgramInlineStackSize];
+        return executeProgram<Policy>(program, constants, variables, stack);
+    }
+
+    std::vector<typename Policy::value_type> stack(maxDepth);
+    return executeProgram<Policy>(program, constants, variables, stack.data());
+}
+
+//Execute the program with values for its variables
+
+template <class Policy>
+typename Policy::value_type BasicCompiledExpression<Policy>::run(std::span<const value_type> variables) const {
+    return runProgram<Policy>(program, constants.data(), variables, maxDepth);
+}
+
+//Index of a variable in variables()
+
+template <class Policy>
+int BasicCompiledExpression<Policy>::variableIndex(std::string_view name) const {
+    for (size_t i = 0; i < variableNames.size(); i++) {
+        if (variableNames[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// runBatch() lives with the column kernels
+#include "BatchKernels.h"
+
+// The standard policies are instantiated once, in CompiledExpression.cpp
+#define EVALUATOR_EXTERN_COMPILED(P) extern template class BasicCompiledExpression<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_COMPILED)
+#undef EVALUATOR_EXTERN_COMPILED
+
+#endif // COMPILED_EXPRESSION_H
\ No newline at end of file
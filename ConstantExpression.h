@@ -0,0 +1,211 @@
+#ifndef CONSTANT_EXPRESSION_H
+#define CONSTANT_EXPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include "Ast.h"
+#include "EvalError.h"
+#include "Evaluator.h"
+#include "Lexer.h"
+#include "NumericPolicy.h"
+#include "Operations.h"
+#include "SmallStack.h"
+#include "Translator.h"
+
+//Expressions written as string literals, evaluated or compiled while the
+//program is compiled. The same lexer, operator table and translate() as at
+//run time are used, so the semantics are identical; any error they would
+//throw (a syntax error such as mismatched parentheses, a division by zero
+//in a constant) makes the program ill-formed instead.
+
+//Evaluate a constant expression during compilation
+//  constexpr int v = evalConstant("(1+2)*3");             // 9
+//  constexpr int64_t w = evalConstant<Int64Policy>("2^40");
+template <class Policy = Int32Policy>
+consteval typename Policy::value_type evalConstant(std::string_view expr) {
+    return evaluateExpression<Policy>(expr);
+}
+
+//A string literal usable as a template argument
+template <size_t N>
+struct FixedString {
+    char text[N] = {};
+
+    consteval FixedString(const char (&literal)[N]) {
+        for (size_t i = 0; i < N; i++) text[i] = literal[i];
+    }
+
+    constexpr std::string_view view() const { return {text, N - 1}; }
+    constexpr size_t size() const { return N - 1; }
+};
+
+//Expression tree built during compilation; nodes refer to each other by index
+template <class T, size_t Capacity>
+struct ConstantTree {
+    struct Node {
+        NodeKind kind = NodeKind::Constant;
+        Op op = Op::Count;
+        uint32_t position = 0;  ///< Source offset of the operator or operand
+        T constant = 0;         ///< Value of a Constant
+        int value = 0;          ///< Variable index of a Variable
+        int left = -1;
+        int right = -1;
+    };
+
+    Node nodes[Capacity] = {};
+    int count = 0;
+    int root = -1;               ///< -1 for an expression without tokens
+
+    uint32_t variableOffsets[Capacity] = {};  ///< Where each variable is first named
+    uint32_t variableLengths[Capacity] = {};
+    int variableCount = 0;
+};
+
+//class ConstantTreeBuilder
+//Sink for translate() that fills a ConstantTree
+template <class Policy, size_t Capacity>
+class ConstantTreeBuilder {
+public:
+    using T = typename Policy::value_type;
+    using Tree = ConstantTree<T, Capacity>;
+
+private:
+    Tree& tree;
+    std::string_view source;
+    SmallStack<int, 64> nodes;  ///< Subtrees waiting for their operator
+
+    constexpr int add(typename Tree::Node node) {
+        tree.nodes[tree.count] = node;
+        return tree.count++;
+    }
+
+public:
+    constexpr ConstantTreeBuilder(Tree& target, std::string_view expression) : tree(target), source(expression) {}
+
+    constexpr ErrorKind operand(std::string_view digits, size_t offset) {
+        T value = 0;
+        ErrorKind error = Policy::parseLiteral(digits, value);
+        if (error == ErrorKind::None) {
+            nodes.push(add({NodeKind::Constant, Op::Count, static_cast<uint32_t>(offset), value, 0, -1, -1}));
+        }
+        return error;
+    }
+
+    //Number variables in order of first use, like BasicCompiledExpression
+    constexpr void variable(std::string_view name, size_t offset) {
+        int index = 0;
+        while (index < tree.variableCount &&
+               source.substr(tree.variableOffsets[index], tree.variableLengths[index]) != name) {
+            index++;
+        }
+        if (index == tree.variableCount) {
+            tree.variableOffsets[index] = static_cast<uint32_t>(offset);
+            tree.variableLengths[index] = static_cast<uint32_t>(name.size());
+            tree.variableCount++;
+        }
+        nodes.push(add({NodeKind::Variable, Op::Count, static_cast<uint32_t>(offset), 0, index, -1, -1}));
+    }
+
+    constexpr void apply(Op op, size_t offset) {
+        int right = nodes.top();
+        nodes.pop();
+        if (opInfo(op).arity == 1) {
+            nodes.push(add({NodeKind::Unary, op, static_cast<uint32_t>(offset), 0, 0, right, -1}));
+            return;
+        }
+        int left = nodes.top();
+        nodes.pop();
+        nodes.push(add({NodeKind::Binary, op, static_cast<uint32_t>(offset), 0, 0, left, right}));
+    }
+
+    constexpr void shortCircuit(Op, size_t) {}
+
+    constexpr void finish() { tree.root = nodes.empty() ? -1 : nodes.top(); }
+};
+
+//Parse an expression into a tree during compilation
+template <class Policy, size_t Capacity>
+consteval ConstantTree<typename Policy::value_type, Capacity> buildConstantTree(std::string_view expr) {
+    ConstantTree<typename Policy::value_type, Capacity> tree;
+    ConstantTreeBuilder<Policy, Capacity> builder(tree, expr);
+    translate(expr, builder);
+    builder.finish();
+    return tree;
+}
+
+//class StaticExpression
+//An expression literal compiled into nested function templates, one per
+//tree node, with the node encoded in the template argument. The compiler
+//sees the whole computation at once and can inline and fold it completely:
+//  StaticExpression<"price * qty - discount", Int64Policy> total;
+//  int64_t t = total(price, qty, discount);   // variables in order of first use
+//Errors at run time (division by zero) throw EvalError as usual, and && / ||
+//short-circuit like everywhere else.
+template <FixedString Source, class Policy = Int32Policy>
+class StaticExpression {
+public:
+    using value_type = typename Policy::value_type;
+
+private:
+    // Every token adds at most two nodes ("++" after an operand is + and a prefix +)
+    static constexpr size_t Capacity = Source.size() * 2 + 1;
+    static constexpr ConstantTree<value_type, Capacity> tree = buildConstantTree<Policy, Capacity>(Source.view());
+
+    //Compute the subtree rooted at node Index
+    template <int Index>
+    static constexpr value_type evaluate(const value_type* variables) {
+        constexpr typename ConstantTree<value_type, Capacity>::Node node = tree.nodes[Index];
+        if constexpr (node.kind == NodeKind::Constant) {
+            return node.constant;
+        } else if constexpr (node.kind == NodeKind::Variable) {
+            return variables[node.value];
+        } else if constexpr (node.kind == NodeKind::Unary) {
+            return performUnaryOperation<Policy>(node.op, evaluate<node.left>(variables), node.position);
+        } else if constexpr (node.op == Op::And) {
+            return Policy::truthy(evaluate<node.left>(variables)) && Policy::truthy(evaluate<node.right>(variables));
+        } else if constexpr (node.op == Op::Or) {
+            return Policy::truthy(evaluate<node.left>(variables)) || Policy::truthy(evaluate<node.right>(variables));
+        } else {
+            value_type left = evaluate<node.left>(variables);
+            return performOperation<Policy>(node.op, left, evaluate<node.right>(variables), node.position);
+        }
+    }
+
+    //Evaluate the whole tree
+    static constexpr value_type run(const value_type* variables) {
+        if constexpr (tree.root < 0) {
+            return 0;
+        } else {
+            return evaluate<tree.root>(variables);
+        }
+    }
+
+public:
+    //Number of variables the expression uses
+    static constexpr size_t variableCount = static_cast<size_t>(tree.variableCount);
+
+    //Name of a variable, in order of first use
+    static constexpr std::string_view variableName(size_t index) {
+        return Source.view().substr(tree.variableOffsets[index], tree.variableLengths[index]);
+    }
+
+    //Evaluate with one value per variable, in order of first use
+    template <class... Values>
+        requires(sizeof...(Values) == variableCount)
+    constexpr value_type operator()(Values... values) const {
+        const value_type variables[sizeof...(Values) + 1] = {static_cast<value_type>(values)...};
+        return run(variables);
+    }
+
+    //Evaluate with the variable values in a span (in order of first use)
+    constexpr value_type operator()(std::span<const value_type> variables) const {
+        if (variables.size() < variableCount) {
+            throw EvalError(ErrorKind::UnknownVariable, tree.variableOffsets[variables.size()]);
+        }
+        return run(variables.data());
+    }
+};
+
+#endif // CONSTANT_EXPRESSION_H
\ No newline at end of file
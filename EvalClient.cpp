@@ -0,0 +1,8 @@
+#include "EvalClient.h"
+
+//The clients of the standard numeric policies are instantiated here once
+//rather than in every file that uses them
+
+#define EVALUATOR_INSTANTIATE_CLIENT(P) template class BasicEvalClient<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_CLIENT)
+#undef EVALUATOR_INSTANTIATE_CLIENT
\ No newline at end of file
@@ -0,0 +1,286 @@
+#ifndef EVAL_CLIENT_H
+#define EVAL_CLIENT_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "EvalError.h"
+#include "EvalProtocol.h"
+#include "Evaluator.h"
+#include "ExpressionImage.h"
+
+//One response received by BasicEvalClient::receive
+template <class T>
+struct BasicEvalResponse {
+    uint32_t id = 0;                          ///< id returned by send()
+    T value = 0;                              ///< Result when ok()
+    ErrorKind error = ErrorKind::None;        ///< What went wrong otherwise
+    size_t position = EvalError::npos;        ///< Where it went wrong
+
+    bool ok() const { return error == ErrorKind::None; }
+};
+
+//class BasicEvalClient
+//Connection to a BasicEvalServer. eval() and evalMany() are synchronous;
+//send(), flush() and receive() are the asynchronous interface: requests are
+//queued and written together, any number may be in flight, and responses
+//come back in the order the requests were sent. descriptor() can be
+//watched for readability by the caller's own event loop.
+//The numeric policy must match the server's.
+template <class Policy>
+class BasicEvalClient {
+public:
+    using value_type = typename Policy::value_type;
+    using Result = BasicEvalResult<value_type>;
+    using Response = BasicEvalResponse<value_type>;
+
+    //Requests evalMany() keeps in flight; their responses fit in the socket
+    //buffers, so neither end blocks on the other
+    static constexpr size_t Window = 512;
+
+    //Queued request bytes after which send() writes them out
+    static constexpr size_t FlushSize = 64 << 10;
+
+private:
+    static constexpr size_t ResponseSize = responseSize<value_type>();
+
+    int fd = -1;
+    uint32_t maxRequest = 0;  ///< Longest expression the server accepts
+    std::string output;       ///< Requests not yet written
+    std::string input;        ///< Received bytes not yet returned
+    size_t consumed = 0;      ///< Bytes of input returned by receive()
+    uint32_t nextId = 0;
+    size_t inFlight = 0;      ///< Requests sent whose response hasn't been received
+
+    //Read more bytes into input; false if none were waiting and wait is off
+    //(throws std::system_error, or std::runtime_error if the server hung up)
+    bool fill(bool wait);
+
+    //Raise std::logic_error if asynchronous requests are still in flight
+    void checkIdle() const;
+
+public:
+    //Connect to the server listening at path (throws std::system_error, or
+    //std::runtime_error if it isn't a server for this numeric policy)
+    explicit BasicEvalClient(const std::string& path);
+    ~BasicEvalClient();
+
+    BasicEvalClient(const BasicEvalClient&) = delete;
+    BasicEvalClient& operator=(const BasicEvalClient&) = delete;
+
+    //Evaluate an expression on the server (throws EvalError like
+    //BasicEvaluator::eval). No asynchronous request may be in flight.
+    value_type eval(std::string_view expr);
+
+    //Evaluate a batch of expressions, pipelined over the connection. Results
+    //come back in input order. No asynchronous request may be in flight.
+    std::vector<Result> evalMany(std::span<const std::string_view> exprs);
+
+    //Queue a request and return its id (throws EvalError with LimitExceeded
+    //if the expression is longer than the server accepts)
+    uint32_t send(std::string_view expr);
+
+    //Write every queued request
+    void flush();
+
+    //Take the next response; false if no request is in flight or, without
+    //wait, if its response hasn't arrived. Queued requests are flushed first.
+    bool receive(Response& response, bool wait = true);
+
+    //Requests sent whose response hasn't been received
+    size_t pending() const { return inFlight; }
+
+    //The socket, for polling
+    int descriptor() const { return fd; }
+};
+
+//Client of the default (32-bit int) evaluator
+using EvalClient = BasicEvalClient<Int32Policy>;
+using EvalResponse = BasicEvalResponse<int32_t>;
+
+//Connect to the server listening at path
+
+template <class Policy>
+BasicEvalClient<Policy>::BasicEvalClient(const std::string& path) {
+    fd = connectUnixSocket(path);
+    try {
+        while (input.size() < sizeof(ProtocolGreeting)) fill(true);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ProtocolGreeting greeting;
+    std::memcpy(&greeting, input.data(), sizeof(greeting));
+    consumed = sizeof(greeting);
+
+    const char* problem = nullptr;
+    if (std::memcmp(greeting.magic, ProtocolMagic, sizeof(ProtocolMagic)) != 0) {
+        problem = ": Not an evaluation server";
+    } else if (greeting.version != ProtocolVersion) {
+        problem = ": Unsupported protocol version";
+    } else if (greeting.policy != imagePolicyTag<Policy>()) {
+        problem = ": Server evaluates with another numeric policy";
+    }
+    if (problem) {
+        ::close(fd);
+        throw std::runtime_error(path + problem);
+    }
+    maxRequest = greeting.maxRequest;
+}
+
+template <class Policy>
+BasicEvalClient<Policy>::~BasicEvalClient() {
+    ::close(fd);
+}
+
+//Read more bytes into input
+
+template <class Policy>
+bool BasicEvalClient<Policy>::fill(bool wait) {
+    input.erase(0, consumed);
+    consumed = 0;
+    char buffer[64 << 10];
+    for (;;) {
+        ssize_t count = ::recv(fd, buffer, sizeof(buffer), wait ? 0 : MSG_DONTWAIT);
+        if (count > 0) {
+            input.append(buffer, static_cast<size_t>(count));
+            return true;
+        }
+        if (count == 0) throw std::runtime_error("Evaluation server closed the connection");
+        if (errno == EINTR) continue;
+        if (!wait && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+        throw std::system_error(errno, std::generic_category(), "Can't read from the evaluation server");
+    }
+}
+
+//Raise std::logic_error if asynchronous requests are still in flight
+
+template <class Policy>
+void BasicEvalClient<Policy>::checkIdle() const {
+    if (inFlight != 0 || !output.empty()) {
+        throw std::logic_error("Synchronous evaluation while asynchronous requests are in flight");
+    }
+}
+
+//Queue a request
+
+template <class Policy>
+uint32_t BasicEvalClient<Policy>::send(std::string_view expr) {
+    if (expr.size() > maxRequest) throw EvalError(ErrorKind::LimitExceeded);
+    uint32_t id = nextId++;
+    appendRequest(output, id, expr);
+    inFlight++;
+    if (output.size() >= FlushSize) flush();
+    return id;
+}
+
+//Write every queued request
+
+template <class Policy>
+void BasicEvalClient<Policy>::flush() {
+    size_t written = 0;
+    while (written < output.size()) {
+        ssize_t count = ::send(fd, output.data() + written, output.size() - written, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "Can't write to the evaluation server");
+        }
+        written += static_cast<size_t>(count);
+    }
+    output.clear();
+}
+
+//Take the next response
+
+template <class Policy>
+bool BasicEvalClient<Policy>::receive(Response& response, bool wait) {
+    if (inFlight == 0) return false;
+    if (!output.empty()) flush();
+    while (input.size() - consumed < ResponseSize) {
+        if (!fill(wait)) return false;
+    }
+    ResponseHeader header;
+    std::memcpy(&header, input.data() + consumed, sizeof(header));
+    std::memcpy(&response.value, input.data() + consumed + sizeof(header), sizeof(value_type));
+    consumed += ResponseSize;
+    inFlight--;
+
+    response.id = header.id;
+    response.error = header.error < static_cast<uint8_t>(ErrorKind::Count) ? static_cast<ErrorKind>(header.error)
+                                                                           : ErrorKind::None;
+    response.position = header.position == ProtocolNoPosition ? EvalError::npos : header.position;
+    return true;
+}
+
+//Evaluate an expression on the server
+
+template <class Policy>
+typename Policy::value_type BasicEvalClient<Policy>::eval(std::string_view expr) {
+    checkIdle();
+    send(expr);
+    Response response;
+    receive(response);
+    if (!response.ok()) throw EvalError(response.error, response.position);
+    return response.value;
+}
+
+/**
+ * Evaluate a batch of expressions, pipelined over the connection
+ * Up to Window requests are kept in flight: each response received lets
+ * another request go out. Expressions longer than the server accepts are
+ * answered locally without being sent.
+ */
+template <class Policy>
+std::vector<typename BasicEvalClient<Policy>::Result>
+BasicEvalClient<Policy>::evalMany(std::span<const std::string_view> exprs) {
+    checkIdle();
+    std::vector<Result> results(exprs.size());
+    std::vector<size_t> order;  // Index of each request in flight, oldest first
+    order.reserve(exprs.size());
+    size_t next = 0;
+    size_t received = 0;
+
+    Response response;
+    while (received < exprs.size()) {
+        while (next < exprs.size() && inFlight < Window) {
+            if (exprs[next].size() > maxRequest) {
+                results[next].error = ErrorKind::LimitExceeded;
+            } else {
+                send(exprs[next]);
+                order.push_back(next);
+            }
+            next++;
+        }
+        if (inFlight == 0) break;
+
+        // Take everything that has arrived before sending more
+        receive(response);
+        do {
+            Result& result = results[order[received++]];
+            result.value = response.value;
+            result.error = response.error;
+            result.position = response.position;
+        } while (inFlight > 0 && receive(response, false));
+    }
+
+    for (Result& result : results) {
+        if (!result.ok()) result.message = EvalError(result.error, result.position).what();
+    }
+    return results;
+}
+
+// The standard policies are instantiated once, in EvalClient.cpp
+#define EVALUATOR_EXTERN_CLIENT(P) extern template class BasicEvalClient<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_CLIENT)
+#undef EVALUATOR_EXTERN_CLIENT
+
+#endif // EVAL_CLIENT_H
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "EvalError.h"
+#include "Instrumentation.h"
+#include <string>
+
+//Build the message for an error kind and position
+
+static std::string formatMessage(ErrorKind kind, size_t position) {
+    std::string message = EvalError::describe(kind);
+    if (position != EvalError::npos) {
+        message += " @ char " + std::to_string(position);
+    }
+    return message;
+}
+
+EvalError::EvalError(ErrorKind kind, size_t position)
+    : std::runtime_error(formatMessage(kind, position)), errorKind(kind), errorPosition(position) {
+    Instrumentation::countError(kind);
+}
+
+//Human readable description of an error kind
+
+const char* EvalError::describe(ErrorKind kind) {
+    switch (kind) {
+    case ErrorKind::None:                   return "No error";
+    case ErrorKind::EmptyExpression:        return "Empty expression";
+    case ErrorKind::LeadingCloseParen:      return "Expression can't start with a closing parenthesis";
+    case ErrorKind::LeadingBinaryOperator:  return "Expression can't start with a binary operator";
+    case ErrorKind::MismatchedParentheses:  return "Mismatched parentheses";
+    case ErrorKind::TwoOperands:            return "Two operands in a row";
+    case ErrorKind::TwoBinaryOperators:     return "Two binary operators in a row";
+    case ErrorKind::InvalidCharacter:       return "Invalid character";
+    case ErrorKind::MissingOperand:         return "Missing operand";
+    case ErrorKind::ExpectedBinaryOperator: return "Expected binary operator";
+    case ErrorKind::DivisionByZero:         return "Division by zero";
+    case ErrorKind::UnknownVariable:        return "Unknown variable";
+    case ErrorKind::Overflow:               return "Arithmetic overflow";
+    case ErrorKind::NumberOutOfRange:       return "Number out of range";
+    case ErrorKind::CircularReference:      return "Circular reference";
+    case ErrorKind::LimitExceeded:          return "Expression exceeds a size limit";
+    default:                                return "Unknown error";
+    }
+}
\ No newline at end of file
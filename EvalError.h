@@ -0,0 +1,48 @@
+#ifndef EVAL_ERROR_H
+#define EVAL_ERROR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+//Every error the evaluator can report
+enum class ErrorKind : uint8_t {
+    None,
+    EmptyExpression,
+    LeadingCloseParen,
+    LeadingBinaryOperator,
+    MismatchedParentheses,
+    TwoOperands,
+    TwoBinaryOperators,
+    InvalidCharacter,
+    MissingOperand,
+    ExpectedBinaryOperator,
+    DivisionByZero,
+    UnknownVariable,
+    Overflow,
+    NumberOutOfRange,
+    CircularReference,
+    LimitExceeded,
+    Count
+};
+
+//class EvalError
+//Syntax or evaluation error; what() keeps the "<description> @ char N" format
+class EvalError : public std::runtime_error {
+private:
+    ErrorKind errorKind;   ///< What went wrong
+    size_t errorPosition;  ///< Offset in the expression, or npos when not tied to one
+
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit EvalError(ErrorKind kind, size_t position = npos);
+
+    //Human readable description of an error kind (without position)
+    static const char* describe(ErrorKind kind);
+
+    ErrorKind kind() const { return errorKind; }
+    size_t position() const { return errorPosition; }
+};
+
+#endif // EVAL_ERROR_H
\ No newline at end of file
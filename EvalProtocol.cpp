@@ -0,0 +1,67 @@
+#include "EvalProtocol.h"
+#include <cerrno>
+#include <system_error>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+//Address of a socket path (throws std::system_error if it is too long)
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), "Invalid socket path " + path);
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+    return address;
+}
+
+//Throw the current errno as a std::system_error after closing fd
+[[noreturn]] void failSocket(int fd, const std::string& what) {
+    int error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), what);
+}
+
+} // namespace
+
+/**
+ * Create a non-blocking socket listening at path
+ * A socket file can't be bound twice, so one that nothing accepts on any
+ * more (a server that was killed) is removed first. A socket a server is
+ * still listening on is left alone and reported as in use.
+ */
+int listenUnixSocket(const std::string& path) {
+    sockaddr_un address = socketAddress(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "Can't create a socket");
+
+    struct stat status;
+    if (::lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+        int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) ::close(probe);
+        if (!live) ::unlink(path.c_str());
+    }
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) failSocket(fd, "Can't bind " + path);
+    if (::listen(fd, SOMAXCONN) != 0) failSocket(fd, "Can't listen on " + path);
+    return fd;
+}
+
+//Connect a blocking socket to path
+
+int connectUnixSocket(const std::string& path) {
+    sockaddr_un address = socketAddress(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "Can't create a socket");
+    int result;
+    do {
+        result = ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    } while (result != 0 && errno == EINTR);
+    if (result != 0) failSocket(fd, "Can't connect to " + path);
+    return fd;
+}
\ No newline at end of file
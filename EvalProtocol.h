@@ -0,0 +1,87 @@
+#ifndef EVAL_PROTOCOL_H
+#define EVAL_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "EvalError.h"
+
+/**
+ * Wire format of the evaluation server (see EvalServer.h)
+ * Every field is in native byte order: the server only listens on a Unix
+ * domain socket, so both ends run on the same machine.
+ *
+ * On connecting, a client receives a ProtocolGreeting naming the numeric
+ * policy the server evaluates with. It then sends any number of requests
+ * without waiting for their responses (pipelining): a RequestHeader
+ * followed by the expression text. The server answers every request of a
+ * connection in the order they were sent, each with a ResponseHeader
+ * followed by the value (sizeof(value_type) bytes, zero on error).
+ */
+
+constexpr char ProtocolMagic[4] = {'E', 'V', 'A', 'L'};
+constexpr uint32_t ProtocolVersion = 1;
+
+//Position of an error that isn't tied to a position
+constexpr uint32_t ProtocolNoPosition = UINT32_MAX;
+
+//Sent by the server when a connection is accepted
+struct ProtocolGreeting {
+    char magic[4];        ///< ProtocolMagic
+    uint32_t version;     ///< ProtocolVersion
+    uint32_t policy;      ///< imagePolicyTag() of the server's numeric policy
+    uint32_t maxRequest;  ///< Longest expression the server accepts
+};
+
+//Start of a request
+struct RequestHeader {
+    uint32_t length;  ///< Bytes of expression text that follow
+    uint32_t id;      ///< Chosen by the client and echoed in the response
+};
+
+//Start of a response
+struct ResponseHeader {
+    uint32_t id;          ///< id of the request
+    uint8_t error;        ///< ErrorKind (None on success)
+    uint8_t reserved[3];  ///< Zero
+    uint32_t position;    ///< Offset of the error in the expression, or ProtocolNoPosition
+};
+
+static_assert(sizeof(ProtocolGreeting) == 16 && sizeof(RequestHeader) == 8 && sizeof(ResponseHeader) == 12,
+              "Protocol frames must have no padding");
+
+//Bytes of a response carrying a value of type T
+template <class T>
+constexpr size_t responseSize() { return sizeof(ResponseHeader) + sizeof(T); }
+
+//Append a request frame
+inline void appendRequest(std::string& out, uint32_t id, std::string_view expr) {
+    RequestHeader header{static_cast<uint32_t>(expr.size()), id};
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(expr);
+}
+
+//Append a response frame
+template <class T>
+inline void appendResponse(std::string& out, uint32_t id, T value, ErrorKind error, size_t position) {
+    ResponseHeader header{};
+    header.id = id;
+    header.error = static_cast<uint8_t>(error);
+    header.position = position == EvalError::npos ? ProtocolNoPosition : static_cast<uint32_t>(position);
+    char frame[responseSize<T>()];
+    std::memcpy(frame, &header, sizeof(header));
+    std::memcpy(frame + sizeof(header), &value, sizeof(T));
+    out.append(frame, sizeof(frame));
+}
+
+//Create a non-blocking socket listening at path. A socket file left behind
+//by a server that is gone is replaced; anything else at path is an error
+//(throws std::system_error).
+int listenUnixSocket(const std::string& path);
+
+//Connect a blocking socket to path (throws std::system_error)
+int connectUnixSocket(const std::string& path);
+
+#endif // EVAL_PROTOCOL_H
\ No newline at end of file
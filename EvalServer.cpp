@@ -0,0 +1,8 @@
+#include "EvalServer.h"
+
+//The servers of the standard numeric policies are instantiated here once
+//rather than in every file that uses them
+
+#define EVALUATOR_INSTANTIATE_SERVER(P) template class BasicEvalServer<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_SERVER)
+#undef EVALUATOR_INSTANTIATE_SERVER
\ No newline at end of file
@@ -0,0 +1,456 @@
+#ifndef EVAL_SERVER_H
+#define EVAL_SERVER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "EvalError.h"
+#include "EvalProtocol.h"
+#include "Evaluator.h"
+#include "ExpressionImage.h"
+#include "ThreadPool.h"
+
+//Limits of a BasicEvalServer
+struct EvalServerLimits {
+    size_t maxConnections = 1024;       ///< Clients connected at once; more are turned away
+    size_t maxRequest = 1 << 20;        ///< Longest expression accepted
+    size_t maxPendingOutput = 4 << 20;  ///< Unsent response bytes after which a client's requests aren't read
+};
+
+//Totals of a BasicEvalServer run
+struct EvalServerStats {
+    uint64_t connections = 0;  ///< Clients accepted
+    uint64_t requests = 0;     ///< Expressions evaluated
+    uint64_t errors = 0;       ///< Expressions that produced an error
+    uint64_t bytes = 0;        ///< Expression text received
+    uint64_t batches = 0;      ///< Rounds of the event loop that evaluated something
+};
+
+//class BasicEvalServer
+//Serves evaluation requests (see EvalProtocol.h) on a Unix domain socket
+//from a single epoll loop. Each round reads whatever every ready client has
+//sent, evaluates all of it as one batch (split over a thread pool when one
+//is given and the batch is large) and writes each client's responses back
+//with one send, so pipelined clients cost a few system calls per batch
+//rather than per request.
+template <class Policy>
+class BasicEvalServer {
+public:
+    using value_type = typename Policy::value_type;
+
+    //Bytes read from one client per round, so a busy client can't starve the rest
+    static constexpr size_t ReadSize = 256 << 10;
+
+    //Clients reported ready per round
+    static constexpr size_t MaxEvents = 256;
+
+    //Smallest batch worth splitting across threads, and expressions per task
+    static constexpr size_t MinParallelBatch = 1024;
+    static constexpr size_t Grain = 256;
+
+private:
+    //State of one client
+    struct Connection {
+        int fd = -1;
+        std::string input;      ///< Received bytes not yet answered
+        size_t parsed = 0;      ///< Bytes of input taken into the batch
+        std::string output;     ///< Responses not yet sent
+        size_t sent = 0;        ///< Bytes of output sent
+        uint32_t events = 0;    ///< Events the epoll set watches for
+        bool closing = false;   ///< Client is done sending (or broke the protocol); close once output is sent
+        bool failed = false;    ///< Socket error; close without sending anything more
+        bool active = false;    ///< Already listed in this round's active connections
+    };
+
+    //A request taken into the batch
+    struct Request {
+        Connection* connection;
+        uint32_t id;
+        std::string_view expr;  ///< Points into the connection's input
+        bool rejected;          ///< Longer than the limit; answered with LimitExceeded
+    };
+
+    //Result of one request
+    struct Outcome {
+        value_type value = 0;
+        ErrorKind error = ErrorKind::None;
+        size_t position = EvalError::npos;
+    };
+
+    const BasicEvaluator<Policy>& evaluator;
+    ThreadPool* pool;
+    EvalServerLimits limits;
+    std::string socketPath;
+    int listener = -1;
+    int poller = -1;
+    int wakeup = -1;  ///< eventfd written by stop()
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<Connection*> active;  ///< Connections read or written this round
+    std::vector<Request> batch;
+    std::vector<Outcome> outcomes;
+    std::vector<char> scratch;        ///< Receives data before it is appended to an input
+    EvalServerStats totals;
+
+    //Add fd to the epoll set
+    void watch(int fd, uint32_t events);
+
+    //Accept every pending client
+    void acceptConnections();
+
+    //Read what a client sent and take its complete requests into the batch
+    void readRequests(Connection& connection);
+
+    //Evaluate the batch and queue the responses
+    void evaluateBatch();
+
+    //Send as much queued output as the socket takes
+    void writeResponses(Connection& connection);
+
+    //Watch for the events a connection is waiting for; close it if it is done
+    void settle(Connection& connection);
+
+    //List a connection as active this round
+    void markActive(Connection& connection);
+
+public:
+    //Listen at path and evaluate with evaluator, splitting large batches over
+    //pool when one is given (throws std::system_error if the socket can't be set up)
+    BasicEvalServer(const BasicEvaluator<Policy>& expressionEvaluator, const std::string& path,
+                    ThreadPool* threads = nullptr, EvalServerLimits serverLimits = {});
+    ~BasicEvalServer();
+
+    BasicEvalServer(const BasicEvalServer&) = delete;
+    BasicEvalServer& operator=(const BasicEvalServer&) = delete;
+
+    //Serve clients until stop() is called
+    void run();
+
+    //Make run() return after its current round. Safe to call from another
+    //thread or from a signal handler.
+    void stop();
+
+    //Totals so far
+    const EvalServerStats& stats() const { return totals; }
+};
+
+//Evaluation server of the default (32-bit int) evaluator
+using EvalServer = BasicEvalServer<Int32Policy>;
+
+//Listen at path
+
+template <class Policy>
+BasicEvalServer<Policy>::BasicEvalServer(const BasicEvaluator<Policy>& expressionEvaluator, const std::string& path,
+                                         ThreadPool* threads, EvalServerLimits serverLimits)
+    : evaluator(expressionEvaluator), pool(threads), limits(serverLimits), socketPath(path), scratch(64 << 10) {
+    poller = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (poller < 0 || wakeup < 0) {
+        int error = errno;
+        if (poller >= 0) ::close(poller);
+        if (wakeup >= 0) ::close(wakeup);
+        throw std::system_error(error, std::generic_category(), "Can't set up the event loop");
+    }
+    try {
+        listener = listenUnixSocket(path);
+        watch(listener, EPOLLIN);
+        watch(wakeup, EPOLLIN);
+    } catch (...) {
+        if (listener >= 0) {
+            ::close(listener);
+            ::unlink(socketPath.c_str());
+        }
+        ::close(poller);
+        ::close(wakeup);
+        throw;
+    }
+}
+
+//Close every client and remove the socket file
+
+template <class Policy>
+BasicEvalServer<Policy>::~BasicEvalServer() {
+    for (auto& [fd, connection] : connections) ::close(fd);
+    ::close(listener);
+    ::unlink(socketPath.c_str());
+    ::close(poller);
+    ::close(wakeup);
+}
+
+//Add fd to the epoll set
+
+template <class Policy>
+void BasicEvalServer<Policy>::watch(int fd, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (::epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Can't watch a socket");
+    }
+}
+
+//Make run() return after its current round
+
+template <class Policy>
+void BasicEvalServer<Policy>::stop() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wakeup, &one, sizeof(one));
+}
+
+//List a connection as active this round
+
+template <class Policy>
+void BasicEvalServer<Policy>::markActive(Connection& connection) {
+    if (!connection.active) {
+        connection.active = true;
+        active.push_back(&connection);
+    }
+}
+
+//Accept every pending client
+
+template <class Policy>
+void BasicEvalServer<Policy>::acceptConnections() {
+    ProtocolGreeting greeting{};
+    std::memcpy(greeting.magic, ProtocolMagic, sizeof(greeting.magic));
+    greeting.version = ProtocolVersion;
+    greeting.policy = imagePolicyTag<Policy>();
+    greeting.maxRequest = static_cast<uint32_t>(std::min<size_t>(limits.maxRequest, UINT32_MAX));
+
+    for (;;) {
+        int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // Out of descriptors or a client that gave up: try again next round
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+        if (connections.size() >= limits.maxConnections) {
+            ::close(fd);
+            continue;
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->output.append(reinterpret_cast<const char*>(&greeting), sizeof(greeting));
+        // Output is pending, so the first settle() adds EPOLLOUT if the greeting doesn't go out at once
+        connection->events = EPOLLIN;
+        watch(fd, EPOLLIN);
+        totals.connections++;
+        markActive(*connection);
+        connections.emplace(fd, std::move(connection));
+    }
+}
+
+/**
+ * Read what a client sent and take its complete requests into the batch
+ * At most ReadSize bytes are read per round. Requests stay where they were
+ * received and the batch refers to them in place; a request cut off by the
+ * end of what has arrived waits for the next round. A request longer than
+ * the limit can't be skipped without reading it, so it is answered with
+ * LimitExceeded and the client is disconnected once its responses are sent.
+ */
+template <class Policy>
+void BasicEvalServer<Policy>::readRequests(Connection& connection) {
+    size_t budget = ReadSize;
+    while (budget > 0) {
+        size_t wanted = std::min(scratch.size(), budget);
+        ssize_t count = ::recv(connection.fd, scratch.data(), wanted, 0);
+        if (count > 0) {
+            connection.input.append(scratch.data(), static_cast<size_t>(count));
+            budget -= static_cast<size_t>(count);
+            if (static_cast<size_t>(count) < wanted) break;
+            continue;
+        }
+        if (count == 0) {
+            connection.closing = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            connection.failed = true;
+        }
+        break;
+    }
+
+    std::string_view input = connection.input;
+    while (!connection.failed && input.size() - connection.parsed >= sizeof(RequestHeader)) {
+        RequestHeader header;
+        std::memcpy(&header, input.data() + connection.parsed, sizeof(header));
+        if (header.length > limits.maxRequest) {
+            batch.push_back({&connection, header.id, {}, true});
+            connection.closing = true;
+            connection.parsed = input.size();
+            break;
+        }
+        if (input.size() - connection.parsed - sizeof(header) < header.length) break;
+        batch.push_back({&connection, header.id, input.substr(connection.parsed + sizeof(header), header.length), false});
+        connection.parsed += sizeof(header) + header.length;
+        totals.bytes += header.length;
+    }
+}
+
+/**
+ * Evaluate the batch and queue the responses
+ * Outcomes are computed first (on the pool for a large batch) and encoded
+ * afterwards in batch order, which keeps each client's responses in the
+ * order of its requests.
+ */
+template <class Policy>
+void BasicEvalServer<Policy>::evaluateBatch() {
+    if (batch.empty()) return;
+    outcomes.assign(batch.size(), Outcome{});
+
+    auto evaluateRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (batch[i].rejected) {
+                outcomes[i].error = ErrorKind::LimitExceeded;
+                continue;
+            }
+            try {
+                outcomes[i].value = evaluator.eval(batch[i].expr);
+            } catch (const EvalError& e) {
+                outcomes[i].error = e.kind();
+                outcomes[i].position = e.position();
+            }
+        }
+    };
+    if (pool && pool->size() > 1 && batch.size() >= MinParallelBatch) {
+        pool->parallelFor(batch.size(), Grain, evaluateRange);
+    } else {
+        evaluateRange(0, batch.size());
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        const Outcome& outcome = outcomes[i];
+        if (outcome.error != ErrorKind::None) totals.errors++;
+        Connection& connection = *batch[i].connection;
+        if (connection.failed) continue;
+        appendResponse(connection.output, batch[i].id, outcome.value, outcome.error, outcome.position);
+    }
+    totals.requests += batch.size();
+    totals.batches++;
+    batch.clear();
+}
+
+//Send as much queued output as the socket takes
+
+template <class Policy>
+void BasicEvalServer<Policy>::writeResponses(Connection& connection) {
+    while (!connection.failed && connection.sent < connection.output.size()) {
+        ssize_t count = ::send(connection.fd, connection.output.data() + connection.sent,
+                               connection.output.size() - connection.sent, MSG_NOSIGNAL);
+        if (count > 0) {
+            connection.sent += static_cast<size_t>(count);
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) connection.failed = true;
+            break;
+        }
+    }
+    if (connection.sent == connection.output.size()) {
+        connection.output.clear();
+        connection.sent = 0;
+    } else if (connection.sent >= (64 << 10)) {
+        connection.output.erase(0, connection.sent);
+        connection.sent = 0;
+    }
+}
+
+/**
+ * Watch for the events a connection is waiting for; close it if it is done
+ * Answered requests are dropped from the input. Reading stops while the
+ * client has more unsent responses than the limit (it isn't collecting
+ * them), and writing is only watched while responses are pending.
+ */
+template <class Policy>
+void BasicEvalServer<Policy>::settle(Connection& connection) {
+    connection.active = false;
+    size_t pending = connection.output.size() - connection.sent;
+    if (connection.failed || (connection.closing && pending == 0)) {
+        int fd = connection.fd;
+        ::close(fd);  // Also removes it from the epoll set
+        connections.erase(fd);
+        return;
+    }
+
+    connection.input.erase(0, connection.parsed);
+    connection.parsed = 0;
+
+    uint32_t events = 0;
+    if (!connection.closing && pending < limits.maxPendingOutput) events |= EPOLLIN;
+    if (pending > 0) events |= EPOLLOUT;
+    if (events != connection.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = connection.fd;
+        ::epoll_ctl(poller, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+}
+
+/**
+ * Serve clients until stop() is called
+ * Each round waits for events, reads every ready client into one batch,
+ * evaluates it, and then writes and settles every client touched by the
+ * round. Connections are only closed in settle(), after the batch that
+ * refers to their input is done.
+ */
+template <class Policy>
+void BasicEvalServer<Policy>::run() {
+    epoll_event events[MaxEvents];
+    bool stopping = false;
+    while (!stopping) {
+        int ready = ::epoll_wait(poller, events, MaxEvents, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "Event loop failed");
+        }
+
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listener) {
+                acceptConnections();
+                continue;
+            }
+            if (fd == wakeup) {
+                uint64_t count;
+                [[maybe_unused]] ssize_t read = ::read(wakeup, &count, sizeof(count));
+                stopping = true;
+                continue;
+            }
+            auto found = connections.find(fd);
+            if (found == connections.end()) continue;
+            Connection& connection = *found->second;
+            markActive(connection);
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                if (connection.events & EPOLLIN) {
+                    readRequests(connection);
+                } else if (events[i].events & EPOLLERR) {
+                    connection.failed = true;
+                }
+            }
+        }
+
+        evaluateBatch();
+        for (Connection* connection : active) writeResponses(*connection);
+        for (Connection* connection : active) settle(*connection);
+        active.clear();
+    }
+}
+
+// The standard policies are instantiated once, in EvalServer.cpp
+#define EVALUATOR_EXTERN_SERVER(P) extern template class BasicEvalServer<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_SERVER)
+#undef EVALUATOR_EXTERN_SERVER
+
+#endif // EVAL_SERVER_H
\ No newline at end of file
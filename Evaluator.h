@@ -1,49 +1,309 @@
 #ifndef EVALUATOR_H
 #define EVALUATOR_H
 
+#include <algorithm>
 #include <iostream>
-#include <stack>
+#include <memory>
+#include <span>
 #include <string>
-#include <cctype>
+#include <string_view>
 #include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "Lexer.h"
+#include "EvalError.h"
+#include "Instrumentation.h"
+#include "NumericPolicy.h"
+#include "Operations.h"
+#include "CompiledExpression.h"
+#include "Ast.h"
+#include "Translator.h"
+#include "SmallStack.h"
+#include "ThreadPool.h"
+
+template <class Policy> class BasicExpressionCache;
+
+//A named column of variable values for BasicEvaluator::evalBatch
+template <class T>
+struct BasicColumn {
+    std::string_view name;      ///< Variable name as written in the expression
+    std::span<const T> values;  ///< One value per row
+};
+
+//Outcome of one expression evaluated by BasicEvaluator::evalMany
+template <class T>
+struct BasicEvalResult {
+    T value = 0;                              ///< Result when ok()
+    ErrorKind error = ErrorKind::None;        ///< What went wrong otherwise
+    size_t position = EvalError::npos;        ///< Where it went wrong
+    std::string message;                      ///< Same text as EvalError::what()
+
+    bool ok() const { return error == ErrorKind::None; }
+};
+
+//class ValueSink
+//Sink for translate() that computes the value directly on an operand stack.
+//A division by zero (or overflow) is only recorded: it is raised once the
+//whole input has been checked, because syntax errors take priority over
+//evaluation errors. The right operand of && and || is still parsed when the
+//left operand decides the result, but nothing in it is computed and it can't fail.
+template <class Policy>
+struct ValueSink {
+    using value_type = typename Policy::value_type;
+
+    SmallStack<value_type, 64> operands;
+    SmallStack<bool, 32> decided;       ///< Per open && / ||: did the left operand decide it?
+    size_t skipping = 0;                ///< Open && / || whose right operand is skipped
+    ErrorKind fault = ErrorKind::None;  ///< First evaluation error, if any
+    size_t faultAt = 0;                 ///< Offset of the faulting operator
+
+    constexpr ErrorKind operand(std::string_view digits, size_t) {
+        value_type value = 0;
+        ErrorKind error = Policy::parseLiteral(digits, value);
+        operands.push(value);
+        Instrumentation::noteStackDepth(operands.size());
+        return error;
+    }
+
+    //eval() has no variable bindings, so any variable is an error
+    constexpr void variable(std::string_view, size_t offset) {
+        if (fault == ErrorKind::None && skipping == 0) {
+            fault = ErrorKind::UnknownVariable;
+            faultAt = offset;
+        }
+        operands.push(0);
+        Instrumentation::noteStackDepth(operands.size());
+    }
+
+    constexpr void shortCircuit(Op op, size_t) {
+        bool decides = skipping == 0 && fault == ErrorKind::None &&
+                       (op == Op::And) != Policy::truthy(operands.top());
+        decided.push(decides);
+        if (decides) skipping++;
+    }
+
+    constexpr void apply(Op op, size_t offset) {
+        value_type result = 0;
+        if (opInfo(op).arity == 1) {
+            if (fault != ErrorKind::None || skipping > 0) return;
+            Instrumentation::countOperator(op);
+            ErrorKind error = tryUnaryOperation<Policy>(op, operands.top(), result);
+            record(error, offset, result);
+            return;
+        }
+        value_type b = operands.top();  // Right operand
+        operands.pop();
+
+        if (op == Op::And || op == Op::Or) {
+            bool wasDecided = decided.top();
+            decided.pop();
+            if (wasDecided) {
+                skipping--;
+                if (skipping == 0 && fault == ErrorKind::None) Instrumentation::countOperator(op);
+                operands.top() = (op == Op::Or);  // The left operand's verdict
+                return;
+            }
+        }
+        // Values are meaningless past a fault or inside a skipped operand
+        if (fault != ErrorKind::None || skipping > 0) return;
+        Instrumentation::countOperator(op);
+        ErrorKind error = tryOperation<Policy>(op, operands.top(), b, result);
+        record(error, offset, result);
+    }
+
+    //Replace the top of the stack with a result, or remember the first error
+    constexpr void record(ErrorKind error, size_t offset, value_type result) {
+        if (error != ErrorKind::None) {
+            fault = error;
+            faultAt = offset;
+            return;
+        }
+        operands.top() = result;
+    }
+};
+
+/**
+ * Evaluate an infix expression string in a single pass
+ * The expression is parsed and computed at once, without building a tree
+ * or program. Everything is constexpr, so this also runs during
+ * compilation (see evalConstant()).
+ */
+template <class Policy>
+constexpr typename Policy::value_type evaluateExpression(std::string_view expr) {
+    ValueSink<Policy> sink;
+    translate(expr, sink);
+    if (sink.fault != ErrorKind::None) {
+        throw EvalError(sink.fault, sink.faultAt);
+    }
+
+    // The final result should be the only item left on the operand stack
+    return sink.operands.empty() ? 0 : sink.operands.top();
+}
+
+//class BasicEvaluator
+//Evaluates expressions with the value type and arithmetic of a numeric
+//policy (see NumericPolicy.h); Evaluator is the 32-bit int flavour.
+//All parse state lives in the call that needs it, so a single (const)
+//evaluator can be shared by any number of threads.
+template <class Policy>
+class BasicEvaluator {
+public:
+    using value_type = typename Policy::value_type;
+    using Column = BasicColumn<value_type>;
+    using Result = BasicEvalResult<value_type>;
+    using Compiled = BasicCompiledExpression<Policy>;
+    using Cache = BasicExpressionCache<Policy>;
 
-//class Evaluator
-class Evaluator {
 private:
-    std::string expression;  ///< The current expression being parsed
-    size_t pos;             ///< Current position in the expression string
-    
-    //Get the precedence value for an operator
-    int getPrecedence(const std::string& op);
-    
-    //Check if a string is a valid operator
-    bool isOperator(const std::string& op);
-    
-    //Check if an operator can be used as a unary operator
-    bool isUnaryOperator(const std::string& op);
-    
-    //Perform a binary arithmetic or logical operation
-    int performOperation(int a, int b, const std::string& op);
-    
-    //Perform a unary operation
-    int performUnaryOperation(int a, const std::string& op);
-    
-    //Skip whitespace characters in the expression
-    void skipWhitespace();
-    
-    //Parse a multi-digit number from the current position
-    int parseNumber();
-    
-    //Parse the next operator from the current position
-    std::string parseOperator();
-    
-    //Validate the expression for syntax errors
-    void validateExpression();
+    std::shared_ptr<Cache> cache;  ///< Optional cache used by eval()
 
 public:
+    BasicEvaluator() = default;
+
+    //Evaluator whose eval() looks expressions up in a (shareable) cache
+    explicit BasicEvaluator(std::shared_ptr<Cache> expressionCache)
+        : cache(std::move(expressionCache)) {}
+
+    //Validate and convert an infix expression into a reusable program
+    Compiled compile(std::string_view expr) const;
+
     //Evaluate an infix expression string
+    value_type eval(std::string_view expr) const;
+
+    //Evaluate a batch of independent expressions on a thread pool.
+    //Results (or errors) come back in input order.
+    std::vector<Result> evalMany(std::span<const std::string_view> exprs,
+                                 ThreadPool& pool = ThreadPool::shared()) const;
+
+    //Evaluate an expression once per row, binding each variable to the column
+    //of the same name and writing one result per row to out (see
+    //BasicCompiledExpression::runBatch)
+    void evalBatch(std::string_view expr, std::span<const Column> columns, std::span<value_type> out) const;
 
-    int eval(const std::string& expr);
+    //Batch evaluation of the default evaluator over 64-bit columns, with
+    //64-bit wrap-around arithmetic as before evaluators took a policy
+    void evalBatch(std::string_view expr, std::span<const BasicColumn<int64_t>> columns,
+                   std::span<int64_t> out) const
+        requires std::is_same_v<Policy, Int32Policy>;
 };
 
+//The default evaluator: 32-bit int arithmetic that wraps around on overflow.
+//Its batch columns stay 64-bit (see the second evalBatch overload).
+using Evaluator = BasicEvaluator<Int32Policy>;
+using Column = BasicEvaluator<Int64Policy>::Column;
+using EvalResult = BasicEvalResult<int32_t>;
+
+//Validate and convert an infix expression into a reusable program
+
+template <class Policy>
+typename BasicEvaluator<Policy>::Compiled BasicEvaluator<Policy>::compile(std::string_view expr) const {
+    Compiled compiled;
+
+    // The tree only lives for this call: one arena block sized for the
+    // expression holds every node and is released in one go
+    using Node = BasicNode<value_type>;
+    Arena arena(expr.size() * 2 * sizeof(Node) + 256);
+    AstBuilder<Policy> builder(arena, compiled.variableNames);
+    Node* root;
+    {
+        Instrumentation::PhaseTimer timer(Phase::Parse);
+        translate(expr, builder);
+    }
+    {
+        Instrumentation::PhaseTimer timer(Phase::Optimize);
+        root = AstOptimizer<Policy>(arena).optimize(builder.root());
+    }
+    Instrumentation::PhaseTimer timer(Phase::Emit);
+    emitProgram(root, compiled.program, compiled.constants, compiled.maxDepth);
+    return compiled;
+}
+
+//Evaluate an infix expression string
+
+template <class Policy>
+typename Policy::value_type BasicEvaluator<Policy>::eval(std::string_view expr) const {
+    Instrumentation::PhaseTimer timer(Phase::Evaluate);
+    if (cache) {
+        // Positions are relative to the normalized key; report them in expr
+        std::shared_ptr<const typename Cache::Entry> entry = cache->lookup(expr);
+        if (entry->error != ErrorKind::None) {
+            throw EvalError(entry->error, Cache::originalPosition(expr, entry->key, entry->errorPosition));
+        }
+        try {
+            return entry->compiled.run();
+        } catch (const EvalError& e) {
+            throw EvalError(e.kind(), Cache::originalPosition(expr, entry->key, e.position()));
+        }
+    }
+
+    return evaluateExpression<Policy>(expr);
+}
+
+//Evaluate an expression over columns of variable values
+
+template <class Policy>
+void BasicEvaluator<Policy>::evalBatch(std::string_view expr, std::span<const Column> columns,
+                                       std::span<value_type> out) const {
+    Compiled compiled = compile(expr);
+
+    // Bind each variable the expression uses to its column
+    std::vector<std::span<const value_type>> bound(compiled.variables().size());
+    std::vector<bool> found(bound.size(), false);
+    for (const Column& column : columns) {
+        int index = compiled.variableIndex(column.name);
+        if (index >= 0) {
+            bound[index] = column.values;
+            found[index] = true;
+        }
+    }
+    auto missing = std::find(found.begin(), found.end(), false);
+    if (missing != found.end()) {
+        compiled.throwUnboundVariable(missing - found.begin());
+    }
+
+    compiled.runBatch(bound, out);
+}
+
+//Evaluate an expression over 64-bit columns of variable values
+
+template <class Policy>
+void BasicEvaluator<Policy>::evalBatch(std::string_view expr, std::span<const BasicColumn<int64_t>> columns,
+                                       std::span<int64_t> out) const
+    requires std::is_same_v<Policy, Int32Policy>
+{
+    BasicEvaluator<Int64Policy>().evalBatch(expr, columns, out);
+}
+
+//Evaluate a batch of independent expressions on a thread pool
+
+template <class Policy>
+std::vector<typename BasicEvaluator<Policy>::Result>
+BasicEvaluator<Policy>::evalMany(std::span<const std::string_view> exprs, ThreadPool& pool) const {
+    // Expressions per task: large enough to amortize scheduling, small enough
+    // for stealing to balance batches with a few long expressions
+    constexpr size_t Grain = 256;
+
+    std::vector<Result> results(exprs.size());
+    pool.parallelFor(exprs.size(), Grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            try {
+                results[i].value = eval(exprs[i]);
+            } catch (const EvalError& e) {
+                results[i].error = e.kind();
+                results[i].position = e.position();
+                results[i].message = e.what();
+            }
+        }
+    });
+    return results;
+}
+
+// eval() looks expressions up in the cache, which compiles through the evaluator
+#include "ExpressionCache.h"
+
+// The standard policies are instantiated once, in Evaluator.cpp
+#define EVALUATOR_EXTERN_EVALUATOR(P) extern template class BasicEvaluator<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_EVALUATOR)
+#undef EVALUATOR_EXTERN_EVALUATOR
+
 #endif // EVALUATOR_H
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "ExpressionCache.h"
+#include "Evaluator.h"
+
+namespace {
+
+//Check whether removing the whitespace between two characters would merge them
+//into one token (a longer number or name, or a two-character operator)
+bool wouldJoin(char left, char right) {
+    if (isNameChar(left) && isNameChar(right)) return true;
+    switch (left) {
+    case '+': return right == '+';
+    case '-': return right == '-';
+    case '&': return right == '&';
+    case '|': return right == '|';
+    case '>': case '<': case '=': case '!': return right == '=';
+    default:  return false;
+    }
+}
+
+} // namespace
+
+/**
+ * Write the normalized form of expr into key
+ * Whitespace runs are dropped unless they separate characters that would
+ * otherwise form a single token ("1 2", "- -5"); those become one space.
+ * Leading whitespace is kept as one space as well, because an expression
+ * that starts with ")" is reported differently from one that starts with " )".
+ */
+void ExpressionKeys::normalize(std::string_view expr, std::string& key) {
+    key.clear();
+    size_t i = 0;
+    while (i < expr.size()) {
+        // Copy the run up to the next whitespace in one go
+        size_t space = findSpace(expr, i);
+        key.append(expr.substr(i, space - i));
+        if (space == expr.size()) break;
+
+        i = skipSpaces(expr, space);
+        if (key.empty() || (i < expr.size() && wouldJoin(key.back(), expr[i]))) {
+            key.push_back(' ');
+        }
+    }
+}
+
+//Translate a position within a normalized key back to the original text
+
+size_t ExpressionKeys::originalPosition(std::string_view expr, std::string_view key, size_t position) {
+    if (position == EvalError::npos || position == 0) return position;
+    if (position >= key.size()) return expr.size();
+
+    // Errors point at tokens, so count the non-space characters before the
+    // position and find the same character in the original text
+    size_t before = 0;
+    for (size_t i = 0; i < position; i++) {
+        if (key[i] != ' ') before++;
+    }
+    for (size_t i = 0; i < expr.size(); i++) {
+        if (!isSpaceChar(expr[i]) && before-- == 0) return i;
+    }
+    return expr.size();
+}
+
+//The caches of the standard numeric policies are instantiated here once
+
+#define EVALUATOR_INSTANTIATE_CACHE(P) template class BasicExpressionCache<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_CACHE)
+#undef EVALUATOR_INSTANTIATE_CACHE
\ No newline at end of file
@@ -0,0 +1,230 @@
+#ifndef EXPRESSION_CACHE_H
+#define EXPRESSION_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "CompiledExpression.h"
+#include "EvalError.h"
+#include "Instrumentation.h"
+#include "NumericPolicy.h"
+
+template <class Policy> class BasicEvaluator;
+
+//class ExpressionKeys
+//Key normalization shared by the caches of every numeric policy
+class ExpressionKeys {
+public:
+    //Write the normalized form of expr into key
+    static void normalize(std::string_view expr, std::string& key);
+
+    //Translate a position within a normalized key back to the original text
+    static size_t originalPosition(std::string_view expr, std::string_view key, size_t position);
+};
+
+//class BasicExpressionCache
+//Bounded cache from expression text to its compiled program (or to the
+//syntax error it produces). Keys are normalized by dropping whitespace that
+//doesn't separate tokens, so "1 + 2" and "1+2" share an entry.
+//
+//The cache is split into shards, each a CLOCK cache behind a shared_mutex:
+//hits only take the shard's lock in shared mode and mark the entry as
+//recently used, so concurrent readers never serialize.
+template <class Policy>
+class BasicExpressionCache : public ExpressionKeys {
+public:
+    //A cached compilation result
+    struct Entry {
+        std::string key;                      ///< Normalized expression text
+        BasicCompiledExpression<Policy> compiled;  ///< Program, when error is None
+        ErrorKind error = ErrorKind::None;    ///< Syntax error of the expression
+        size_t errorPosition = EvalError::npos;  ///< Position within key
+    };
+
+    //Counter snapshot
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+private:
+    //A CLOCK slot
+    struct Slot {
+        std::shared_ptr<const Entry> entry;
+        std::atomic<bool> referenced{false};  ///< Set on every hit, cleared by the hand
+    };
+
+    //One independently locked part of the cache
+    struct Shard {
+        std::shared_mutex lock;
+        std::unordered_map<std::string_view, size_t> index;  ///< Key (owned by the entry) -> slot
+        std::unique_ptr<Slot[]> slots;
+        size_t used = 0;   ///< Slots filled so far
+        size_t hand = 0;   ///< CLOCK hand
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t slotsPerShard;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    //Store a freshly compiled entry, keeping one that another thread added first
+    std::shared_ptr<const Entry> insert(Shard& shard, std::shared_ptr<const Entry> entry);
+
+public:
+    //Hold about capacity entries spread over shardCount shards
+    explicit BasicExpressionCache(size_t capacity = 4096, size_t shardCount = 16);
+
+    BasicExpressionCache(const BasicExpressionCache&) = delete;
+    BasicExpressionCache& operator=(const BasicExpressionCache&) = delete;
+
+    //Find the compiled form of an expression, compiling it on a miss
+    std::shared_ptr<const Entry> lookup(std::string_view expr);
+
+    //Remove every entry (counters are kept)
+    void clear();
+
+    //Current counters
+    Stats stats() const;
+};
+
+//Cache for the default (32-bit int) evaluator
+using ExpressionCache = BasicExpressionCache<Int32Policy>;
+
+//Hold about capacity entries spread over shardCount shards
+
+template <class Policy>
+BasicExpressionCache<Policy>::BasicExpressionCache(size_t capacity, size_t shardCount) {
+    shardCount = std::max<size_t>(shardCount, 1);
+    slotsPerShard = std::max<size_t>((capacity + shardCount - 1) / shardCount, 1);
+    for (size_t i = 0; i < shardCount; i++) {
+        auto shard = std::make_unique<Shard>();
+        shard->slots.reset(new Slot[slotsPerShard]);
+        shard->index.reserve(slotsPerShard);
+        shards.push_back(std::move(shard));
+    }
+}
+
+//Find the compiled form of an expression, compiling it on a miss
+
+template <class Policy>
+std::shared_ptr<const typename BasicExpressionCache<Policy>::Entry> BasicExpressionCache<Policy>::lookup(std::string_view expr) {
+    Instrumentation::PhaseTimer timer(Phase::CacheLookup);
+
+    // Reused per thread so a hit never allocates
+    thread_local std::string key;
+    normalize(expr, key);
+
+    size_t hash = std::hash<std::string_view>{}(key);
+    Shard& shard = *shards[hash % shards.size()];
+
+    {
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            Slot& slot = shard.slots[found->second];
+            slot.referenced.store(true, std::memory_order_relaxed);
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return slot.entry;
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+
+    // Compile outside the lock; syntax errors are cached like programs
+    auto entry = std::make_shared<Entry>();
+    entry->key = key;
+    try {
+        entry->compiled = BasicEvaluator<Policy>().compile(entry->key);
+    } catch (const EvalError& e) {
+        entry->error = e.kind();
+        entry->errorPosition = e.position();
+    }
+    return insert(shard, std::move(entry));
+}
+
+//Store a freshly compiled entry, keeping one that another thread added first
+
+template <class Policy>
+std::shared_ptr<const typename BasicExpressionCache<Policy>::Entry>
+BasicExpressionCache<Policy>::insert(Shard& shard, std::shared_ptr<const Entry> entry) {
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+
+    auto found = shard.index.find(entry->key);
+    if (found != shard.index.end()) {
+        return shard.slots[found->second].entry;
+    }
+
+    size_t victim;
+    if (shard.used < slotsPerShard) {
+        victim = shard.used++;
+    } else {
+        // Advance the hand, giving recently used entries a second chance
+        while (shard.slots[shard.hand].referenced.exchange(false, std::memory_order_relaxed)) {
+            shard.hand = (shard.hand + 1) % slotsPerShard;
+        }
+        victim = shard.hand;
+        shard.hand = (shard.hand + 1) % slotsPerShard;
+        shard.index.erase(shard.slots[victim].entry->key);
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Slot& slot = shard.slots[victim];
+    slot.entry = std::move(entry);
+    slot.referenced.store(false, std::memory_order_relaxed);
+    shard.index.emplace(slot.entry->key, victim);
+    return slot.entry;
+}
+
+//Remove every entry
+
+template <class Policy>
+void BasicExpressionCache<Policy>::clear() {
+    for (auto& shard : shards) {
+        std::unique_lock<std::shared_mutex> guard(shard->lock);
+        shard->index.clear();
+        for (size_t i = 0; i < shard->used; i++) {
+            shard->slots[i].entry.reset();
+        }
+        shard->used = 0;
+        shard->hand = 0;
+    }
+}
+
+//Current counters
+
+template <class Policy>
+typename BasicExpressionCache<Policy>::Stats BasicExpressionCache<Policy>::stats() const {
+    Stats result;
+    result.hits = hits.load();
+    result.misses = misses.load();
+    result.evictions = evictions.load();
+    result.capacity = slotsPerShard * shards.size();
+    for (const auto& shard : shards) {
+        std::shared_lock<std::shared_mutex> guard(shard->lock);
+        result.size += shard->used;
+    }
+    return result;
+}
+
+// Misses compile through the evaluator
+#include "Evaluator.h"
+
+// The standard policies are instantiated once, in ExpressionCache.cpp
+#define EVALUATOR_EXTERN_CACHE(P) extern template class BasicExpressionCache<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_CACHE)
+#undef EVALUATOR_EXTERN_CACHE
+
+#endif // EXPRESSION_CACHE_H
\ No newline at end of file
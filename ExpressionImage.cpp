@@ -0,0 +1,237 @@
+#include "ExpressionImage.h"
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char ImageMagic[8] = {'E', 'X', 'P', 'R', 'I', 'M', 'G', '\0'};
+
+//Size of one element of each section (the value size for Constants)
+size_t elementSize(ImageSection section, size_t valueSize) {
+    switch (section) {
+    case ImageSection::Entries:      return sizeof(ImageEntry);
+    case ImageSection::Instructions: return sizeof(ImageInstruction);
+    case ImageSection::Constants:    return valueSize;
+    case ImageSection::Names:        return sizeof(ImageName);
+    default:                         return 1;
+    }
+}
+
+//Round up to the section alignment
+uint64_t alignSection(uint64_t offset) {
+    return (offset + ImageAlignment - 1) & ~static_cast<uint64_t>(ImageAlignment - 1);
+}
+
+[[noreturn]] void invalidImage(const std::string& path, const char* problem) {
+    throw std::runtime_error(path + ": " + problem);
+}
+
+/**
+ * Check that a stored program can't run outside its image
+ * Every opcode must exist, Push and Load must index this expression's
+ * literals and variables, jumps must go forward within the program, and
+ * the operand stack must never underflow or outgrow stackDepth. A jump
+ * keeps its operand, so the depth where it lands must match the depth of
+ * the path falling through to the same instruction.
+ */
+bool checkProgram(std::span<const Instruction> program, const ImageEntry& entry, std::vector<int64_t>& depthAt) {
+    size_t count = program.size();
+    depthAt.assign(count + 1, -1);
+    int64_t depth = 0;
+
+    for (size_t pc = 0; pc < count; pc++) {
+        if (depthAt[pc] >= 0 && depthAt[pc] != depth) return false;
+
+        const Instruction& ins = program[pc];
+        switch (ins.code) {
+        case OpCode::Push:
+            if (ins.value < 0 || static_cast<uint32_t>(ins.value) >= entry.constantCount) return false;
+            depth++;
+            break;
+        case OpCode::Load:
+            if (ins.value < 0 || static_cast<uint32_t>(ins.value) >= entry.nameCount) return false;
+            depth++;
+            break;
+        case OpCode::Dup:
+            if (depth < 1) return false;
+            depth++;
+            break;
+        case OpCode::JumpIfFalse:
+        case OpCode::JumpIfTrue: {
+            if (depth < 1 || ins.value <= static_cast<int64_t>(pc) || static_cast<size_t>(ins.value) > count) {
+                return false;
+            }
+            int64_t& target = depthAt[static_cast<size_t>(ins.value)];
+            if (target >= 0 && target != depth) return false;
+            target = depth;
+            depth--;
+            break;
+        }
+        case OpCode::ToBool:
+            if (depth < 1) return false;
+            break;
+        default:
+            if (static_cast<uint8_t>(ins.code) > static_cast<uint8_t>(OpCode::Negate)) return false;
+            if (depth < opInfo(static_cast<Op>(ins.code)).arity) return false;
+            depth -= opInfo(static_cast<Op>(ins.code)).arity - 1;
+            break;
+        }
+        if (depth > static_cast<int64_t>(entry.stackDepth)) return false;
+    }
+    return depthAt[count] < 0 || depthAt[count] == depth;
+}
+
+} // namespace
+
+//64-bit checksum of a block of bytes, a word at a time
+
+uint64_t imageChecksum(std::string_view bytes) {
+    constexpr uint64_t Multiplier = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = bytes.size();
+    auto mix = [&](uint64_t word) {
+        hash = (hash ^ word) * Multiplier;
+        hash ^= hash >> 32;
+    };
+
+    size_t i = 0;
+    for (; i + 8 <= bytes.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + i, sizeof(word));
+        mix(word);
+    }
+    uint64_t tail = 0;
+    if (i < bytes.size()) std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+    mix(tail);
+    return hash;
+}
+
+/**
+ * Write an image file
+ * The sections are laid out at aligned offsets with zero padding in between,
+ * so the same expressions always produce the same bytes. The file is
+ * written under a temporary name and renamed into place.
+ */
+void writeImageFile(const std::string& path, uint32_t policy, uint32_t expressionCount,
+                    const ImageSectionData (&sections)[ImageSectionCount]) {
+    ImageHeader header{};
+    std::memcpy(header.magic, ImageMagic, sizeof(header.magic));
+    header.version = ImageVersion;
+    header.byteOrder = ImageByteOrderMark;
+    header.policy = policy;
+    header.expressionCount = expressionCount;
+
+    std::string body;
+    uint64_t offset = sizeof(ImageHeader);
+    for (size_t i = 0; i < ImageSectionCount; i++) {
+        uint64_t start = alignSection(offset);
+        body.append(start - offset, '\0');
+        header.sectionOffset[i] = start;
+        header.sectionCount[i] = sections[i].count;
+        body.append(static_cast<const char*>(sections[i].data), sections[i].bytes);
+        offset = start + sections[i].bytes;
+    }
+    header.fileSize = offset;
+    header.checksum = imageChecksum(body);
+
+    std::string temporary = path + ".tmp." + std::to_string(::getpid());
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Can't create " + temporary);
+    }
+    try {
+        OutputBuffer out(fd);
+        out.append(std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)));
+        out.append(body);
+        out.flush();
+    } catch (const std::system_error&) {
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw;
+    }
+    if (::close(fd) != 0 || ::rename(temporary.c_str(), path.c_str()) != 0) {
+        int error = errno;
+        ::unlink(temporary.c_str());
+        throw std::system_error(error, std::generic_category(), "Can't write " + path);
+    }
+}
+
+/**
+ * Check a mapped image
+ * The header must match this build (magic, version, byte order, policy and
+ * value size), the file must be complete, every section must be aligned
+ * and inside the file, and every entry must refer to ranges inside its
+ * sections. With verify the checksum, the variable names and every program
+ * (see checkProgram()) are checked too.
+ */
+const ImageHeader& checkImage(std::string_view file, const std::string& path, uint32_t policy, size_t valueSize,
+                              bool verify) {
+    if (file.size() < sizeof(ImageHeader)) invalidImage(path, "Not an expression image");
+    const ImageHeader& header = *reinterpret_cast<const ImageHeader*>(file.data());
+    if (std::memcmp(header.magic, ImageMagic, sizeof(ImageMagic)) != 0) {
+        invalidImage(path, "Not an expression image");
+    }
+    if (header.byteOrder != ImageByteOrderMark) invalidImage(path, "Image was written with another byte order");
+    if (header.version != ImageVersion) invalidImage(path, "Unsupported image version");
+    if (header.policy != policy) invalidImage(path, "Image was compiled for another numeric policy");
+    if (header.fileSize != file.size()) invalidImage(path, "Image is truncated");
+
+    for (size_t i = 0; i < ImageSectionCount; i++) {
+        uint64_t offset = header.sectionOffset[i];
+        uint64_t size = elementSize(static_cast<ImageSection>(i), valueSize);
+        if (offset % ImageAlignment != 0 || offset < sizeof(ImageHeader) || offset > file.size() ||
+            header.sectionCount[i] > (file.size() - offset) / size) {
+            invalidImage(path, "Image section lies outside the file");
+        }
+    }
+    auto sectionCount = [&](ImageSection section) { return header.sectionCount[static_cast<size_t>(section)]; };
+    if (sectionCount(ImageSection::Entries) != header.expressionCount) {
+        invalidImage(path, "Image directory doesn't match its header");
+    }
+
+    auto entries = reinterpret_cast<const ImageEntry*>(file.data() + header.sectionOffset[0]);
+    for (uint32_t i = 0; i < header.expressionCount; i++) {
+        const ImageEntry& entry = entries[i];
+        if (uint64_t(entry.firstInstruction) + entry.instructionCount > sectionCount(ImageSection::Instructions) ||
+            uint64_t(entry.firstConstant) + entry.constantCount > sectionCount(ImageSection::Constants) ||
+            uint64_t(entry.firstName) + entry.nameCount > sectionCount(ImageSection::Names) ||
+            entry.error >= static_cast<uint8_t>(ErrorKind::Count)) {
+            invalidImage(path, "Image directory is corrupt");
+        }
+    }
+    if (!verify) return header;
+
+    auto section = [&](ImageSection which) { return file.data() + header.sectionOffset[static_cast<size_t>(which)]; };
+    if (imageChecksum(file.substr(sizeof(ImageHeader))) != header.checksum) {
+        invalidImage(path, "Image checksum doesn't match");
+    }
+
+    auto names = reinterpret_cast<const ImageName*>(section(ImageSection::Names));
+    for (uint64_t i = 0; i < sectionCount(ImageSection::Names); i++) {
+        if (uint64_t(names[i].offset) + names[i].length > sectionCount(ImageSection::Strings)) {
+            invalidImage(path, "Image variable names are corrupt");
+        }
+    }
+
+    auto instructions = reinterpret_cast<const Instruction*>(section(ImageSection::Instructions));
+    std::vector<int64_t> depthAt;
+    for (uint32_t i = 0; i < header.expressionCount; i++) {
+        const ImageEntry& entry = entries[i];
+        if (!checkProgram({instructions + entry.firstInstruction, entry.instructionCount}, entry, depthAt)) {
+            invalidImage(path, "Image contains a malformed program");
+        }
+    }
+    return header;
+}
+
+//The images of the standard numeric policies are instantiated here once
+//rather than in every file that uses them
+
+#define EVALUATOR_INSTANTIATE_IMAGE(P)          \
+    template class BasicImageExpression<P>;     \
+    template class BasicExpressionImageWriter<P>; \
+    template class BasicExpressionImage<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_IMAGE)
+#undef EVALUATOR_INSTANTIATE_IMAGE
\ No newline at end of file
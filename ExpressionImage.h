@@ -0,0 +1,392 @@
+#ifndef EXPRESSION_IMAGE_H
+#define EXPRESSION_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "BulkIO.h"
+#include "CompiledExpression.h"
+#include "EvalError.h"
+#include "Evaluator.h"
+#include "NumericPolicy.h"
+
+/**
+ * Expression images
+ * An image is a file of compiled expressions that a process maps and runs
+ * in place: nothing is parsed, copied or allocated when it is loaded, and
+ * every process mapping the same image shares one copy of its pages.
+ *
+ * Layout (all sections 16-byte aligned, native byte order):
+ *   ImageHeader
+ *   Entries       ImageEntry per expression
+ *   Instructions  the programs of all expressions, back to back
+ *   Constants     their literals, as the policy's value_type
+ *   Names         ImageName per variable, in each expression's variables() order
+ *   Strings       the bytes of the variable names
+ *
+ * Programs refer to constants and variables by index and jump to instruction
+ * indices, so they run straight from the mapping through executeProgram().
+ * The header records the format version, the numeric policy the programs
+ * were compiled for and a checksum of everything after it.
+ */
+
+//Sections of an image, in file order
+enum class ImageSection : uint8_t {
+    Entries,
+    Instructions,
+    Constants,
+    Names,
+    Strings,
+    Count
+};
+
+inline constexpr size_t ImageSectionCount = static_cast<size_t>(ImageSection::Count);
+inline constexpr uint32_t ImageVersion = 1;
+inline constexpr uint32_t ImageByteOrderMark = 0x01020304;  ///< Reads differently on a foreign byte order
+inline constexpr size_t ImageAlignment = 16;
+
+//Start of every image file
+struct ImageHeader {
+    char magic[8];                                ///< "EXPRIMG" and a NUL
+    uint32_t version;                             ///< ImageVersion
+    uint32_t byteOrder;                           ///< ImageByteOrderMark
+    uint32_t policy;                              ///< imagePolicyTag() of the programs
+    uint32_t expressionCount;                     ///< Entries in the image
+    uint64_t fileSize;                            ///< Bytes in the whole file
+    uint64_t checksum;                            ///< imageChecksum() of the bytes after the header
+    uint64_t reserved;                            ///< Zero
+    uint64_t sectionOffset[ImageSectionCount];    ///< File offset of each section
+    uint64_t sectionCount[ImageSectionCount];     ///< Elements (bytes for Strings) in each section
+};
+
+//One expression of an image
+struct ImageEntry {
+    uint32_t firstInstruction;  ///< Index of its first instruction
+    uint32_t instructionCount;  ///< Instructions in its program
+    uint32_t firstConstant;     ///< Index of its first literal
+    uint32_t constantCount;     ///< Literals its program refers to
+    uint32_t firstName;         ///< Index of its first variable name
+    uint32_t nameCount;         ///< Variables it uses
+    uint32_t stackDepth;        ///< Deepest operand stack its program needs
+    uint32_t errorPosition;     ///< Offset of the syntax error, UINT32_MAX if none is known
+    uint8_t error;              ///< ErrorKind that compiling it raised, ErrorKind::None if it compiled
+    uint8_t reserved[3];        ///< Zero
+};
+
+//A variable name, as a range of the Strings section
+struct ImageName {
+    uint32_t offset;
+    uint32_t length;
+};
+
+//An instruction as stored; laid out like Instruction, with the padding spelled out
+struct ImageInstruction {
+    uint8_t code;
+    uint8_t reserved[3];  ///< Zero
+    uint32_t position;
+    int32_t value;
+};
+
+static_assert(std::is_trivially_copyable_v<Instruction> && sizeof(Instruction) == sizeof(ImageInstruction) &&
+                  offsetof(Instruction, position) == offsetof(ImageInstruction, position) &&
+                  offsetof(Instruction, value) == offsetof(ImageInstruction, value),
+              "Mapped instructions are read as Instruction");
+static_assert(sizeof(ImageHeader) % ImageAlignment == 0 && sizeof(ImageEntry) == 36 && sizeof(ImageName) == 8);
+
+//Tag telling the numeric policies apart: the size and kind of value_type
+//and the policy flags that change what a compiled program computes
+template <class Policy>
+constexpr uint32_t imagePolicyTag() {
+    using T = typename Policy::value_type;
+    return static_cast<uint32_t>(sizeof(T)) | static_cast<uint32_t>(std::is_floating_point_v<T>) << 8 |
+           static_cast<uint32_t>(Policy::canFail) << 9 | static_cast<uint32_t>(Policy::associative) << 10;
+}
+
+//64-bit checksum of a block of bytes
+uint64_t imageChecksum(std::string_view bytes);
+
+//Bytes of one section to be written
+struct ImageSectionData {
+    const void* data = nullptr;
+    size_t bytes = 0;
+    uint64_t count = 0;
+};
+
+//Write an image file: header, then the sections in order. The file is
+//written next to path and renamed over it, so a process mapping the old
+//image never sees a half written one (throws std::system_error).
+void writeImageFile(const std::string& path, uint32_t policy, uint32_t expressionCount,
+                    const ImageSectionData (&sections)[ImageSectionCount]);
+
+//Check the header, sections and entries of a mapped image, and with
+//verify also the checksum and every program; returns the header
+//(throws std::runtime_error naming path and the first problem)
+const ImageHeader& checkImage(std::string_view file, const std::string& path, uint32_t policy, size_t valueSize,
+                              bool verify);
+
+//class BasicImageExpression
+//One expression of a mapped image; a small view that stays valid as long
+//as the image it came from
+template <class Policy>
+class BasicImageExpression {
+public:
+    using value_type = typename Policy::value_type;
+
+private:
+    const ImageEntry* entry;
+    const Instruction* program;   ///< This expression's instructions
+    const value_type* constants;  ///< This expression's literals
+    const ImageName* names;       ///< This expression's variables
+    const char* strings;          ///< The image's Strings section
+
+public:
+    BasicImageExpression(const ImageEntry* imageEntry, const Instruction* instructions, const value_type* literals,
+                         const ImageName* variableNames, const char* nameStrings)
+        : entry(imageEntry), program(instructions), constants(literals), names(variableNames),
+          strings(nameStrings) {}
+
+    //Whether the expression compiled; run() raises the stored error otherwise
+    bool ok() const { return entry->error == static_cast<uint8_t>(ErrorKind::None); }
+
+    //The error compiling the expression raised, as an EvalError
+    EvalError error() const;
+
+    //Execute the program and return its result
+    value_type run() const { return run({}); }
+
+    //Execute the program with values for its variables (in variableName() order)
+    value_type run(std::span<const value_type> variables) const;
+
+    //Number of variables the expression uses
+    size_t variableCount() const { return entry->nameCount; }
+
+    //Name of the i-th variable, in order of first use
+    std::string_view variableName(size_t i) const { return {strings + names[i].offset, names[i].length}; }
+
+    //Index of a variable, or -1 when the expression doesn't use it
+    int variableIndex(std::string_view name) const;
+
+    //The program, its literals and the deepest operand stack it needs
+    std::span<const Instruction> instructions() const { return {program, entry->instructionCount}; }
+    std::span<const value_type> literals() const { return {constants, entry->constantCount}; }
+    size_t stackDepth() const { return entry->stackDepth; }
+};
+
+//class BasicExpressionImageWriter
+//Collects compiled expressions (and the errors of those that didn't
+//compile) and saves them as an image
+template <class Policy>
+class BasicExpressionImageWriter {
+public:
+    using value_type = typename Policy::value_type;
+    using Compiled = BasicCompiledExpression<Policy>;
+
+private:
+    BasicEvaluator<Policy> evaluator;
+    std::vector<ImageEntry> entries;
+    std::vector<ImageInstruction> instructions;
+    std::vector<value_type> constants;
+    std::vector<ImageName> names;
+    std::string strings;
+    size_t failed = 0;  ///< Expressions added with an error
+
+    //Entry for the next expression, with its sections starting at the current ends
+    ImageEntry nextEntry() const;
+
+public:
+    //Add a compiled expression
+    void add(const Compiled& compiled);
+
+    //Add an expression; one that doesn't compile is stored with its error
+    void add(std::string_view expr);
+
+    //Add an expression that failed to compile
+    void addError(ErrorKind kind, size_t position = EvalError::npos);
+
+    //Number of expressions added
+    size_t size() const { return entries.size(); }
+
+    //Number of those that failed to compile
+    size_t errors() const { return failed; }
+
+    //Write the image to path (throws std::system_error)
+    void save(const std::string& path) const;
+};
+
+//class BasicExpressionImage
+//A mapped image of compiled expressions for one numeric policy. Loading
+//validates it and maps it; expressions then run straight from the mapping.
+template <class Policy>
+class BasicExpressionImage {
+public:
+    using value_type = typename Policy::value_type;
+    using Expression = BasicImageExpression<Policy>;
+
+private:
+    MappedFile file;
+    const ImageEntry* entries = nullptr;
+    const Instruction* instructions = nullptr;
+    const value_type* constants = nullptr;
+    const ImageName* names = nullptr;
+    const char* strings = nullptr;
+    size_t count = 0;
+
+public:
+    //Map and check an image. verify also checks the checksum and every
+    //program, which reads the whole file; without it only the header and
+    //directory are read. Throws std::system_error if the file can't be
+    //mapped and std::runtime_error if it isn't a valid image for Policy.
+    explicit BasicExpressionImage(const std::string& path, bool verify = true);
+
+    //Number of expressions
+    size_t size() const { return count; }
+
+    //Size of the image file in bytes
+    size_t bytes() const { return file.text().size(); }
+
+    //The i-th expression, in the order they were added
+    Expression operator[](size_t i) const {
+        const ImageEntry& entry = entries[i];
+        return Expression(&entry, instructions + entry.firstInstruction, constants + entry.firstConstant,
+                          names + entry.firstName, strings);
+    }
+};
+
+//Images of the default (32-bit int) evaluator
+using ImageExpression = BasicImageExpression<Int32Policy>;
+using ExpressionImageWriter = BasicExpressionImageWriter<Int32Policy>;
+using ExpressionImage = BasicExpressionImage<Int32Policy>;
+
+//The error compiling the expression raised
+
+template <class Policy>
+EvalError BasicImageExpression<Policy>::error() const {
+    size_t position = entry->errorPosition == UINT32_MAX ? EvalError::npos : entry->errorPosition;
+    return EvalError(static_cast<ErrorKind>(entry->error), position);
+}
+
+//Execute the program with values for its variables
+
+template <class Policy>
+typename Policy::value_type BasicImageExpression<Policy>::run(std::span<const value_type> variables) const {
+    if (!ok()) throw error();
+    return runProgram<Policy>(instructions(), constants, variables, entry->stackDepth);
+}
+
+//Index of a variable, or -1
+
+template <class Policy>
+int BasicImageExpression<Policy>::variableIndex(std::string_view name) const {
+    for (size_t i = 0; i < entry->nameCount; i++) {
+        if (variableName(i) == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+//Entry for the next expression
+
+template <class Policy>
+ImageEntry BasicExpressionImageWriter<Policy>::nextEntry() const {
+    ImageEntry entry{};
+    entry.firstInstruction = static_cast<uint32_t>(instructions.size());
+    entry.firstConstant = static_cast<uint32_t>(constants.size());
+    entry.firstName = static_cast<uint32_t>(names.size());
+    entry.errorPosition = UINT32_MAX;
+    return entry;
+}
+
+//Add a compiled expression
+
+template <class Policy>
+void BasicExpressionImageWriter<Policy>::add(const Compiled& compiled) {
+    ImageEntry entry = nextEntry();
+    entry.instructionCount = static_cast<uint32_t>(compiled.instructions().size());
+    entry.constantCount = static_cast<uint32_t>(compiled.literals().size());
+    entry.nameCount = static_cast<uint32_t>(compiled.variables().size());
+    entry.stackDepth = static_cast<uint32_t>(compiled.stackDepth());
+
+    for (const Instruction& ins : compiled.instructions()) {
+        ImageInstruction stored{};
+        stored.code = static_cast<uint8_t>(ins.code);
+        stored.position = ins.position;
+        stored.value = ins.value;
+        instructions.push_back(stored);
+    }
+    constants.insert(constants.end(), compiled.literals().begin(), compiled.literals().end());
+    for (const std::string& name : compiled.variables()) {
+        names.push_back({static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(name.size())});
+        strings += name;
+    }
+    entries.push_back(entry);
+}
+
+//Add an expression, or its error
+
+template <class Policy>
+void BasicExpressionImageWriter<Policy>::add(std::string_view expr) {
+    try {
+        add(evaluator.compile(expr));
+    } catch (const EvalError& e) {
+        addError(e.kind(), e.position());
+    }
+}
+
+//Add an expression that failed to compile
+
+template <class Policy>
+void BasicExpressionImageWriter<Policy>::addError(ErrorKind kind, size_t position) {
+    failed++;
+    ImageEntry entry = nextEntry();
+    entry.error = static_cast<uint8_t>(kind);
+    if (position < UINT32_MAX) entry.errorPosition = static_cast<uint32_t>(position);
+    entries.push_back(entry);
+}
+
+//Write the image to path
+
+template <class Policy>
+void BasicExpressionImageWriter<Policy>::save(const std::string& path) const {
+    ImageSectionData sections[ImageSectionCount];
+    sections[static_cast<size_t>(ImageSection::Entries)] = {entries.data(), entries.size() * sizeof(ImageEntry),
+                                                            entries.size()};
+    sections[static_cast<size_t>(ImageSection::Instructions)] = {
+        instructions.data(), instructions.size() * sizeof(ImageInstruction), instructions.size()};
+    sections[static_cast<size_t>(ImageSection::Constants)] = {constants.data(),
+                                                              constants.size() * sizeof(value_type), constants.size()};
+    sections[static_cast<size_t>(ImageSection::Names)] = {names.data(), names.size() * sizeof(ImageName),
+                                                          names.size()};
+    sections[static_cast<size_t>(ImageSection::Strings)] = {strings.data(), strings.size(), strings.size()};
+    writeImageFile(path, imagePolicyTag<Policy>(), static_cast<uint32_t>(entries.size()), sections);
+}
+
+//Map and check an image
+
+template <class Policy>
+BasicExpressionImage<Policy>::BasicExpressionImage(const std::string& path, bool verify)
+    : file(path, MapAccess::Random) {
+    std::string_view bytes = file.text();
+    const ImageHeader& header = checkImage(bytes, path, imagePolicyTag<Policy>(), sizeof(value_type), verify);
+    auto section = [&](ImageSection which) {
+        return bytes.data() + header.sectionOffset[static_cast<size_t>(which)];
+    };
+    entries = reinterpret_cast<const ImageEntry*>(section(ImageSection::Entries));
+    instructions = reinterpret_cast<const Instruction*>(section(ImageSection::Instructions));
+    constants = reinterpret_cast<const value_type*>(section(ImageSection::Constants));
+    names = reinterpret_cast<const ImageName*>(section(ImageSection::Names));
+    strings = section(ImageSection::Strings);
+    count = header.expressionCount;
+}
+
+// The standard policies are instantiated once, in ExpressionImage.cpp
+#define EVALUATOR_EXTERN_IMAGE(P)                     \
+    extern template class BasicImageExpression<P>;    \
+    extern template class BasicExpressionImageWriter<P>; \
+    extern template class BasicExpressionImage<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_IMAGE)
+#undef EVALUATOR_EXTERN_IMAGE
+
+#endif // EXPRESSION_IMAGE_H
\ No newline at end of file
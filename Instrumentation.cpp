@@ -0,0 +1,343 @@
+#include "Instrumentation.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+constexpr size_t PhaseCount = static_cast<size_t>(Phase::Count);
+constexpr size_t OperatorCount = static_cast<size_t>(Op::Count);
+constexpr size_t ErrorCount = static_cast<size_t>(ErrorKind::Count);
+
+//Names of the error kinds in JSON and Prometheus output
+const char* errorName(ErrorKind kind) {
+    switch (kind) {
+    case ErrorKind::None:                   return "none";
+    case ErrorKind::EmptyExpression:        return "empty_expression";
+    case ErrorKind::LeadingCloseParen:      return "leading_close_paren";
+    case ErrorKind::LeadingBinaryOperator:  return "leading_binary_operator";
+    case ErrorKind::MismatchedParentheses:  return "mismatched_parentheses";
+    case ErrorKind::TwoOperands:            return "two_operands";
+    case ErrorKind::TwoBinaryOperators:     return "two_binary_operators";
+    case ErrorKind::InvalidCharacter:       return "invalid_character";
+    case ErrorKind::MissingOperand:         return "missing_operand";
+    case ErrorKind::ExpectedBinaryOperator: return "expected_binary_operator";
+    case ErrorKind::DivisionByZero:         return "division_by_zero";
+    case ErrorKind::UnknownVariable:        return "unknown_variable";
+    case ErrorKind::Overflow:               return "overflow";
+    case ErrorKind::NumberOutOfRange:       return "number_out_of_range";
+    case ErrorKind::CircularReference:      return "circular_reference";
+    case ErrorKind::LimitExceeded:          return "limit_exceeded";
+    default:                                return "unknown";
+    }
+}
+
+//Add to a counter only its own thread writes; a plain load and store is
+//enough and avoids a locked read-modify-write on every event
+void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void raise(std::atomic<uint64_t>& maximum, uint64_t value) {
+    if (value > maximum.load(std::memory_order_relaxed)) maximum.store(value, std::memory_order_relaxed);
+}
+
+void append(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+//printf into a string
+void append(std::string& out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    out.append(line, static_cast<size_t>(std::min<int>(length, sizeof(line) - 1)));
+}
+
+} // namespace
+
+//Counters of one thread
+struct Instrumentation::ThreadBlock {
+    struct PhaseCounters {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> totalNanoseconds{0};
+        std::atomic<uint64_t> maxNanoseconds{0};
+        std::array<std::atomic<uint64_t>, LatencyHistogram::BucketCount> latency{};
+    };
+
+    std::atomic<uint64_t> epoch{0};  ///< Reset generation the counters belong to
+    std::array<PhaseCounters, PhaseCount> phases;
+    std::array<std::atomic<uint64_t>, OperatorCount> operators{};
+    std::array<std::atomic<uint64_t>, ErrorCount> errors{};
+    std::atomic<uint64_t> maxStackDepth{0};
+
+    //Zero every counter (by the owning thread)
+    void clear() {
+        for (PhaseCounters& phase : phases) {
+            phase.count.store(0, std::memory_order_relaxed);
+            phase.totalNanoseconds.store(0, std::memory_order_relaxed);
+            phase.maxNanoseconds.store(0, std::memory_order_relaxed);
+            for (auto& bucket : phase.latency) bucket.store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : operators) counter.store(0, std::memory_order_relaxed);
+        for (auto& counter : errors) counter.store(0, std::memory_order_relaxed);
+        maxStackDepth.store(0, std::memory_order_relaxed);
+    }
+
+    //Add the counters to a snapshot
+    void addTo(InstrumentationSnapshot& snapshot) const {
+        for (size_t p = 0; p < PhaseCount; p++) {
+            const PhaseCounters& from = phases[p];
+            InstrumentationSnapshot::PhaseStats& to = snapshot.phases[p];
+            to.count += from.count.load(std::memory_order_relaxed);
+            to.totalNanoseconds += from.totalNanoseconds.load(std::memory_order_relaxed);
+            to.maxNanoseconds = std::max(to.maxNanoseconds, from.maxNanoseconds.load(std::memory_order_relaxed));
+            for (size_t b = 0; b < LatencyHistogram::BucketCount; b++) {
+                to.latency.counts[b] += from.latency[b].load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < OperatorCount; i++) snapshot.operators[i] += operators[i].load(std::memory_order_relaxed);
+        for (size_t i = 0; i < ErrorCount; i++) snapshot.errors[i] += errors[i].load(std::memory_order_relaxed);
+        snapshot.maxStackDepth = std::max(snapshot.maxStackDepth, maxStackDepth.load(std::memory_order_relaxed));
+    }
+};
+
+namespace {
+
+//The blocks of live threads, and what exited threads left behind
+struct Registry {
+    std::mutex lock;
+    std::vector<Instrumentation::ThreadBlock*> live;
+    InstrumentationSnapshot retired;
+    std::atomic<uint64_t> epoch{0};  ///< Bumped by reset(); blocks of older epochs count as zero
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry;  // Outlives the thread_local blocks of exiting threads
+    return *instance;
+}
+
+//Owns a thread's block and hands its counts to the registry when the thread exits
+struct Registration {
+    std::unique_ptr<Instrumentation::ThreadBlock> block = std::make_unique<Instrumentation::ThreadBlock>();
+
+    Registration() {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> guard(shared.lock);
+        block->epoch.store(shared.epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        shared.live.push_back(block.get());
+    }
+
+    ~Registration() {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> guard(shared.lock);
+        if (block->epoch.load(std::memory_order_relaxed) == shared.epoch.load(std::memory_order_relaxed)) {
+            block->addTo(shared.retired);
+        }
+        shared.live.erase(std::find(shared.live.begin(), shared.live.end(), block.get()));
+    }
+};
+
+} // namespace
+
+//The calling thread's block
+
+Instrumentation::ThreadBlock& Instrumentation::local() {
+    thread_local Registration registration;
+    ThreadBlock& block = *registration.block;
+
+    // After a reset() the owner zeroes its own block before counting again
+    uint64_t epoch = registry().epoch.load(std::memory_order_acquire);
+    if (block.epoch.load(std::memory_order_relaxed) != epoch) {
+        block.clear();
+        block.epoch.store(epoch, std::memory_order_release);
+    }
+    return block;
+}
+
+void Instrumentation::recordPhase(Phase phase, uint64_t nanoseconds) {
+    ThreadBlock::PhaseCounters& counters = local().phases[static_cast<size_t>(phase)];
+    bump(counters.count);
+    bump(counters.totalNanoseconds, nanoseconds);
+    raise(counters.maxNanoseconds, nanoseconds);
+    bump(counters.latency[LatencyHistogram::bucketOf(nanoseconds)]);
+}
+
+void Instrumentation::recordOperator(Op op, uint64_t times) {
+    bump(local().operators[static_cast<size_t>(op)], times);
+}
+
+void Instrumentation::recordError(ErrorKind kind) {
+    bump(local().errors[static_cast<size_t>(kind)]);
+}
+
+void Instrumentation::recordStackDepth(size_t depth) {
+    raise(local().maxStackDepth, depth);
+}
+
+//Sum of all counters so far
+
+InstrumentationSnapshot Instrumentation::snapshot() {
+    InstrumentationSnapshot result;
+    if constexpr (!Enabled) return result;
+
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+    uint64_t epoch = shared.epoch.load(std::memory_order_relaxed);
+    result = shared.retired;
+    for (const ThreadBlock* block : shared.live) {
+        // A block still holding counts from before the last reset() counts as zero
+        if (block->epoch.load(std::memory_order_acquire) == epoch) block->addTo(result);
+    }
+    return result;
+}
+
+//Start counting from zero again
+
+void Instrumentation::reset() {
+    if constexpr (!Enabled) return;
+
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+    shared.retired = InstrumentationSnapshot();
+    shared.epoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
+//Total number of recorded values
+
+uint64_t LatencyHistogram::total() const {
+    uint64_t sum = 0;
+    for (uint64_t count : counts) sum += count;
+    return sum;
+}
+
+//Value below which a fraction of the recorded values lie
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t count = total();
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(std::clamp(fraction, 0.0, 1.0) * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < BucketCount; b++) {
+        seen += counts[b];
+        // Report the middle of the bucket the rank falls into
+        if (seen >= rank) return (lowerBound(b) + (b + 1 < BucketCount ? lowerBound(b + 1) : lowerBound(b))) / 2;
+    }
+    return lowerBound(BucketCount - 1);
+}
+
+//Name of a phase
+
+const char* phaseName(Phase phase) {
+    switch (phase) {
+    case Phase::Evaluate:    return "evaluate";
+    case Phase::Parse:       return "parse";
+    case Phase::Optimize:    return "optimize";
+    case Phase::Emit:        return "emit";
+    case Phase::Run:         return "run";
+    case Phase::RunBatch:    return "run_batch";
+    case Phase::CacheLookup: return "cache_lookup";
+    default:                 return "unknown";
+    }
+}
+
+//Name of an operator
+
+const char* operatorName(Op op) {
+    static constexpr const char* names[] = {
+        "add", "subtract", "multiply", "divide", "modulo", "power",
+        "greater", "greater_equal", "less", "less_equal", "equal", "not_equal",
+        "and", "or",
+        "not", "increment", "decrement", "plus", "negate",
+        "left_paren",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == OperatorCount, "Every Op needs a name");
+    return op < Op::Count ? names[static_cast<size_t>(op)] : "unknown";
+}
+
+//The snapshot as one JSON object
+
+std::string InstrumentationSnapshot::json() const {
+    std::string out = "{\"phases\":{";
+    for (size_t p = 0; p < PhaseCount; p++) {
+        const PhaseStats& phase = phases[p];
+        append(out, "%s\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"max_ns\":%llu,\"mean_ns\":%.1f,"
+                    "\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu}",
+               p ? "," : "", phaseName(static_cast<Phase>(p)), (unsigned long long)phase.count,
+               (unsigned long long)phase.totalNanoseconds, (unsigned long long)phase.maxNanoseconds,
+               phase.count ? double(phase.totalNanoseconds) / phase.count : 0.0,
+               (unsigned long long)phase.latency.percentile(0.5), (unsigned long long)phase.latency.percentile(0.9),
+               (unsigned long long)phase.latency.percentile(0.99),
+               (unsigned long long)phase.latency.percentile(0.999));
+    }
+    out += "},\"operators\":{";
+    for (size_t i = 0; i < OperatorCount; i++) {
+        append(out, "%s\"%s\":%llu", i ? "," : "", operatorName(static_cast<Op>(i)), (unsigned long long)operators[i]);
+    }
+    out += "},\"errors\":{";
+    for (size_t i = 1; i < ErrorCount; i++) {
+        append(out, "%s\"%s\":%llu", i > 1 ? "," : "", errorName(static_cast<ErrorKind>(i)), (unsigned long long)errors[i]);
+    }
+    append(out, "},\"max_stack_depth\":%llu}", (unsigned long long)maxStackDepth);
+    return out;
+}
+
+/**
+ * The snapshot in the Prometheus text exposition format
+ * Phase latencies become one histogram with a bucket per power of two
+ * nanoseconds (the boundaries of LatencyHistogram, so the counts are exact).
+ */
+std::string InstrumentationSnapshot::prometheus(const std::string& prefix) const {
+    const char* name = prefix.c_str();
+    std::string out;
+
+    append(out, "# HELP %s_phase_seconds Time spent in each evaluator phase\n", name);
+    append(out, "# TYPE %s_phase_seconds histogram\n", name);
+    for (size_t p = 0; p < PhaseCount; p++) {
+        const PhaseStats& phase = phases[p];
+        const char* label = phaseName(static_cast<Phase>(p));
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (unsigned exponent = 0; exponent <= LatencyHistogram::MaxExponent; exponent++) {
+            uint64_t bound = uint64_t(1) << exponent;
+            while (bucket < LatencyHistogram::BucketCount && LatencyHistogram::lowerBound(bucket) < bound) {
+                cumulative += phase.latency.counts[bucket++];
+            }
+            append(out, "%s_phase_seconds_bucket{phase=\"%s\",le=\"%.9g\"} %llu\n", name, label, bound * 1e-9,
+                   (unsigned long long)cumulative);
+        }
+        append(out, "%s_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n", name, label,
+               (unsigned long long)phase.count);
+        append(out, "%s_phase_seconds_sum{phase=\"%s\"} %.9f\n", name, label, phase.totalNanoseconds * 1e-9);
+        append(out, "%s_phase_seconds_count{phase=\"%s\"} %llu\n", name, label, (unsigned long long)phase.count);
+    }
+
+    append(out, "# HELP %s_phase_max_seconds Longest single run of each evaluator phase\n", name);
+    append(out, "# TYPE %s_phase_max_seconds gauge\n", name);
+    for (size_t p = 0; p < PhaseCount; p++) {
+        append(out, "%s_phase_max_seconds{phase=\"%s\"} %.9f\n", name, phaseName(static_cast<Phase>(p)),
+               phases[p].maxNanoseconds * 1e-9);
+    }
+
+    append(out, "# HELP %s_operators_total Operators applied\n", name);
+    append(out, "# TYPE %s_operators_total counter\n", name);
+    for (size_t i = 0; i < OperatorCount; i++) {
+        append(out, "%s_operators_total{op=\"%s\"} %llu\n", name, operatorName(static_cast<Op>(i)),
+               (unsigned long long)operators[i]);
+    }
+
+    append(out, "# HELP %s_errors_total Errors raised\n", name);
+    append(out, "# TYPE %s_errors_total counter\n", name);
+    for (size_t i = 1; i < ErrorCount; i++) {
+        append(out, "%s_errors_total{kind=\"%s\"} %llu\n", name, errorName(static_cast<ErrorKind>(i)),
+               (unsigned long long)errors[i]);
+    }
+
+    append(out, "# HELP %s_max_stack_depth Deepest operand stack seen\n", name);
+    append(out, "# TYPE %s_max_stack_depth gauge\n", name);
+    append(out, "%s_max_stack_depth %llu\n", name, (unsigned long long)maxStackDepth);
+    return out;
+}
\ No newline at end of file
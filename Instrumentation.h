@@ -0,0 +1,171 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include "EvalError.h"
+#include "Lexer.h"
+
+//Opt-in instrumentation of the evaluator. Build with
+//  -DEVALUATOR_INSTRUMENTATION=1
+//to record it; otherwise every hook below is an empty inline function and
+//compiles away, and snapshot() reports zeros.
+#ifndef EVALUATOR_INSTRUMENTATION
+#define EVALUATOR_INSTRUMENTATION 0
+#endif
+
+//Timed phases of the evaluator
+enum class Phase : uint8_t {
+    Evaluate,     ///< A whole BasicEvaluator::eval() call
+    Parse,        ///< Lexing, validating and translating into a tree (compile)
+    Optimize,     ///< Simplifying the tree (compile)
+    Emit,         ///< Lowering the tree into a program (compile)
+    Run,          ///< Executing a compiled program once
+    RunBatch,     ///< Executing a compiled program over columns
+    CacheLookup,  ///< Finding (or compiling) an expression in the cache
+    Count
+};
+
+//class LatencyHistogram
+//Log-linear histogram of durations in nanoseconds, in the manner of
+//HdrHistogram: every power of two is split into SubBuckets linear buckets,
+//so a recorded value is off by at most 1/SubBuckets (about 6%) anywhere in
+//the range from 1 ns up to 2^MaxExponent ns (about 18 minutes).
+class LatencyHistogram {
+public:
+    static constexpr unsigned SubBucketBits = 4;
+    static constexpr unsigned SubBuckets = 1u << SubBucketBits;
+    static constexpr unsigned MaxExponent = 40;
+    static constexpr size_t BucketCount = (MaxExponent - SubBucketBits + 1) * SubBuckets;
+
+    std::array<uint64_t, BucketCount> counts{};
+
+    //Bucket of a value; values below SubBuckets get a bucket each
+    static constexpr size_t bucketOf(uint64_t value) {
+        if (value < SubBuckets) return static_cast<size_t>(value);
+        unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        if (exponent >= MaxExponent) return BucketCount - 1;
+        unsigned shift = exponent - SubBucketBits;
+        return (shift + 1) * SubBuckets + static_cast<size_t>((value >> shift) - SubBuckets);
+    }
+
+    //Smallest value that falls into a bucket
+    static constexpr uint64_t lowerBound(size_t bucket) {
+        if (bucket < SubBuckets) return bucket;
+        unsigned shift = static_cast<unsigned>(bucket / SubBuckets) - 1;
+        return (SubBuckets + bucket % SubBuckets) << shift;
+    }
+
+    //Total number of recorded values
+    uint64_t total() const;
+
+    //Value below which the given fraction (0..1) of the recorded values lie
+    uint64_t percentile(double fraction) const;
+};
+
+//Everything recorded, summed over all threads
+struct InstrumentationSnapshot {
+    struct PhaseStats {
+        uint64_t count = 0;             ///< Times the phase ran
+        uint64_t totalNanoseconds = 0;  ///< Time spent in it
+        uint64_t maxNanoseconds = 0;    ///< Longest single run
+        LatencyHistogram latency;       ///< Distribution of single runs
+    };
+
+    std::array<PhaseStats, static_cast<size_t>(Phase::Count)> phases;
+    std::array<uint64_t, static_cast<size_t>(Op::Count)> operators{};       ///< Operators applied, by Op
+    std::array<uint64_t, static_cast<size_t>(ErrorKind::Count)> errors{};  ///< Errors raised, by ErrorKind
+    uint64_t maxStackDepth = 0;  ///< Deepest operand stack seen
+
+    //The snapshot as one JSON object
+    std::string json() const;
+
+    //The snapshot in the Prometheus text exposition format, metric names
+    //starting with prefix
+    std::string prometheus(const std::string& prefix = "evaluator") const;
+};
+
+//class Instrumentation
+//Collects the counters. Every thread records into its own block, which
+//only that thread writes (relaxed atomic stores, no read-modify-write), so
+//recording never locks or contends. snapshot() sums the blocks of live
+//threads and of threads that have exited.
+class Instrumentation {
+public:
+    static constexpr bool Enabled = EVALUATOR_INSTRUMENTATION != 0;
+
+    //Counters of one thread
+    struct ThreadBlock;
+
+private:
+    //The calling thread's block, registered on first use
+    static ThreadBlock& local();
+
+    static void recordPhase(Phase phase, uint64_t nanoseconds);
+    static void recordOperator(Op op, uint64_t times);
+    static void recordError(ErrorKind kind);
+    static void recordStackDepth(size_t depth);
+
+public:
+    //Sum of all counters so far (all zero when not Enabled)
+    static InstrumentationSnapshot snapshot();
+
+    //Start counting from zero again
+    static void reset();
+
+    //Count an operator applied times times (ignored during constant evaluation)
+    static constexpr void countOperator(Op op, uint64_t times = 1) {
+        if constexpr (Enabled) {
+            if (!std::is_constant_evaluated()) recordOperator(op, times);
+        }
+    }
+
+    //Count a raised error
+    static void countError(ErrorKind kind) {
+        if constexpr (Enabled) recordError(kind);
+    }
+
+    //Note the depth of an operand stack (ignored during constant evaluation)
+    static constexpr void noteStackDepth(size_t depth) {
+        if constexpr (Enabled) {
+            if (!std::is_constant_evaluated()) recordStackDepth(depth);
+        }
+    }
+
+    //class PhaseTimer
+    //Times the enclosing scope as one run of a phase
+    class PhaseTimer {
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;  ///< Only read the clock when enabled
+
+    public:
+        explicit PhaseTimer(Phase timed) : phase(timed) {
+            if constexpr (Enabled) start = std::chrono::steady_clock::now();
+        }
+
+        ~PhaseTimer() {
+            if constexpr (Enabled) {
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                recordPhase(phase, static_cast<uint64_t>(
+                                       std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            }
+        }
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+    };
+};
+
+//Name of a phase as used in JSON and Prometheus output
+const char* phaseName(Phase phase);
+
+//Name of an operator as used in JSON and Prometheus output ("add", "negate", ...)
+const char* operatorName(Op op);
+
+#endif // INSTRUMENTATION_H
\ No newline at end of file
@@ -0,0 +1,192 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include "CharClass.h"
+
+//Operators understood by the evaluator.
+//Plus and Negate are the prefix forms of + and -; the lexer always reports
+//the binary spelling and the parser picks the form from context.
+enum class Op : uint8_t {
+    Add, Subtract, Multiply, Divide, Modulo, Power,
+    Greater, GreaterEqual, Less, LessEqual, Equal, NotEqual,
+    And, Or,
+    Not, Increment, Decrement, Plus, Negate,
+    LeftParen,  ///< Only ever lives on the parser's operator stack
+    Count
+};
+
+//Static description of an operator
+struct OpInfo {
+    const char* symbol;   ///< Source spelling
+    uint8_t precedence;   ///< Binding strength, higher binds tighter (0 = grouping)
+    uint8_t arity;        ///< Number of operands consumed
+    Op prefix;            ///< Form used where an operand is expected (Count = none)
+    Op infix;             ///< Form used after an operand (Count = none)
+};
+
+//Operator table indexed by Op
+inline constexpr OpInfo opTable[] = {
+    {"+",  5, 2, Op::Plus,      Op::Add},
+    {"-",  5, 2, Op::Negate,    Op::Subtract},
+    {"*",  6, 2, Op::Count,     Op::Multiply},
+    {"/",  6, 2, Op::Count,     Op::Divide},
+    {"%",  6, 2, Op::Count,     Op::Modulo},
+    {"^",  7, 2, Op::Count,     Op::Power},
+    {">",  4, 2, Op::Count,     Op::Greater},
+    {">=", 4, 2, Op::Count,     Op::GreaterEqual},
+    {"<",  4, 2, Op::Count,     Op::Less},
+    {"<=", 4, 2, Op::Count,     Op::LessEqual},
+    {"==", 3, 2, Op::Count,     Op::Equal},
+    {"!=", 3, 2, Op::Count,     Op::NotEqual},
+    {"&&", 2, 2, Op::Count,     Op::And},
+    {"||", 1, 2, Op::Count,     Op::Or},
+    {"!",  8, 1, Op::Not,       Op::Count},
+    {"++", 8, 1, Op::Increment, Op::Add},       // 1++2 reads as 1 + (+2)
+    {"--", 8, 1, Op::Decrement, Op::Subtract},  // 1--2 reads as 1 - (-2)
+    {"+",  8, 1, Op::Plus,      Op::Count},
+    {"-",  8, 1, Op::Negate,    Op::Count},
+    {"(",  0, 0, Op::Count,     Op::Count},
+};
+static_assert(sizeof(opTable) / sizeof(opTable[0]) == static_cast<size_t>(Op::Count),
+              "opTable must describe every Op");
+
+//Look up the description of an operator
+constexpr const OpInfo& opInfo(Op op) {
+    return opTable[static_cast<size_t>(op)];
+}
+
+//Kinds of tokens produced by the lexer
+enum class TokenKind : uint8_t {
+    Number, Identifier, Operator, LeftParen, RightParen, Invalid, End
+};
+
+//A single lexed token; the text is never copied, only its offset kept
+struct Token {
+    TokenKind kind;
+    Op op;             ///< Operator for TokenKind::Operator
+    size_t offset;     ///< Offset of the first character in the source
+    size_t length;     ///< Length of the token in characters (the digits of a TokenKind::Number)
+};
+
+//class Lexer
+//Splits an expression held in a string_view into tokens, one at a time.
+//Everything is constexpr so expressions can also be parsed during compilation;
+//at run time runs of whitespace, digits and name characters are scanned a
+//vector at a time (see CharClass.h).
+class Lexer {
+private:
+    std::string_view text;  ///< The expression being tokenized
+    size_t pos = 0;         ///< Current position in the expression
+
+    //Skip whitespace characters in the expression
+    constexpr void skipWhitespace() {
+        // Most tokens aren't preceded by whitespace at all
+        if (pos >= text.length() || !isSpaceChar(text[pos])) return;
+        if (!std::is_constant_evaluated()) {
+            pos = skipSpaces(text, pos);
+            return;
+        }
+        while (pos < text.length() && isSpaceChar(text[pos])) {
+            pos++;  // Move past each whitespace character
+        }
+    }
+
+    //Skip over a multi-digit number at the current position; its value is
+    //left to the numeric policy of whoever consumes the token
+    constexpr void skipNumber() {
+        if (!std::is_constant_evaluated()) {
+            pos = skipDigits(text, pos);
+            return;
+        }
+        while (pos < text.length() && isDigitChar(text[pos])) {
+            pos++;
+        }
+    }
+
+    //Skip over a variable name at the current position
+    constexpr void skipIdentifier() {
+        if (!std::is_constant_evaluated()) {
+            pos = skipNameChars(text, pos);
+            return;
+        }
+        while (pos < text.length() && isNameChar(text[pos])) {
+            pos++;
+        }
+    }
+
+public:
+    constexpr explicit Lexer(std::string_view source) : text(source) {}
+
+    //Produce the next token (TokenKind::End once the input is exhausted)
+    constexpr Token next();
+
+    //Offset of the next unread character
+    constexpr size_t position() const { return pos; }
+};
+
+//Produce the next token
+
+constexpr Token Lexer::next() {
+    skipWhitespace();
+
+    Token token{TokenKind::End, Op::Count, pos, 0};
+    if (pos >= text.length()) return token;
+
+    char c = text[pos];
+    char n = (pos + 1 < text.length()) ? text[pos + 1] : '\0';
+
+    if (isDigitChar(c)) {
+        token.kind = TokenKind::Number;
+        skipNumber();
+        token.length = pos - token.offset;
+        return token;
+    }
+
+    // Variable names: a letter or underscore followed by letters, digits and underscores
+    if (isAlphaChar(c) || c == '_') {
+        token.kind = TokenKind::Identifier;
+        skipIdentifier();
+        token.length = pos - token.offset;
+        return token;
+    }
+
+    token.kind = TokenKind::Operator;
+    token.length = 1;
+
+    // Two-character operators are checked before their one-character prefixes
+    switch (c) {
+    case '(': token.kind = TokenKind::LeftParen;  break;
+    case ')': token.kind = TokenKind::RightParen; break;
+    case '*': token.op = Op::Multiply; break;
+    case '/': token.op = Op::Divide;   break;
+    case '%': token.op = Op::Modulo;   break;
+    case '^': token.op = Op::Power;    break;
+    case '+': token.op = (n == '+') ? Op::Increment    : Op::Add;      break;
+    case '-': token.op = (n == '-') ? Op::Decrement    : Op::Subtract; break;
+    case '>': token.op = (n == '=') ? Op::GreaterEqual : Op::Greater;  break;
+    case '<': token.op = (n == '=') ? Op::LessEqual    : Op::Less;     break;
+    case '!': token.op = (n == '=') ? Op::NotEqual     : Op::Not;      break;
+    case '=': token.op = (n == '=') ? Op::Equal        : Op::Count;    break;
+    case '&': token.op = (n == '&') ? Op::And          : Op::Count;    break;
+    case '|': token.op = (n == '|') ? Op::Or           : Op::Count;    break;
+    default:  token.op = Op::Count; break;
+    }
+
+    if (token.kind == TokenKind::Operator) {
+        if (token.op == Op::Count) {
+            token.kind = TokenKind::Invalid;  // Lone '=', '&', '|' or a foreign character
+            pos++;
+            return token;
+        }
+        token.length = (opInfo(token.op).symbol[1] == '\0') ? 1 : 2;
+    }
+
+    pos += token.length;
+    return token;
+}
+
+#endif // LEXER_H
\ No newline at end of file
@@ -0,0 +1,401 @@
+#include "NativeExpression.h"
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define NATIVE_EXPRESSION_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define NATIVE_EXPRESSION_X86_64 0
+#endif
+
+static_assert(offsetof(NativeFault, kind) == 0 && offsetof(NativeFault, position) == 4,
+              "Generated code stores into NativeFault at fixed offsets");
+
+#if NATIVE_EXPRESSION_X86_64
+
+namespace {
+
+//Condition codes of the Jcc / SETcc encodings
+enum Condition : uint8_t {
+    Equal = 0x4, NotEqual = 0x5, Sign = 0x8,
+    Less = 0xC, GreaterEqual = 0xD, LessEqual = 0xE, Greater = 0xF
+};
+
+//class CodeBuffer
+//Machine code under construction, with forward jumps patched once their
+//target is known
+class CodeBuffer {
+public:
+    std::vector<uint8_t> bytes;
+
+    void emit(std::initializer_list<uint8_t> code) { bytes.insert(bytes.end(), code); }
+
+    void imm32(uint32_t value) {
+        for (int i = 0; i < 4; i++) bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void imm64(uint64_t value) {
+        for (int i = 0; i < 8; i++) bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    size_t here() const { return bytes.size(); }
+
+    //Conditional jump with a 32-bit displacement; returns the spot to patch
+    size_t jumpIf(Condition condition) {
+        emit({0x0F, static_cast<uint8_t>(0x80 | condition)});
+        imm32(0);
+        return here() - 4;
+    }
+
+    //Unconditional jump with a 32-bit displacement; returns the spot to patch
+    size_t jump() {
+        emit({0xE9});
+        imm32(0);
+        return here() - 4;
+    }
+
+    //Point the displacement at patch to target
+    void patch(size_t at, size_t target) {
+        uint32_t displacement = static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+        std::memcpy(bytes.data() + at, &displacement, 4);
+    }
+
+    //Point the displacement at patch to the current position
+    void bind(size_t at) { patch(at, here()); }
+
+    // rax = [rsp + 8 * slot] / [rsp + 8 * slot] = rax
+    void loadSlot(size_t slot)  { emit({0x48, 0x8B, 0x84, 0x24}); imm32(static_cast<uint32_t>(slot * 8)); }
+    void storeSlot(size_t slot) { emit({0x48, 0x89, 0x84, 0x24}); imm32(static_cast<uint32_t>(slot * 8)); }
+
+    // rax = 0 / 1 from the flags of the last comparison
+    void setFlag(Condition condition) {
+        emit({0x0F, static_cast<uint8_t>(0x90 | condition), 0xC0});  // setcc al
+        emit({0x0F, 0xB6, 0xC0});                                     // movzx eax, al
+    }
+};
+
+//An error raised by generated code, emitted out of line after the epilogue
+struct ErrorStub {
+    size_t patch;        ///< Jump that leads to the stub
+    ErrorKind kind;
+    uint32_t position;
+};
+
+//A jump to a program instruction, patched once every instruction is emitted
+struct ProgramJump {
+    size_t patch;
+    size_t target;       ///< Instruction index
+};
+
+} // namespace
+
+/**
+ * Translate a program into x86-64 code
+ * The operand stack depth before every instruction is known statically (a
+ * short-circuit jump leaves the same depth at its target as the fall
+ * through path), so the stack maps onto fixed frame slots: the top value
+ * is kept in rax and the values below it in [rsp + 8 * depth]. The other
+ * registers: rdi = variables, rsi = fault, rcx / rdx scratch.
+ * Division by zero jumps to a stub that fills in the fault and returns 0.
+ */
+static bool generate(const NativeExpression::Compiled& expression, CodeBuffer& out) {
+    std::span<const Instruction> program = expression.instructions();
+    std::span<const int64_t> constants = expression.literals();
+
+    if (program.empty()) {
+        out.emit({0x31, 0xC0, 0xC3});  // xor eax, eax; ret
+        return true;
+    }
+    // The frame is reserved without stack probes, so it has to stay well
+    // within one guard page's reach of what the caller already touched
+    if (expression.stackDepth() > NativeExpression::MaxFrameSize / 8) return false;
+
+    uint32_t frame = static_cast<uint32_t>(expression.stackDepth() * 8);
+    out.emit({0x48, 0x81, 0xEC});  // sub rsp, frame
+    out.imm32(frame);
+
+    std::vector<size_t> offsets(program.size() + 1);  // Code offset of every instruction
+    std::vector<ProgramJump> jumps;
+    std::vector<ErrorStub> stubs;
+    size_t depth = 0;
+
+    auto raise = [&](Condition condition, ErrorKind kind, uint32_t position) {
+        stubs.push_back({out.jumpIf(condition), kind, position});
+    };
+
+    for (size_t pc = 0; pc < program.size(); pc++) {
+        offsets[pc] = out.here();
+        const Instruction& ins = program[pc];
+
+        switch (ins.code) {
+        case OpCode::Push:
+            if (depth > 0) out.storeSlot(depth - 1);
+            out.emit({0x48, 0xB8});                  // mov rax, imm64
+            out.imm64(static_cast<uint64_t>(constants[ins.value]));
+            depth++;
+            break;
+
+        case OpCode::Load:
+            if (depth > 0) out.storeSlot(depth - 1);
+            out.emit({0x48, 0x8B, 0x87});            // mov rax, [rdi + 8 * index]
+            out.imm32(static_cast<uint32_t>(ins.value) * 8);
+            depth++;
+            break;
+
+        case OpCode::Dup:
+            out.storeSlot(depth - 1);
+            depth++;
+            break;
+
+        case OpCode::JumpIfFalse:
+            out.emit({0x48, 0x85, 0xC0});            // test rax, rax
+            jumps.push_back({out.jumpIf(Equal), static_cast<size_t>(ins.value)});  // rax is already 0
+            if (depth > 1) out.loadSlot(depth - 2);  // Fall through: pop the left operand
+            depth--;
+            break;
+
+        case OpCode::JumpIfTrue: {
+            out.emit({0x48, 0x85, 0xC0});            // test rax, rax
+            size_t fallThrough = out.jumpIf(Equal);
+            out.emit({0xB8, 0x01, 0x00, 0x00, 0x00}); // mov eax, 1
+            jumps.push_back({out.jump(), static_cast<size_t>(ins.value)});
+            out.bind(fallThrough);
+            if (depth > 1) out.loadSlot(depth - 2);
+            depth--;
+            break;
+        }
+
+        case OpCode::ToBool:
+            out.emit({0x48, 0x85, 0xC0});            // test rax, rax
+            out.setFlag(NotEqual);
+            break;
+
+        // Unary operators work on rax in place
+        case OpCode::Plus:
+            break;
+        case OpCode::Negate:
+            out.emit({0x48, 0xF7, 0xD8});            // neg rax
+            break;
+        case OpCode::Increment:
+            out.emit({0x48, 0x83, 0xC0, 0x01});      // add rax, 1
+            break;
+        case OpCode::Decrement:
+            out.emit({0x48, 0x83, 0xE8, 0x01});      // sub rax, 1
+            break;
+        case OpCode::Not:
+            out.emit({0x48, 0x85, 0xC0});            // test rax, rax
+            out.setFlag(Equal);
+            break;
+
+        default: {
+            if (opInfo(static_cast<Op>(ins.code)).arity != 2) return false;
+
+            // Binary operators: rax = left, rcx = right
+            out.emit({0x48, 0x89, 0xC1});            // mov rcx, rax
+            out.loadSlot(depth - 2);
+            depth--;
+
+            switch (ins.code) {
+            case OpCode::Add:      out.emit({0x48, 0x01, 0xC8}); break;        // add rax, rcx
+            case OpCode::Subtract: out.emit({0x48, 0x29, 0xC8}); break;        // sub rax, rcx
+            case OpCode::Multiply: out.emit({0x48, 0x0F, 0xAF, 0xC1}); break;  // imul rax, rcx
+
+            case OpCode::Divide:
+            case OpCode::Modulo: {
+                out.emit({0x48, 0x85, 0xC9});                 // test rcx, rcx
+                raise(Equal, ErrorKind::DivisionByZero, ins.position);
+                // x / -1 is a negation and x % -1 is 0; idiv would trap on INT64_MIN / -1
+                out.emit({0x48, 0x83, 0xF9, 0xFF});           // cmp rcx, -1
+                size_t general = out.jumpIf(NotEqual);
+                if (ins.code == OpCode::Divide) {
+                    out.emit({0x48, 0xF7, 0xD8});             // neg rax
+                } else {
+                    out.emit({0x31, 0xC0});                   // xor eax, eax
+                }
+                size_t done = out.jump();
+                out.bind(general);
+                out.emit({0x48, 0x99, 0x48, 0xF7, 0xF9});     // cqo; idiv rcx
+                if (ins.code == OpCode::Modulo) {
+                    out.emit({0x48, 0x89, 0xD0});             // mov rax, rdx
+                }
+                out.bind(done);
+                break;
+            }
+
+            case OpCode::Power: {
+                // Exponentiation by squaring: rdx = result, rax = base, rcx = exponent
+                out.emit({0x48, 0x85, 0xC9});                 // test rcx, rcx
+                size_t negative = out.jumpIf(Sign);
+                out.emit({0xBA, 0x01, 0x00, 0x00, 0x00});     // mov edx, 1
+                size_t loop = out.here();
+                out.emit({0x48, 0x85, 0xC9});                 // test rcx, rcx
+                size_t finished = out.jumpIf(Equal);
+                out.emit({0xF6, 0xC1, 0x01});                 // test cl, 1
+                size_t even = out.jumpIf(Equal);
+                out.emit({0x48, 0x0F, 0xAF, 0xD0});           // imul rdx, rax
+                out.bind(even);
+                out.emit({0x48, 0x0F, 0xAF, 0xC0});           // imul rax, rax
+                out.emit({0x48, 0xD1, 0xE9});                 // shr rcx, 1
+                out.patch(out.jump(), loop);
+                out.bind(finished);
+                out.emit({0x48, 0x89, 0xD0});                 // mov rax, rdx
+                size_t done = out.jump();
+
+                // Negative exponent: 1 / a^-b truncated, like Int64Policy::power
+                out.bind(negative);
+                out.emit({0x48, 0x85, 0xC0});                 // test rax, rax
+                raise(Equal, ErrorKind::DivisionByZero, ins.position);
+                out.emit({0x48, 0x83, 0xF8, 0x01});           // cmp rax, 1
+                size_t one = out.jumpIf(Equal);
+                out.emit({0x48, 0x83, 0xF8, 0xFF});           // cmp rax, -1
+                size_t zero = out.jumpIf(NotEqual);
+                out.emit({0xF6, 0xC1, 0x01});                 // test cl, 1
+                size_t odd = out.jumpIf(NotEqual);            // (-1)^odd stays -1
+                out.emit({0xB8, 0x01, 0x00, 0x00, 0x00});     // mov eax, 1
+                size_t even2 = out.jump();
+                out.bind(zero);
+                out.emit({0x31, 0xC0});                       // xor eax, eax
+                out.bind(done);
+                out.bind(one);
+                out.bind(odd);
+                out.bind(even2);
+                break;
+            }
+
+            case OpCode::Greater:      out.emit({0x48, 0x39, 0xC8}); out.setFlag(Condition::Greater); break;
+            case OpCode::GreaterEqual: out.emit({0x48, 0x39, 0xC8}); out.setFlag(Condition::GreaterEqual); break;
+            case OpCode::Less:         out.emit({0x48, 0x39, 0xC8}); out.setFlag(Condition::Less); break;
+            case OpCode::LessEqual:    out.emit({0x48, 0x39, 0xC8}); out.setFlag(Condition::LessEqual); break;
+            case OpCode::Equal:        out.emit({0x48, 0x39, 0xC8}); out.setFlag(Condition::Equal); break;
+            case OpCode::NotEqual:     out.emit({0x48, 0x39, 0xC8}); out.setFlag(Condition::NotEqual); break;
+
+            // Eager && and || (short-circuit programs use the jumps above)
+            case OpCode::And:
+            case OpCode::Or:
+                out.emit({0x48, 0x85, 0xC9, 0x0F, 0x95, 0xC1});  // test rcx, rcx; setne cl
+                out.emit({0x48, 0x85, 0xC0, 0x0F, 0x95, 0xC0});  // test rax, rax; setne al
+                out.emit({static_cast<uint8_t>(ins.code == OpCode::And ? 0x20 : 0x08), 0xC8});  // and/or al, cl
+                out.emit({0x0F, 0xB6, 0xC0});                    // movzx eax, al
+                break;
+
+            default:
+                return false;
+            }
+            break;
+        }
+        }
+    }
+    offsets[program.size()] = out.here();
+
+    // Epilogue: the result is already in rax
+    size_t epilogue = out.here();
+    out.emit({0x48, 0x81, 0xC4});  // add rsp, frame
+    out.imm32(frame);
+    out.emit({0xC3});              // ret
+
+    for (const ProgramJump& jump : jumps) {
+        out.patch(jump.patch, offsets[jump.target]);
+    }
+    for (const ErrorStub& stub : stubs) {
+        out.bind(stub.patch);
+        out.emit({0xC7, 0x06});                // mov dword [rsi], kind
+        out.imm32(static_cast<uint32_t>(stub.kind));
+        out.emit({0xC7, 0x46, 0x04});          // mov dword [rsi + 4], position
+        out.imm32(stub.position);
+        out.emit({0x31, 0xC0});                // xor eax, eax
+        out.patch(out.jump(), epilogue);
+    }
+    return true;
+}
+
+#endif // NATIVE_EXPRESSION_X86_64
+
+NativeExpression::~NativeExpression() {
+#if NATIVE_EXPRESSION_X86_64
+    if (code) ::munmap(code, codeSize);
+#endif
+}
+
+//Whether this build can generate native code at all
+
+bool NativeExpression::available() {
+    return NATIVE_EXPRESSION_X86_64 != 0;
+}
+
+/**
+ * Generate code for a compiled expression
+ * The code is written into fresh read-write pages which are then switched
+ * to read-execute, so no page is ever writable and executable at once.
+ */
+std::unique_ptr<NativeExpression> NativeExpression::compile(const Compiled& expression) {
+#if NATIVE_EXPRESSION_X86_64
+    CodeBuffer buffer;
+    if (!generate(expression, buffer)) return nullptr;
+
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t size = (buffer.bytes.size() + page - 1) / page * page;
+    void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, buffer.bytes.data(), buffer.bytes.size());
+    if (::mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        ::munmap(memory, size);
+        return nullptr;
+    }
+
+    std::unique_ptr<NativeExpression> native(new NativeExpression());
+    native->code = memory;
+    native->codeSize = size;
+    native->entry = reinterpret_cast<Function>(memory);
+    native->variableCount = expression.variables().size();
+    return native;
+#else
+    (void)expression;
+    return nullptr;
+#endif
+}
+
+//Execute the code
+
+int64_t NativeExpression::run(std::span<const int64_t> variables) const {
+    if (variables.size() < variableCount) {
+        throw std::invalid_argument("Native expressions need a value for every variable");
+    }
+    NativeFault fault;
+    int64_t result = entry(variables.data(), &fault);
+    if (fault.kind != static_cast<uint32_t>(ErrorKind::None)) {
+        throw EvalError(static_cast<ErrorKind>(fault.kind), fault.position);
+    }
+    return result;
+}
+
+//Generate the native code; later callers wait for the first one
+
+void HotExpression::promote() const {
+    std::call_once(promotion, [this] {
+        nativeCode = NativeExpression::compile(expression);
+        native.store(nativeCode.get(), std::memory_order_release);
+    });
+}
+
+/**
+ * Execute the expression
+ * Calls that don't bind every variable stay in the interpreter, which
+ * reports the unbound variable only if it is actually reached.
+ */
+int64_t HotExpression::run(std::span<const int64_t> variables) const {
+    bool bound = variables.size() >= expression.variables().size();
+    if (const NativeExpression* code = native.load(std::memory_order_acquire); code && bound) {
+        return code->run(variables);
+    }
+    if (runs.load(std::memory_order_relaxed) <= promoteAfter &&
+        runs.fetch_add(1, std::memory_order_relaxed) + 1 > promoteAfter) {
+        promote();
+        if (const NativeExpression* code = native.load(std::memory_order_acquire); code && bound) {
+            return code->run(variables);
+        }
+    }
+    return expression.run(variables);
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef NATIVE_EXPRESSION_H
+#define NATIVE_EXPRESSION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include "CompiledExpression.h"
+#include "EvalError.h"
+#include "NumericPolicy.h"
+
+//Where native code reports an evaluation error
+struct NativeFault {
+    uint32_t kind = 0;      ///< ErrorKind, None when the call succeeded
+    uint32_t position = 0;  ///< Source offset of the failing operator
+};
+
+//class NativeExpression
+//A compiled 64-bit expression (Int64Policy) lowered to x86-64 machine code.
+//The code lives in its own executable pages and computes exactly what
+//BasicCompiledExpression::run() does, including && / || short-circuiting
+//and division by zero, which is reported through a NativeFault.
+class NativeExpression {
+public:
+    using Compiled = BasicCompiledExpression<Int64Policy>;
+
+    //Native entry point: variables holds one value per Compiled::variables()
+    using Function = int64_t (*)(const int64_t* variables, NativeFault* fault);
+
+private:
+    void* code = nullptr;       ///< Executable mapping
+    size_t codeSize = 0;        ///< Size of the mapping
+    Function entry = nullptr;
+    size_t variableCount = 0;
+
+    NativeExpression() = default;
+
+public:
+    //Largest operand stack frame the generated code reserves. The frame is
+    //taken in one step without probing the pages below it, so deeper
+    //programs are left to the interpreter rather than risk jumping past
+    //the guard page of the thread's stack.
+    static constexpr size_t MaxFrameSize = 64 << 10;
+
+    ~NativeExpression();
+
+    NativeExpression(const NativeExpression&) = delete;
+    NativeExpression& operator=(const NativeExpression&) = delete;
+
+    //Whether this build can generate native code at all
+    static bool available();
+
+    //Generate code for a compiled expression; nullptr when the platform or
+    //the program isn't supported (including programs whose operand stack
+    //needs more than MaxFrameSize), in which case the interpreter has to do
+    static std::unique_ptr<NativeExpression> compile(const Compiled& expression);
+
+    //Execute the code (throws EvalError like Compiled::run()). variables
+    //must hold a value for every variable of the expression.
+    int64_t run(std::span<const int64_t> variables = {}) const;
+
+    //The raw entry point
+    Function function() const { return entry; }
+
+    //Bytes of machine code generated
+    size_t size() const { return codeSize; }
+};
+
+//class HotExpression
+//A compiled 64-bit expression that runs in the interpreter until it has
+//been evaluated more than promoteAfter times, and is then translated to
+//native code once (by whichever thread crosses the threshold). Where native
+//code isn't available it simply keeps interpreting. Safe to share between threads.
+class HotExpression {
+public:
+    using Compiled = BasicCompiledExpression<Int64Policy>;
+
+private:
+    Compiled expression;
+    size_t promoteAfter;
+    mutable std::atomic<size_t> runs{0};
+    mutable std::atomic<const NativeExpression*> native{nullptr};
+    mutable std::unique_ptr<NativeExpression> nativeCode;
+    mutable std::once_flag promotion;
+
+    //Generate the native code; later callers wait for the first one
+    void promote() const;
+
+public:
+    explicit HotExpression(Compiled compiled, size_t threshold = 1000)
+        : expression(std::move(compiled)), promoteAfter(threshold) {}
+
+    HotExpression(const HotExpression&) = delete;
+    HotExpression& operator=(const HotExpression&) = delete;
+
+    //Execute the expression with values for its variables (in variables() order)
+    int64_t run(std::span<const int64_t> variables = {}) const;
+
+    //Whether the expression runs as native code by now
+    bool isNative() const { return native.load(std::memory_order_acquire) != nullptr; }
+
+    //The interpreted form
+    const Compiled& compiled() const { return expression; }
+};
+
+#endif // NATIVE_EXPRESSION_H
\ No newline at end of file
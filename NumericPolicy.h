@@ -0,0 +1,256 @@
+#ifndef NUMERIC_POLICY_H
+#define NUMERIC_POLICY_H
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include "EvalError.h"
+
+//A numeric policy decides the value type of an evaluator and how each
+//operation behaves on it. Every policy provides:
+//  value_type                           the type expressions evaluate to
+//  canFail                             arithmetic itself may raise an error (beyond division by zero)
+//  associative                          + and * may be regrouped by the optimizer
+//  involutiveNegate                     negating twice gives back every value, so -(-x) may become x
+//  parseLiteral(digits, out)            convert a decimal literal
+//  add/subtract/multiply/divide/modulo/power(a, b, out), negate/increment/decrement(a, out)
+//                                       compute into out, returning ErrorKind::None on success
+//  truthy(a)                            whether a counts as true
+//Operations are static member functions so each evaluator instantiation is
+//specialized for its policy with no runtime type dispatch. They are
+//constexpr (except the double % and ^, which need <cmath>) so expressions
+//can also be evaluated during compilation (see ConstantExpression.h).
+
+//How an integer policy treats results that don't fit
+enum class OverflowMode : uint8_t {
+    Wrap,       ///< Two's complement wrap-around (fastest)
+    Check,      ///< Raise ErrorKind::Overflow
+    Saturate    ///< Clamp to the smallest/largest value
+};
+
+//Limits of the integer types a policy can use (std::numeric_limits is not
+//specialized for __int128 in strict standard mode)
+template <class T> struct IntegerLimits;
+template <> struct IntegerLimits<int32_t> {
+    static constexpr int32_t min = INT32_MIN;
+    static constexpr int32_t max = INT32_MAX;
+};
+template <> struct IntegerLimits<int64_t> {
+    static constexpr int64_t min = INT64_MIN;
+    static constexpr int64_t max = INT64_MAX;
+};
+template <> struct IntegerLimits<__int128> {
+    static constexpr __int128 max = static_cast<__int128>(~static_cast<unsigned __int128>(0) >> 1);
+    static constexpr __int128 min = -max - 1;
+};
+
+/**
+ * Value of eight decimal digits, converted together rather than one by one
+ * The digits are loaded as one 64-bit word, first digit in the low byte,
+ * and neighbouring digits, pairs and quadruples are combined with one
+ * multiply each (SWAR).
+ */
+constexpr uint32_t parseEightDigits(const char* digits) {
+    uint64_t chunk = 0;
+    if (!std::is_constant_evaluated() && std::endian::native == std::endian::little) {
+        __builtin_memcpy(&chunk, digits, sizeof(chunk));
+    } else {
+        for (int i = 0; i < 8; i++) {
+            chunk |= static_cast<uint64_t>(static_cast<uint8_t>(digits[i])) << (8 * i);
+        }
+    }
+    chunk -= 0x3030303030303030ull;                                                 // 8 digits 0..9
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFull;                   // 4 pairs 0..99
+    chunk = ((chunk * (1 + (100ull << 16))) >> 16) & 0x0000FFFF0000FFFFull;         // 2 quads 0..9999
+    return static_cast<uint32_t>((chunk * (1 + (10000ull << 32))) >> 32);          // 0..99999999
+}
+
+//class IntegerPolicy
+//Signed integer arithmetic on T; overflow handled according to Mode
+template <class T, OverflowMode Mode>
+struct IntegerPolicy {
+    using value_type = T;
+
+    static constexpr bool canFail = (Mode == OverflowMode::Check);
+    static constexpr bool associative = (Mode == OverflowMode::Wrap);
+    static constexpr bool involutiveNegate = (Mode == OverflowMode::Wrap);
+
+    static constexpr T minValue = IntegerLimits<T>::min;
+    static constexpr T maxValue = IntegerLimits<T>::max;
+
+    //Pick the result of an operation that may have overflowed
+    static constexpr ErrorKind finish(bool overflowed, T wrapped, T saturated, T& out) {
+        if (!overflowed || Mode == OverflowMode::Wrap) {
+            out = wrapped;
+            return ErrorKind::None;
+        }
+        if (Mode == OverflowMode::Saturate) {
+            out = saturated;
+            return ErrorKind::None;
+        }
+        return ErrorKind::Overflow;
+    }
+
+    //Convert a decimal literal; literals too large for T follow the overflow mode
+    static constexpr ErrorKind parseLiteral(std::string_view digits, T& out) {
+        T value = 0;
+        bool overflowed = false;
+        // Shifting in eight digits at once wraps and overflows exactly like
+        // shifting them in one at a time
+        size_t i = 0;
+        for (; i + 8 <= digits.size(); i += 8) {
+            overflowed |= __builtin_mul_overflow(value, static_cast<T>(100000000), &value);
+            overflowed |= __builtin_add_overflow(value, static_cast<T>(parseEightDigits(digits.data() + i)), &value);
+        }
+        for (; i < digits.size(); i++) {
+            overflowed |= __builtin_mul_overflow(value, static_cast<T>(10), &value);
+            overflowed |= __builtin_add_overflow(value, static_cast<T>(digits[i] - '0'), &value);
+        }
+        if (overflowed && Mode == OverflowMode::Check) return ErrorKind::NumberOutOfRange;
+        out = (overflowed && Mode == OverflowMode::Saturate) ? maxValue : value;
+        return ErrorKind::None;
+    }
+
+    static constexpr ErrorKind add(T a, T b, T& out) {
+        T r;
+        bool o = __builtin_add_overflow(a, b, &r);
+        return finish(o, r, b > 0 ? maxValue : minValue, out);
+    }
+
+    static constexpr ErrorKind subtract(T a, T b, T& out) {
+        T r;
+        bool o = __builtin_sub_overflow(a, b, &r);
+        return finish(o, r, b < 0 ? maxValue : minValue, out);
+    }
+
+    static constexpr ErrorKind multiply(T a, T b, T& out) {
+        T r;
+        bool o = __builtin_mul_overflow(a, b, &r);
+        return finish(o, r, (a < 0) != (b < 0) ? minValue : maxValue, out);
+    }
+
+    static constexpr ErrorKind divide(T a, T b, T& out) {
+        if (b == 0) return ErrorKind::DivisionByZero;
+        // The only overflowing quotient: minValue / -1
+        if (b == -1) return negate(a, out);
+        out = a / b;
+        return ErrorKind::None;
+    }
+
+    static constexpr ErrorKind modulo(T a, T b, T& out) {
+        if (b == 0) return ErrorKind::DivisionByZero;
+        out = (b == -1) ? 0 : a % b;
+        return ErrorKind::None;
+    }
+
+    //Exponentiation by squaring: O(log b) multiplications.
+    //A negative exponent is 1 / a^-b truncated towards zero, which is 0
+    //unless a is 1 or -1 (and a division by zero when a is 0).
+    static constexpr ErrorKind power(T a, T b, T& out) {
+        if (b < 0) {
+            if (a == 0) return ErrorKind::DivisionByZero;
+            out = (a == 1) ? 1 : (a == -1) ? ((b & 1) ? -1 : 1) : 0;
+            return ErrorKind::None;
+        }
+
+        // The exact result is negative only for a negative base and an odd exponent
+        bool negative = a < 0 && (b & 1);
+        T result = 1;
+        T base = a;
+        bool overflowed = false;
+        while (b > 0) {
+            if (b & 1) overflowed |= __builtin_mul_overflow(result, base, &result);
+            b >>= 1;
+            // Squaring past the last bit would report an overflow nobody uses
+            if (b > 0) overflowed |= __builtin_mul_overflow(base, base, &base);
+        }
+        return finish(overflowed, result, negative ? minValue : maxValue, out);
+    }
+
+    static constexpr ErrorKind negate(T a, T& out) {
+        return finish(a == minValue, a == minValue ? minValue : -a, maxValue, out);
+    }
+
+    static constexpr ErrorKind increment(T a, T& out) { return add(a, 1, out); }
+    static constexpr ErrorKind decrement(T a, T& out) { return subtract(a, 1, out); }
+
+    static constexpr bool truthy(T a) { return a != 0; }
+};
+
+//class DoublePolicy
+//IEEE double arithmetic; division or modulo by zero is still an error
+struct DoublePolicy {
+    using value_type = double;
+
+    static constexpr bool canFail = false;
+    static constexpr bool associative = false;
+    static constexpr bool involutiveNegate = true;
+
+    static constexpr ErrorKind parseLiteral(std::string_view digits, double& out) {
+        double value = 0;
+        for (char c : digits) value = value * 10 + (c - '0');
+        out = value;
+        return ErrorKind::None;
+    }
+
+    static constexpr ErrorKind add(double a, double b, double& out)      { out = a + b; return ErrorKind::None; }
+    static constexpr ErrorKind subtract(double a, double b, double& out) { out = a - b; return ErrorKind::None; }
+    static constexpr ErrorKind multiply(double a, double b, double& out) { out = a * b; return ErrorKind::None; }
+
+    static constexpr ErrorKind divide(double a, double b, double& out) {
+        if (b == 0) return ErrorKind::DivisionByZero;
+        out = a / b;
+        return ErrorKind::None;
+    }
+
+    static ErrorKind modulo(double a, double b, double& out) {
+        if (b == 0) return ErrorKind::DivisionByZero;
+        out = std::fmod(a, b);
+        return ErrorKind::None;
+    }
+
+    //Integral exponents use exponentiation by squaring (negative ones give the
+    //reciprocal); anything else falls back to std::pow
+    static ErrorKind power(double a, double b, double& out) {
+        if (b != std::trunc(b) || std::fabs(b) > 9.0e18) {
+            out = std::pow(a, b);
+            return ErrorKind::None;
+        }
+        uint64_t exponent = static_cast<uint64_t>(std::fabs(b));
+        double result = 1;
+        double base = a;
+        while (exponent > 0) {
+            if (exponent & 1) result *= base;
+            exponent >>= 1;
+            if (exponent > 0) base *= base;
+        }
+        out = (b < 0) ? 1 / result : result;
+        return ErrorKind::None;
+    }
+
+    static constexpr ErrorKind negate(double a, double& out)    { out = -a; return ErrorKind::None; }
+    static constexpr ErrorKind increment(double a, double& out) { out = a + 1; return ErrorKind::None; }
+    static constexpr ErrorKind decrement(double a, double& out) { out = a - 1; return ErrorKind::None; }
+
+    static constexpr bool truthy(double a) { return a != 0; }
+};
+
+using Int32Policy = IntegerPolicy<int32_t, OverflowMode::Wrap>;
+using Int64Policy = IntegerPolicy<int64_t, OverflowMode::Wrap>;
+using Int128Policy = IntegerPolicy<__int128, OverflowMode::Wrap>;
+using CheckedInt32Policy = IntegerPolicy<int32_t, OverflowMode::Check>;
+using CheckedInt64Policy = IntegerPolicy<int64_t, OverflowMode::Check>;
+using SaturatingInt32Policy = IntegerPolicy<int32_t, OverflowMode::Saturate>;
+using SaturatingInt64Policy = IntegerPolicy<int64_t, OverflowMode::Saturate>;
+
+//Policies compiled into the library; other policies work too but are
+//instantiated wherever they are used
+#define EVALUATOR_STANDARD_POLICIES(X) \
+    X(Int32Policy) X(Int64Policy) X(Int128Policy) \
+    X(CheckedInt32Policy) X(CheckedInt64Policy) \
+    X(SaturatingInt32Policy) X(SaturatingInt64Policy) \
+    X(DoublePolicy)
+
+#endif // NUMERIC_POLICY_H
\ No newline at end of file
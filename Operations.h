@@ -0,0 +1,76 @@
+#ifndef OPERATIONS_H
+#define OPERATIONS_H
+
+#include <cstdint>
+#include "Lexer.h"
+#include "EvalError.h"
+#include "NumericPolicy.h"
+
+//Apply a unary operator under a numeric policy
+//Returns ErrorKind::None and stores the result in out, or the error it raises
+
+template <class Policy>
+constexpr ErrorKind tryUnaryOperation(Op op, typename Policy::value_type a, typename Policy::value_type& out) {
+    switch (op) {
+    case Op::Negate:    return Policy::negate(a, out);     // Unary minus - negates the value
+    case Op::Increment: return Policy::increment(a, out);  // Prefix increment
+    case Op::Decrement: return Policy::decrement(a, out);  // Prefix decrement
+    case Op::Not:       out = !Policy::truthy(a); return ErrorKind::None;  // Logical NOT
+    default:            out = a; return ErrorKind::None;   // Unary plus - returns the value unchanged
+    }
+}
+
+//Apply a binary arithmetic or logical operator under a numeric policy
+//Returns ErrorKind::None and stores the result in out, or the error it raises
+
+template <class Policy>
+constexpr ErrorKind tryOperation(Op op, typename Policy::value_type a, typename Policy::value_type b,
+                              typename Policy::value_type& out) {
+    switch (op) {
+    case Op::Add:          return Policy::add(a, b, out);
+    case Op::Subtract:     return Policy::subtract(a, b, out);
+    case Op::Multiply:     return Policy::multiply(a, b, out);
+    case Op::Divide:       return Policy::divide(a, b, out);
+    case Op::Modulo:       return Policy::modulo(a, b, out);
+    case Op::Power:        return Policy::power(a, b, out);
+    case Op::Greater:      out = a > b;  break;
+    case Op::GreaterEqual: out = a >= b; break;
+    case Op::Less:         out = a < b;  break;
+    case Op::LessEqual:    out = a <= b; break;
+    case Op::Equal:        out = a == b; break;
+    case Op::NotEqual:     out = a != b; break;
+    case Op::And:          out = Policy::truthy(a) && Policy::truthy(b); break;  // Treats 0 as false, non-zero as true
+    case Op::Or:           out = Policy::truthy(a) || Policy::truthy(b); break;
+    default:               out = 0; break;
+    }
+    return ErrorKind::None;
+}
+
+//Perform a unary operation
+//position is the operator's source offset, reported if the operation fails
+
+template <class Policy>
+constexpr typename Policy::value_type performUnaryOperation(Op op, typename Policy::value_type a, size_t position) {
+    typename Policy::value_type result;
+    ErrorKind error = tryUnaryOperation<Policy>(op, a, result);
+    if (error != ErrorKind::None) {
+        throw EvalError(error, position);
+    }
+    return result;
+}
+
+//Perform a binary arithmetic or logical operation
+//position is the operator's source offset, reported on division by zero or overflow
+
+template <class Policy>
+constexpr typename Policy::value_type performOperation(Op op, typename Policy::value_type a,
+                                                    typename Policy::value_type b, size_t position) {
+    typename Policy::value_type result;
+    ErrorKind error = tryOperation<Policy>(op, a, b, result);
+    if (error != ErrorKind::None) {
+        throw EvalError(error, position);
+    }
+    return result;
+}
+
+#endif // OPERATIONS_H
\ No newline at end of file
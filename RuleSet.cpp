@@ -0,0 +1,8 @@
+#include "RuleSet.h"
+
+//The rule sets of the standard numeric policies are instantiated here once
+//rather than in every file that uses them
+
+#define EVALUATOR_INSTANTIATE_RULE_SET(P) template class BasicRuleSet<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_RULE_SET)
+#undef EVALUATOR_INSTANTIATE_RULE_SET
\ No newline at end of file
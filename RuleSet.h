@@ -0,0 +1,397 @@
+#ifndef RULE_SET_H
+#define RULE_SET_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Arena.h"
+#include "Ast.h"
+#include "CompiledExpression.h"
+#include "EvalError.h"
+#include "Evaluator.h"
+#include "NumericPolicy.h"
+#include "Operations.h"
+#include "SmallStack.h"
+#include "Translator.h"
+
+//class BasicRuleSet
+//Many expressions ("rules") over one set of variables, compiled together.
+//Every rule is parsed and optimized as by BasicEvaluator::compile(), then
+//its tree is merged into one shared DAG: identical subtrees, in any rule,
+//become a single node, and the operands of commutative operators (and of
+//comparisons, turning > into <) are put in a canonical order first, so
+//"(a - b) * 100" and "100 * (a - b)" share everything.
+//
+//run() computes each node once per record and all rule results together.
+//Errors travel through the DAG as values, so a rule fails exactly when
+//evaluating it alone would fail, && / || included; the failing rule is
+//then rerun on its own to report the error at its position in that rule.
+template <class Policy>
+class BasicRuleSet {
+public:
+    using value_type = typename Policy::value_type;
+    using Compiled = BasicCompiledExpression<Policy>;
+    using Result = BasicEvalResult<value_type>;
+
+private:
+    //A node of the shared DAG; operands are indices of earlier nodes
+    struct DagNode {
+        NodeKind kind;
+        Op op;
+        bool mayFault;     ///< Can produce an error (for any record)
+        int value;         ///< Variable index, or exponent of a Power node
+        int left;
+        int right;
+        value_type constant;
+
+        bool operator==(const DagNode& other) const {
+            return kind == other.kind && op == other.op && value == other.value && left == other.left &&
+                   right == other.right && std::memcmp(&constant, &other.constant, sizeof(value_type)) == 0;
+        }
+    };
+
+    struct DagNodeHash {
+        size_t operator()(const DagNode& node) const {
+            size_t hash = std::hash<std::string_view>{}(
+                std::string_view(reinterpret_cast<const char*>(&node.constant), sizeof(value_type)));
+            for (int part : {static_cast<int>(node.kind), static_cast<int>(node.op), node.value, node.left, node.right}) {
+                hash = (hash ^ static_cast<size_t>(part)) * 0x100000001B3ull;
+            }
+            return hash;
+        }
+    };
+
+    //A rule: its DAG node, and its own program for reporting errors
+    struct Rule {
+        int root = -1;                          ///< -1 for an expression without tokens
+        ErrorKind error = ErrorKind::None;      ///< Syntax error of the rule
+        size_t errorPosition = EvalError::npos;
+        Compiled compiled;
+        std::vector<int> variableMap;           ///< Index in variables() of each of compiled.variables()
+    };
+
+    std::vector<DagNode> nodes;  ///< In topological order: operands come first
+    std::vector<Rule> ruleList;
+    std::vector<std::string> variableNames;
+    size_t treeNodes = 0;
+
+    //The id of a node, adding it unless an identical one exists
+    int intern(DagNode node, std::unordered_map<DagNode, int, DagNodeHash>& index);
+
+    //Merge the optimized tree of a rule into the DAG; returns its root
+    int merge(const BasicNode<value_type>* root, const std::vector<std::string>& names,
+              std::unordered_map<DagNode, int, DagNodeHash>& index);
+
+    //Evaluate a rule alone to find where it fails
+    void explain(const Rule& rule, std::span<const value_type> variables, Result& result) const;
+
+public:
+    //Compile a batch of rules. A rule with a syntax error is kept and
+    //reports that error every time it is run.
+    explicit BasicRuleSet(std::span<const std::string_view> rules);
+
+    //Evaluate every rule against one record, which holds a value for each
+    //of variables() (in that order); results[i] receives the outcome of rule i
+    void run(std::span<const value_type> variables, std::span<Result> results) const;
+
+    //Names of the variables the rules use, in order of first use
+    const std::vector<std::string>& variables() const { return variableNames; }
+
+    //Index of a variable in variables(), or -1 when no rule uses it
+    int variableIndex(std::string_view name) const;
+
+    //Number of rules
+    size_t size() const { return ruleList.size(); }
+
+    //Number of nodes of the shared DAG, computed once per record
+    size_t nodeCount() const { return nodes.size(); }
+
+    //Number of nodes of all optimized rule trees before sharing
+    size_t treeNodeCount() const { return treeNodes; }
+};
+
+//Rule set of the default (32-bit int) evaluator
+using RuleSet = BasicRuleSet<Int32Policy>;
+
+//Compile a batch of rules
+
+template <class Policy>
+BasicRuleSet<Policy>::BasicRuleSet(std::span<const std::string_view> rules) {
+    std::unordered_map<DagNode, int, DagNodeHash> index;
+    BasicEvaluator<Policy> evaluator;
+
+    ruleList.resize(rules.size());
+    for (size_t i = 0; i < rules.size(); i++) {
+        Rule& rule = ruleList[i];
+        try {
+            rule.compiled = evaluator.compile(rules[i]);
+        } catch (const EvalError& e) {
+            rule.error = e.kind();
+            rule.errorPosition = e.position();
+            continue;
+        }
+
+        // Same tree as compile() built, so both agree on every result
+        using Node = BasicNode<value_type>;
+        Arena arena(rules[i].size() * 2 * sizeof(Node) + 256);
+        std::vector<std::string> names;
+        AstBuilder<Policy> builder(arena, names);
+        translate(rules[i], builder);
+        rule.root = merge(AstOptimizer<Policy>(arena).optimize(builder.root()), names, index);
+
+        // Also the variables the optimizer dropped from the tree: explain()
+        // binds every variable of the rule's own program
+        for (const std::string& name : rule.compiled.variables()) {
+            int global = variableIndex(name);
+            if (global < 0) {
+                variableNames.push_back(name);
+                global = static_cast<int>(variableNames.size() - 1);
+            }
+            rule.variableMap.push_back(global);
+        }
+    }
+}
+
+//The id of a node, adding it unless an identical one exists
+
+template <class Policy>
+int BasicRuleSet<Policy>::intern(DagNode node, std::unordered_map<DagNode, int, DagNodeHash>& index) {
+    treeNodes++;
+    auto found = index.find(node);
+    if (found != index.end()) return found->second;
+    nodes.push_back(node);
+    int id = static_cast<int>(nodes.size() - 1);
+    index.emplace(node, id);
+    return id;
+}
+
+/**
+ * Merge an optimized tree into the DAG
+ * Children are merged before their parent (with an explicit stack, as the
+ * tree may be deeper than recursion allows), so a parent is looked up by
+ * the ids of its operands. Before the lookup the operands of commutative
+ * operators are sorted by id, and a > b becomes b < a (likewise >=); this
+ * is skipped when both operands can fail, since which one fails first
+ * decides the error. && and || are only reordered when neither side can
+ * fail: then they are plain boolean functions.
+ */
+template <class Policy>
+int BasicRuleSet<Policy>::merge(const BasicNode<value_type>* root, const std::vector<std::string>& names,
+                                std::unordered_map<DagNode, int, DagNodeHash>& index) {
+    if (!root) return -1;
+
+    struct Frame {
+        const BasicNode<value_type>* node;
+        bool expanded;
+    };
+
+    SmallStack<Frame, 64> stack;
+    SmallStack<int, 64> ids;  ///< Merged operands waiting for their parent
+    stack.push({root, false});
+
+    while (!stack.empty()) {
+        Frame& frame = stack.top();
+        const BasicNode<value_type>* node = frame.node;
+        if (!frame.expanded) {
+            frame.expanded = true;
+            if (node->right) stack.push({node->right, false});
+            if (node->left) stack.push({node->left, false});
+            continue;
+        }
+        stack.pop();
+
+        DagNode merged{node->kind, node->op, false, 0, -1, -1, value_type(0)};
+        switch (node->kind) {
+        case NodeKind::Constant:
+            merged.op = Op::Count;
+            merged.constant = node->constant;
+            break;
+
+        case NodeKind::Variable: {
+            const std::string& name = names[node->value];
+            merged.op = Op::Count;
+            merged.value = variableIndex(name);
+            if (merged.value < 0) {
+                variableNames.push_back(name);
+                merged.value = static_cast<int>(variableNames.size() - 1);
+            }
+            break;
+        }
+
+        case NodeKind::Unary:
+        case NodeKind::Power:
+            merged.left = ids.top();
+            ids.pop();
+            merged.value = node->kind == NodeKind::Power ? node->value : 0;
+            // Mirrors NodeFactory, except that run() binds every variable
+            merged.mayFault = nodes[merged.left].mayFault ||
+                              (Policy::canFail && (node->kind == NodeKind::Power || node->op == Op::Negate ||
+                                                   node->op == Op::Increment || node->op == Op::Decrement));
+            break;
+
+        case NodeKind::Binary: {
+            merged.right = ids.top();
+            ids.pop();
+            merged.left = ids.top();
+            ids.pop();
+            const DagNode& left = nodes[merged.left];
+            const DagNode& right = nodes[merged.right];
+            merged.mayFault = left.mayFault || right.mayFault ||
+                              NodeFactory<Policy>::operatorMayFail(merged.op, node->left, node->right);
+
+            bool bothFault = left.mayFault && right.mayFault;
+            bool anyFault = left.mayFault || right.mayFault;
+            bool commutative = merged.op == Op::Add || merged.op == Op::Multiply || merged.op == Op::Equal ||
+                               merged.op == Op::NotEqual || merged.op == Op::Greater ||
+                               merged.op == Op::GreaterEqual;
+            if (merged.op == Op::And || merged.op == Op::Or) commutative = !anyFault;
+            if (commutative && !bothFault && (merged.left > merged.right || merged.op == Op::Greater ||
+                                              merged.op == Op::GreaterEqual)) {
+                std::swap(merged.left, merged.right);
+                if (merged.op == Op::Greater) merged.op = Op::Less;
+                if (merged.op == Op::GreaterEqual) merged.op = Op::LessEqual;
+            }
+            break;
+        }
+        }
+        ids.push(intern(merged, index));
+    }
+    return ids.top();
+}
+
+//Evaluate a rule alone to find where it fails
+
+template <class Policy>
+void BasicRuleSet<Policy>::explain(const Rule& rule, std::span<const value_type> variables, Result& result) const {
+    std::vector<value_type> bound;
+    for (int global : rule.variableMap) bound.push_back(variables[global]);
+    try {
+        result.value = rule.compiled.run(bound);
+        result.error = ErrorKind::None;
+    } catch (const EvalError& e) {
+        result.error = e.kind();
+        result.position = e.position();
+        result.message = e.what();
+    }
+}
+
+/**
+ * Evaluate every rule against one record
+ * The DAG is evaluated in order, each node once, into a value and an error
+ * per node. An operator passes on the first error of its operands in the
+ * order the interpreter evaluates them; && and || only look at the error
+ * of their right operand when the left one doesn't decide, just as the
+ * interpreter would have skipped it.
+ */
+template <class Policy>
+void BasicRuleSet<Policy>::run(std::span<const value_type> variables, std::span<Result> results) const {
+    if (variables.size() < variableNames.size()) {
+        throw std::invalid_argument("Record has " + std::to_string(variables.size()) + " values but the rules use " +
+                                    std::to_string(variableNames.size()) + " variables");
+    }
+    if (results.size() < ruleList.size()) {
+        throw std::invalid_argument("Fewer results than rules");
+    }
+
+    // Reused per thread so evaluating a record never allocates
+    thread_local std::vector<value_type> values;
+    thread_local std::vector<ErrorKind> errors;
+    values.resize(nodes.size());
+    errors.resize(nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const DagNode& node = nodes[i];
+        value_type result = 0;
+        ErrorKind error = ErrorKind::None;
+
+        switch (node.kind) {
+        case NodeKind::Constant:
+            result = node.constant;
+            break;
+        case NodeKind::Variable:
+            result = variables[node.value];
+            break;
+        case NodeKind::Unary:
+            error = errors[node.left];
+            if (error == ErrorKind::None) error = tryUnaryOperation<Policy>(node.op, values[node.left], result);
+            break;
+        case NodeKind::Power: {
+            // The multiplications emitProgram() lowers x^2..x^4 to
+            value_type x = values[node.left];
+            error = errors[node.left];
+            if (error != ErrorKind::None) break;
+            if (node.value == 4) {
+                error = Policy::multiply(x, x, result);
+                if (error == ErrorKind::None) error = Policy::multiply(result, result, result);
+            } else {
+                result = x;
+                for (int k = 1; k < node.value && error == ErrorKind::None; k++) {
+                    error = Policy::multiply(x, result, result);
+                }
+            }
+            break;
+        }
+        case NodeKind::Binary:
+            error = errors[node.left];
+            if (error != ErrorKind::None) break;
+            if (node.op == Op::And || node.op == Op::Or) {
+                if ((node.op == Op::And) != Policy::truthy(values[node.left])) {
+                    result = (node.op == Op::Or);  // The left operand decides
+                } else {
+                    error = errors[node.right];
+                    result = Policy::truthy(values[node.right]);
+                }
+                break;
+            }
+            error = errors[node.right];
+            if (error == ErrorKind::None) error = tryOperation<Policy>(node.op, values[node.left], values[node.right], result);
+            break;
+        }
+        values[i] = result;
+        errors[i] = error;
+    }
+
+    for (size_t i = 0; i < ruleList.size(); i++) {
+        const Rule& rule = ruleList[i];
+        Result& result = results[i];
+        result.position = EvalError::npos;
+        result.message.clear();
+        if (rule.error != ErrorKind::None) {
+            result.value = 0;
+            result.error = rule.error;
+            result.position = rule.errorPosition;
+            result.message = EvalError(rule.error, rule.errorPosition).what();
+        } else if (rule.root < 0) {
+            result.value = 0;
+            result.error = ErrorKind::None;
+        } else if (errors[rule.root] == ErrorKind::None) {
+            result.value = values[rule.root];
+            result.error = ErrorKind::None;
+        } else {
+            explain(rule, variables, result);
+        }
+    }
+}
+
+//Index of a variable in variables()
+
+template <class Policy>
+int BasicRuleSet<Policy>::variableIndex(std::string_view name) const {
+    for (size_t i = 0; i < variableNames.size(); i++) {
+        if (variableNames[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// The standard policies are instantiated once, in RuleSet.cpp
+#define EVALUATOR_EXTERN_RULE_SET(P) extern template class BasicRuleSet<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_RULE_SET)
+#undef EVALUATOR_EXTERN_RULE_SET
+
+#endif // RULE_SET_H
\ No newline at end of file
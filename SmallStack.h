@@ -0,0 +1,47 @@
+#ifndef SMALL_STACK_H
+#define SMALL_STACK_H
+
+#include <cstddef>
+
+//class SmallStack
+//A stack that keeps its first N elements inline and only touches the heap
+//when an expression nests deeper than that. Usable in constant expressions
+//(the inline storage is left uninitialized until pushed to).
+template <class T, size_t N>
+class SmallStack {
+private:
+    T inlineItems[N];               ///< Storage used until it fills up
+    T* heapItems = nullptr;         ///< Spill storage for deep expressions
+    T* items = inlineItems;         ///< Whichever storage is active
+    size_t capacity = N;
+    size_t count = 0;
+
+    //Move to a heap buffer twice the current size
+    constexpr void grow() {
+        T* bigger = new T[capacity * 2];
+        for (size_t i = 0; i < count; i++) bigger[i] = items[i];
+        delete[] heapItems;
+        heapItems = bigger;
+        items = heapItems;
+        capacity *= 2;
+    }
+
+public:
+    constexpr SmallStack() {}
+    constexpr ~SmallStack() { delete[] heapItems; }
+    SmallStack(const SmallStack&) = delete;
+    SmallStack& operator=(const SmallStack&) = delete;
+
+    constexpr void push(const T& item) {
+        if (count == capacity) grow();
+        items[count++] = item;
+    }
+
+    constexpr void pop() { count--; }
+    constexpr T& top() { return items[count - 1]; }
+    constexpr const T& top() const { return items[count - 1]; }
+    constexpr bool empty() const { return count == 0; }
+    constexpr size_t size() const { return count; }
+};
+
+#endif // SMALL_STACK_H
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include "StreamEvaluator.h"
+
+//The stream evaluators of the standard numeric policies are instantiated
+//here once rather than in every file that uses them
+
+#define EVALUATOR_INSTANTIATE_STREAM(P) template class BasicStreamEvaluator<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_STREAM)
+#undef EVALUATOR_INSTANTIATE_STREAM
\ No newline at end of file
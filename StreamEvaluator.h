@@ -0,0 +1,202 @@
+#ifndef STREAM_EVALUATOR_H
+#define STREAM_EVALUATOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+#include "EvalError.h"
+#include "Evaluator.h"
+#include "Lexer.h"
+#include "NumericPolicy.h"
+#include "Translator.h"
+
+//Limits a BasicStreamEvaluator enforces as it reads, so hostile input can't
+//make it hold unbounded memory. Exceeding one raises
+//ErrorKind::LimitExceeded at the token that did.
+struct StreamLimits {
+    size_t maxNesting = 1 << 12;      ///< Parentheses open at once
+    size_t maxStack = 1 << 20;        ///< Entries on the operator stack or on the operand stack
+    size_t maxTokenLength = 1 << 12;  ///< Characters in one number or variable name
+};
+
+//class BasicStreamEvaluator
+//Evaluates a single expression that arrives in chunks, cut anywhere (even
+//inside a token). Each chunk is translated as it is fed and only the
+//parser's stacks and the start of a token cut off at the end of a chunk
+//are kept, so memory depends on the limits, not on the length of the
+//input. Error positions are offsets in the whole input.
+template <class Policy>
+class BasicStreamEvaluator {
+public:
+    using value_type = typename Policy::value_type;
+
+    //Bytes read at a time by evalStream()
+    static constexpr size_t ReadSize = 64 << 10;
+
+private:
+    //Bytes of the next chunk joined to a token cut off by the last one
+    static constexpr size_t JoinSize = 256;
+
+    StreamLimits limits;
+    ValueSink<Policy> sink;
+    Translator<ValueSink<Policy>> translator{sink};
+    std::string carry;       ///< Token cut off at the end of the last chunk
+    size_t carryOffset = 0;  ///< Offset of carry in the whole input
+    size_t length = 0;       ///< Characters fed so far
+
+    //Translate the tokens of text, which starts at offset in the whole
+    //input; returns the length of the part translated. Unless last, a token
+    //reaching the end of text might continue and is left untranslated.
+    size_t lex(std::string_view text, size_t offset, bool last);
+
+    //Raise LimitExceeded at offset if the stacks outgrew the limits
+    void checkStacks(size_t offset) const;
+
+    //Raise LimitExceeded if the cut off token is too long already
+    void checkCarry() const;
+
+public:
+    explicit BasicStreamEvaluator(StreamLimits streamLimits = {}) : limits(streamLimits) {}
+
+    BasicStreamEvaluator(const BasicStreamEvaluator&) = delete;
+    BasicStreamEvaluator& operator=(const BasicStreamEvaluator&) = delete;
+
+    //Feed the next part of the expression. Syntax errors are raised as soon
+    //as they are seen; the evaluator can't be fed after an error.
+    void feed(std::string_view chunk);
+
+    //End of the expression: raise any remaining error or return its value
+    value_type finish();
+
+    //Characters fed so far
+    size_t size() const { return length; }
+
+    //Evaluate the whole content of a stream (throws std::ios_base::failure
+    //if reading fails)
+    static value_type evalStream(std::istream& in, StreamLimits limits = {});
+
+    //Evaluate the chunks returned by read() until it returns an empty one
+    template <class Read>
+    static value_type evalChunks(Read&& read, StreamLimits limits = {}) {
+        BasicStreamEvaluator evaluator(limits);
+        for (std::string_view chunk = read(); !chunk.empty(); chunk = read()) {
+            evaluator.feed(chunk);
+        }
+        return evaluator.finish();
+    }
+};
+
+//Stream evaluator of the default (32-bit int) evaluator
+using StreamEvaluator = BasicStreamEvaluator<Int32Policy>;
+
+//Translate the tokens of text
+
+template <class Policy>
+size_t BasicStreamEvaluator<Policy>::lex(std::string_view text, size_t offset, bool last) {
+    Lexer lexer(text);
+    for (Token token = lexer.next(); token.kind != TokenKind::End; token = lexer.next()) {
+        // More digits or name characters, or the second half of "&&", may follow
+        if (!last && token.offset + token.length >= text.size()) return token.offset;
+        if (token.length > limits.maxTokenLength) {
+            throw EvalError(ErrorKind::LimitExceeded, offset + token.offset);
+        }
+        translator.token(token, text.substr(token.offset, token.length), offset + token.offset);
+        checkStacks(offset + token.offset);
+    }
+    return text.size();
+}
+
+//Raise LimitExceeded if the stacks outgrew the limits
+
+template <class Policy>
+void BasicStreamEvaluator<Policy>::checkStacks(size_t offset) const {
+    if (translator.nesting() > limits.maxNesting || translator.pendingOperators() > limits.maxStack ||
+        sink.operands.size() > limits.maxStack) {
+        throw EvalError(ErrorKind::LimitExceeded, offset);
+    }
+}
+
+//Raise LimitExceeded if the cut off token is too long already
+
+template <class Policy>
+void BasicStreamEvaluator<Policy>::checkCarry() const {
+    // Only a number or a name can be cut off with this many characters
+    if (carry.size() > limits.maxTokenLength) {
+        throw EvalError(ErrorKind::LimitExceeded, carryOffset);
+    }
+}
+
+/**
+ * Feed the next part of the expression
+ * A token cut off by the last chunk is completed first: a little of the
+ * chunk at a time is appended to it until the lexer gets past it. The rest
+ * of the chunk is lexed where it lies, and whatever token reaches its end is
+ * copied aside for the next chunk.
+ */
+template <class Policy>
+void BasicStreamEvaluator<Policy>::feed(std::string_view chunk) {
+    size_t chunkOffset = length;
+    length += chunk.size();
+
+    while (!carry.empty() && !chunk.empty()) {
+        size_t carried = carry.size();
+        size_t joined = std::min(chunk.size(), JoinSize);
+        carry.append(chunk.substr(0, joined));
+        size_t used = lex(carry, carryOffset, false);
+        if (used >= carried) {
+            // Past the cut off token; the rest is lexed in the chunk itself
+            chunk.remove_prefix(used - carried);
+            chunkOffset += used - carried;
+            carry.clear();
+            break;
+        }
+        carry.erase(0, used);
+        carryOffset += used;
+        chunk.remove_prefix(joined);
+        chunkOffset += joined;
+        checkCarry();
+    }
+    if (!carry.empty()) return;
+
+    size_t used = lex(chunk, chunkOffset, false);
+    carry.assign(chunk.substr(used));
+    carryOffset = chunkOffset + used;
+    checkCarry();
+}
+
+//End of the expression
+
+template <class Policy>
+typename Policy::value_type BasicStreamEvaluator<Policy>::finish() {
+    if (!carry.empty()) {
+        lex(carry, carryOffset, true);
+        carry.clear();
+    }
+    translator.finish(length);
+    if (sink.fault != ErrorKind::None) {
+        throw EvalError(sink.fault, sink.faultAt);
+    }
+    return sink.operands.empty() ? 0 : sink.operands.top();
+}
+
+//Evaluate the whole content of a stream
+
+template <class Policy>
+typename Policy::value_type BasicStreamEvaluator<Policy>::evalStream(std::istream& in, StreamLimits limits) {
+    std::string buffer(ReadSize, '\0');
+    return evalChunks([&]() -> std::string_view {
+        if (!in.read(buffer.data(), buffer.size()) && in.bad()) {
+            throw std::ios_base::failure("Can't read the expression");
+        }
+        return {buffer.data(), static_cast<size_t>(in.gcount())};
+    }, limits);
+}
+
+// The standard policies are instantiated once, in StreamEvaluator.cpp
+#define EVALUATOR_EXTERN_STREAM(P) extern template class BasicStreamEvaluator<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_STREAM)
+#undef EVALUATOR_EXTERN_STREAM
+
+#endif // STREAM_EVALUATOR_H
\ No newline at end of file
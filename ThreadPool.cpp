@@ -0,0 +1,134 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+//Start the worker threads
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    threadCount = std::max<size_t>(threadCount, 1);
+    for (size_t i = 0; i < threadCount; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+//Stop the workers once every queued task has run
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+//Take a task: own deque first (newest), then steal from the others (oldest)
+
+bool ThreadPool::tryTake(size_t self, Task& task) {
+    size_t count = queues.size();
+
+    if (self < count) {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    for (size_t k = 1; k <= count; k++) {
+        Queue& victim = *queues[(self + k) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+//Execute a task and record its completion
+
+void ThreadPool::execute(const Task& task) {
+    Job& job = *task.job;
+    std::exception_ptr error;
+    try {
+        (*job.body)(task.begin, task.end);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // Finish under the lock: once remaining hits zero the waiting caller may
+    // destroy the job as soon as it can take the lock
+    std::lock_guard<std::mutex> guard(job.lock);
+    if (error && !job.error) job.error = error;
+    if (--job.remaining == 0) job.done.notify_all();
+}
+
+//Main loop of a worker thread
+
+void ThreadPool::workerLoop(size_t self) {
+    for (;;) {
+        Task task;
+        if (tryTake(self, task)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(sleepLock);
+        wake.wait(guard, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) return;
+    }
+}
+
+//Run body over [0, count) in parallel and wait for it
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+
+    Job job;
+    job.body = &body;
+    size_t tasks = (count + grain - 1) / grain;
+    job.remaining = tasks;
+
+    // Deal the ranges out round-robin; stealing evens out the rest
+    for (size_t t = 0; t < tasks; t++) {
+        Queue& queue = *queues[t % queues.size()];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.tasks.push_back({&job, t * grain, std::min(count, (t + 1) * grain)});
+        queued++;
+    }
+    {
+        // Taking the lock orders the push before any worker's sleep check
+        std::lock_guard<std::mutex> guard(sleepLock);
+    }
+    wake.notify_all();
+
+    // Help out until this job is finished
+    Task task;
+    while (job.remaining.load() > 0 && tryTake(queues.size(), task)) {
+        execute(task);
+    }
+    {
+        std::unique_lock<std::mutex> guard(job.lock);
+        job.done.wait(guard, [&job] { return job.remaining.load() == 0; });
+    }
+
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+//Process-wide pool with one worker per hardware thread
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//class ThreadPool
+//Fixed set of worker threads with one task deque each. A worker takes its
+//newest task first and, when its own deque runs dry, steals the oldest task
+//from another worker, so uneven batches still keep every core busy.
+class ThreadPool {
+private:
+    //Bookkeeping shared by the tasks of one parallelFor call
+    struct Job {
+        const std::function<void(size_t, size_t)>* body;
+        std::atomic<size_t> remaining{0};   ///< Tasks not finished yet
+        std::exception_ptr error;           ///< First exception thrown by a task
+        std::mutex lock;
+        std::condition_variable done;
+    };
+
+    //A range of the iteration space
+    struct Task {
+        Job* job = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    //Per-worker task deque
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;  ///< One per worker
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};               ///< Tasks waiting in any deque
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    //Take a task: own deque first (newest), then steal from the others (oldest)
+    bool tryTake(size_t self, Task& task);
+
+    //Execute a task and record its completion
+    static void execute(const Task& task);
+
+    //Main loop of a worker thread
+    void workerLoop(size_t self);
+
+public:
+    //Start threadCount workers (at least one)
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //Number of worker threads
+    size_t size() const { return workers.size(); }
+
+    //Call body(begin, end) over [0, count) in ranges of at most grain items and
+    //wait for all of them. The calling thread helps by stealing work; the
+    //first exception thrown by body is rethrown here.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    //Process-wide pool with one worker per hardware thread
+    static ThreadPool& shared();
+};
+
+#endif // THREAD_POOL_H
\ No newline at end of file
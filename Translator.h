@@ -0,0 +1,286 @@
+#ifndef TRANSLATOR_H
+#define TRANSLATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "Lexer.h"
+#include "EvalError.h"
+#include "SmallStack.h"
+
+//An operator waiting on the translator's operator stack
+struct PendingOp {
+    Op op;          ///< Operator (or Op::LeftParen for a grouping marker)
+    size_t offset;  ///< Source offset of the operator
+};
+
+//The translator feeds a Sink, which must provide:
+//  ErrorKind operand(std::string_view digits, size_t offset)  a literal (returns why it can't be represented, or None)
+//  void variable(std::string_view name, size_t offset)        a variable reference
+//  void apply(Op op, size_t offset)                           an operator, once its operands were fed
+//  void shortCircuit(Op op, size_t offset)                    the left operand of && / || is complete
+
+/**
+ * Validate and translate an infix expression into postfix order in one pass
+ * Algorithm (Shunting Yard):
+ * 1. Scan the tokens left to right, checking the syntax as they arrive
+ * 2. For operands: hand them to the sink
+ * 3. For operators: reduce stacked operators of higher or equal precedence, then stack it
+ * 4. For parentheses: reduce everything back to the matching opening parenthesis
+ * 5. Reduce any remaining operators
+ * Prefix operators are stacked in their unary form (Op::Plus, Op::Negate, ...)
+ * so they are never confused with the binary operators sharing their spelling.
+ *
+ * Errors are reported exactly like the former separate validation scan: a
+ * problem only the translation notices (such as a missing operand) is held
+ * back until the whole input has been scanned, so any syntax error found
+ * later in the text still takes priority.
+ *
+ * Tokens are pushed in one at a time, so the input never has to be in
+ * memory as a whole (see StreamEvaluator.h); translate() drives it over a
+ * string_view.
+ */
+template <class Sink>
+class Translator {
+private:
+    Sink& sink;
+    SmallStack<PendingOp, 32> operators;
+    size_t depth = 0;            // Number of operands the sink holds
+    bool expectOperand = true;   // Flag to distinguish unary vs binary operators
+    bool sawToken = false;
+
+    // State tracking variables for syntax validation
+    bool lastWasOperator = false;   // Track if previous token was operator
+    bool lastWasOperand = false;    // Track if previous token was operand
+    size_t parenCount = 0;          // Track parentheses balance
+
+    // First structural error; once set the sink is no longer fed
+    ErrorKind deferred = ErrorKind::None;
+    size_t deferredAt = 0;
+
+    constexpr void defer(ErrorKind kind, size_t at) {
+        deferred = kind;
+        deferredAt = at;
+    }
+
+    //Reduce stacked operators binding at least as tightly as minPrecedence;
+    //grouping markers have precedence 0 and stop the unwinding
+    constexpr void unwind(int minPrecedence) {
+        while (!operators.empty() && opInfo(operators.top().op).precedence >= minPrecedence) {
+            PendingOp pending = operators.top();
+            uint8_t arity = opInfo(pending.op).arity;
+            // Make sure the sink never reads past the bottom of its operand stack
+            if (depth < arity) {
+                defer(ErrorKind::MissingOperand, pending.offset);
+                return;
+            }
+            operators.pop();
+            sink.apply(pending.op, pending.offset);
+            depth -= arity - 1;
+        }
+    }
+
+public:
+    constexpr explicit Translator(Sink& target) : sink(target) {}
+
+    //Take the next token; text is its source text and offset where it
+    //starts in the whole input
+    constexpr void token(const Token& token, std::string_view text, size_t offset);
+
+    //End of the input, length characters in all
+    constexpr void finish(size_t length);
+
+    //Parentheses currently open
+    constexpr size_t nesting() const { return parenCount; }
+
+    //Operators waiting on the operator stack
+    constexpr size_t pendingOperators() const { return operators.size(); }
+};
+
+//Take the next token
+
+template <class Sink>
+constexpr void Translator<Sink>::token(const Token& token, std::string_view text, size_t offset) {
+    bool first = !sawToken;
+    sawToken = true;
+
+    switch (token.kind) {
+    case TokenKind::Number:
+    case TokenKind::Identifier:
+        // Check for two operands in a row (missing operator)
+        if (lastWasOperand) {
+            throw EvalError(ErrorKind::TwoOperands, offset);
+        }
+        lastWasOperator = false;
+        lastWasOperand = true;
+
+        if (deferred != ErrorKind::None) break;
+        if (token.kind == TokenKind::Number) {
+            // A literal the sink's numeric type can't hold is reported like a syntax error
+            ErrorKind error = sink.operand(text, offset);
+            if (error != ErrorKind::None) {
+                defer(error, offset);
+                break;
+            }
+        } else {
+            sink.variable(text, offset);
+        }
+        depth++;
+        expectOperand = false;  // Next operator should be binary
+        break;
+
+    case TokenKind::LeftParen:
+        parenCount++;              // Increment parentheses counter
+        lastWasOperator = false;   // Reset state flags
+        lastWasOperand = false;
+
+        if (deferred != ErrorKind::None) break;
+        if (!expectOperand) {
+            defer(ErrorKind::TwoOperands, offset);
+            break;
+        }
+        operators.push({Op::LeftParen, offset});
+        break;  // Still expecting an operand
+
+    case TokenKind::RightParen:
+        // Check for invalid starting characters
+        if (offset == 0) {
+            throw EvalError(ErrorKind::LeadingCloseParen, 0);
+        }
+        // Check for too many closing parentheses
+        if (parenCount == 0) {
+            throw EvalError(ErrorKind::MismatchedParentheses, offset);
+        }
+        parenCount--;              // Decrement parentheses counter
+        lastWasOperator = false;   // Closing paren acts like an operand
+        lastWasOperand = true;
+
+        if (deferred != ErrorKind::None) break;
+        if (expectOperand) {
+            defer(ErrorKind::MissingOperand, offset);
+            break;
+        }
+        unwind(1);
+        if (deferred == ErrorKind::None) {
+            operators.pop();  // Remove the "("
+        }
+        break;
+
+    case TokenKind::Operator: {
+        const OpInfo& info = opInfo(token.op);
+
+        // Quick check for binary operators at start
+        if (first && info.prefix == Op::Count) {
+            throw EvalError(ErrorKind::LeadingBinaryOperator, 0);
+        }
+        // Check for two binary operators in a row
+        if (lastWasOperator && info.prefix == Op::Count) {
+            throw EvalError(ErrorKind::TwoBinaryOperators, offset);
+        }
+        lastWasOperator = true;
+        lastWasOperand = false;
+
+        if (deferred != ErrorKind::None) break;
+
+        if (expectOperand) {
+            // Prefix operators bind to the operand that follows them
+            if (info.prefix == Op::Count) {
+                defer(ErrorKind::MissingOperand, offset);
+                break;
+            }
+            operators.push({info.prefix, offset});
+            break;
+        }
+
+        if (info.infix == Op::Count) {
+            defer(ErrorKind::ExpectedBinaryOperator, offset);
+            break;
+        }
+        unwind(opInfo(info.infix).precedence);
+        if (deferred != ErrorKind::None) break;
+
+        // The left operand of && and || is complete at this point
+        if (info.infix == Op::And || info.infix == Op::Or) {
+            sink.shortCircuit(info.infix, offset);
+        }
+        operators.push({info.infix, offset});
+
+        // After an operand "++" and "--" are a binary operator followed by a prefix one
+        if (info.arity == 1) {
+            operators.push({opInfo(info.infix).prefix, offset + 1});
+        }
+        expectOperand = true;   // After binary operator, expect operand
+        break;
+    }
+
+    default:
+        // A lone '&' or '|' passes the operator checks like any binary
+        // operator and is then rejected once the scan is complete
+        if (text[0] == '&' || text[0] == '|') {
+            if (first) {
+                throw EvalError(ErrorKind::LeadingBinaryOperator, 0);
+            }
+            if (lastWasOperator) {
+                throw EvalError(ErrorKind::TwoBinaryOperators, offset);
+            }
+            lastWasOperator = true;
+            lastWasOperand = false;
+            if (deferred == ErrorKind::None) {
+                defer(ErrorKind::InvalidCharacter, offset);
+            }
+            break;
+        }
+
+        // Invalid character found
+        throw EvalError(ErrorKind::InvalidCharacter, offset);
+    }
+}
+
+//End of the input
+
+template <class Sink>
+constexpr void Translator<Sink>::finish(size_t length) {
+    // Check for empty expression
+    if (length == 0) {
+        throw EvalError(ErrorKind::EmptyExpression);
+    }
+
+    // Check for unmatched parentheses at the end
+    if (parenCount != 0) {
+        throw EvalError(ErrorKind::MismatchedParentheses);
+    }
+
+    if (deferred == ErrorKind::None && expectOperand && sawToken) {
+        defer(ErrorKind::MissingOperand, length);
+    }
+    if (deferred == ErrorKind::None) {
+        unwind(1);
+    }
+    if (deferred != ErrorKind::None) {
+        throw EvalError(deferred, deferredAt);
+    }
+}
+
+/**
+ * Validate and translate an expression held in memory
+ * Token offsets and the offsets handed to the sink are size_t, so eval()
+ * reports exact positions in expressions past 4 GiB. Compiled programs keep
+ * 32-bit positions (Instruction::position): compile() accepts such long
+ * expressions, but error positions beyond 4 GiB come back truncated.
+ */
+template <class Sink>
+constexpr void translate(std::string_view expression, Sink& sink) {
+    // Check for empty expression
+    if (expression.empty()) {
+        throw EvalError(ErrorKind::EmptyExpression);
+    }
+
+    Translator<Sink> translator(sink);
+    Lexer lexer(expression);
+    for (Token token = lexer.next(); token.kind != TokenKind::End; token = lexer.next()) {
+        translator.token(token, expression.substr(token.offset, token.length), token.offset);
+    }
+    translator.finish(expression.length());
+}
+
+#endif // TRANSLATOR_H
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include "Workbook.h"
+
+//The workbooks of the standard numeric policies are instantiated here once
+//rather than in every file that uses them
+
+#define EVALUATOR_INSTANTIATE_WORKBOOK(P) template class BasicWorkbook<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_INSTANTIATE_WORKBOOK)
+#undef EVALUATOR_INSTANTIATE_WORKBOOK
\ No newline at end of file
@@ -0,0 +1,443 @@
+#ifndef WORKBOOK_H
+#define WORKBOOK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "CompiledExpression.h"
+#include "EvalError.h"
+#include "Evaluator.h"
+#include "NumericPolicy.h"
+#include "ThreadPool.h"
+
+//class BasicWorkbook
+//A set of named cells: inputs holding a value, and formulas (expressions)
+//whose variables name other cells, e.g.
+//  book.define("risk", "exposure * 3 > limit && active");
+//  book.set("exposure", 120);
+//Formulas are compiled once and form a dependency graph; a change only
+//recomputes the formulas downstream of it, in topological order, and stops
+//early wherever a recomputed formula keeps its value. Formulas on the same
+//level of the graph don't depend on each other and are evaluated in
+//parallel when a thread pool is given.
+//
+//A formula fails when evaluating it fails (division by zero, ...), when it
+//names a cell that is neither an input nor a formula (UnknownVariable), or
+//when one of the cells it names has failed; the error is then passed on
+//unchanged, even if a && / || wouldn't have needed that cell.
+//Not safe to modify from several threads at once.
+template <class Policy>
+class BasicWorkbook {
+public:
+    using value_type = typename Policy::value_type;
+    using Compiled = BasicCompiledExpression<Policy>;
+    using Result = BasicEvalResult<value_type>;
+
+    //A new value for an input
+    struct Assignment {
+        std::string_view name;
+        value_type value;
+    };
+
+    //Counters of the work done
+    struct Stats {
+        uint64_t updates = 0;       ///< Calls that changed something
+        uint64_t evaluations = 0;   ///< Formulas computed over all updates
+        uint64_t lastEvaluations = 0;  ///< Formulas computed by the last update
+    };
+
+    //Smallest level of the graph worth evaluating on the thread pool
+    static constexpr size_t ParallelLevelSize = 64;
+
+private:
+    enum class CellKind : uint8_t { Undefined, Input, Formula };
+
+    struct Cell {
+        std::string name;
+        CellKind kind = CellKind::Undefined;
+        bool queued = false;         ///< Waiting in a level bucket
+        bool changed = false;        ///< Value or error changed by the last computation
+        uint32_t level = 0;          ///< 0 for inputs, else 1 + the highest level of its inputs (at least 1)
+        uint32_t visit = 0;          ///< Generation mark of graph walks
+        value_type value = 0;
+        ErrorKind error = ErrorKind::UnknownVariable;  ///< Undefined cells can't be used
+        size_t errorPosition = EvalError::npos;        ///< Position within the formula of errorCell
+        int errorCell = -1;                            ///< Formula that raised error
+        Compiled compiled;
+        std::vector<int> inputs;      ///< Cell of each of compiled.variables()
+        std::vector<value_type> arguments;  ///< Values of inputs, rebuilt by every computation
+        std::vector<int> dependents;  ///< Formulas naming this cell
+    };
+
+    BasicEvaluator<Policy> evaluator;
+    ThreadPool* pool;
+    std::deque<Cell> cells;                           ///< Never moves, so names can key the index
+    std::unordered_map<std::string_view, int> index;  ///< Name (owned by the cell) -> cell
+    std::vector<std::vector<int>> pending;            ///< Queued cells per level
+    size_t pendingCount = 0;
+    uint32_t generation = 0;
+    Stats counters;
+
+    //The cell called name, created as Undefined if there is none
+    int cellFor(std::string_view name);
+
+    //The cell called name; throws UnknownVariable if there is none
+    const Cell& find(std::string_view name) const;
+
+    //Source offset where a program first reads its variable-th variable
+    static size_t variablePosition(const Compiled& compiled, size_t variable);
+
+    //Turn a cell into an input or undefined cell that depends on nothing
+    void detach(int id);
+
+    //Recompute the level of a cell and of everything downstream of it
+    void relevel(int id);
+
+    //Queue a cell for recomputation
+    void schedule(int id);
+
+    //Compute a formula from its inputs and note whether the outcome changed
+    void compute(int id);
+
+    //Recompute every queued cell and what depends on the ones that changed
+    void recalculate();
+
+public:
+    //Formulas on a level of ParallelLevelSize or more are spread over pool
+    explicit BasicWorkbook(ThreadPool* threadPool = nullptr) : pool(threadPool) {}
+
+    BasicWorkbook(const BasicWorkbook&) = delete;
+    BasicWorkbook& operator=(const BasicWorkbook&) = delete;
+
+    //Make name a formula, replacing any value or formula it had, and bring
+    //everything that depends on it up to date. A syntax error, or a formula
+    //that would depend on itself (CircularReference, positioned at the
+    //variable that closes the cycle), throws and leaves the workbook unchanged.
+    void define(std::string_view name, std::string_view expr);
+
+    //Make name an input holding value and bring everything that depends on it up to date
+    void set(std::string_view name, value_type value);
+
+    //Set several inputs at once; shared downstream formulas are computed only once
+    void set(std::span<const Assignment> values);
+
+    //Current value of a cell; throws the error of a failed cell (positioned
+    //within the formula that raised it) or UnknownVariable for an unknown name
+    value_type value(std::string_view name) const;
+
+    //Current value of a cell, with any error reported in the result
+    Result result(std::string_view name) const;
+
+    //Whether name is an input or a formula
+    bool contains(std::string_view name) const;
+
+    //Number of inputs and formulas
+    size_t size() const;
+
+    //Counters of the work done so far
+    const Stats& stats() const { return counters; }
+};
+
+//Workbook of the default (32-bit int) evaluator
+using Workbook = BasicWorkbook<Int32Policy>;
+
+//The cell called name, created as Undefined if there is none
+
+template <class Policy>
+int BasicWorkbook<Policy>::cellFor(std::string_view name) {
+    auto found = index.find(name);
+    if (found != index.end()) return found->second;
+
+    Cell& cell = cells.emplace_back();
+    cell.name = name;
+    int id = static_cast<int>(cells.size() - 1);
+    cell.errorCell = id;
+    index.emplace(cell.name, id);
+    return id;
+}
+
+//The cell called name
+
+template <class Policy>
+const typename BasicWorkbook<Policy>::Cell& BasicWorkbook<Policy>::find(std::string_view name) const {
+    auto found = index.find(name);
+    if (found == index.end() || cells[found->second].kind == CellKind::Undefined) {
+        throw EvalError(ErrorKind::UnknownVariable);
+    }
+    return cells[found->second];
+}
+
+//Source offset where a formula first reads a variable
+
+template <class Policy>
+size_t BasicWorkbook<Policy>::variablePosition(const Compiled& compiled, size_t variable) {
+    for (const Instruction& ins : compiled.instructions()) {
+        if (ins.code == OpCode::Load && static_cast<size_t>(ins.value) == variable) return ins.position;
+    }
+    return EvalError::npos;
+}
+
+//Drop the formula of a cell
+
+template <class Policy>
+void BasicWorkbook<Policy>::detach(int id) {
+    Cell& cell = cells[id];
+    for (int input : cell.inputs) {
+        std::vector<int>& users = cells[input].dependents;
+        users.erase(std::find(users.begin(), users.end(), id));
+    }
+    cell.inputs.clear();
+    cell.arguments.clear();
+    cell.compiled = Compiled();
+    cell.kind = CellKind::Undefined;
+}
+
+//Recompute the level of a cell and of everything downstream of it
+
+template <class Policy>
+void BasicWorkbook<Policy>::relevel(int id) {
+    std::vector<int> work{id};
+    while (!work.empty()) {
+        Cell& cell = cells[work.back()];
+        work.pop_back();
+
+        uint32_t level = cell.kind == CellKind::Formula ? 1 : 0;
+        for (int input : cell.inputs) level = std::max(level, cells[input].level + 1);
+        // Unchanged levels leave the cells below as they are
+        if (level == cell.level && &cell != &cells[id]) continue;
+        cell.level = level;
+        work.insert(work.end(), cell.dependents.begin(), cell.dependents.end());
+    }
+}
+
+//Queue a cell for recomputation
+
+template <class Policy>
+void BasicWorkbook<Policy>::schedule(int id) {
+    Cell& cell = cells[id];
+    if (cell.queued) return;
+    cell.queued = true;
+    if (pending.size() <= cell.level) pending.resize(cell.level + 1);
+    pending[cell.level].push_back(id);
+    pendingCount++;
+}
+
+//Compute a formula from its inputs
+
+template <class Policy>
+void BasicWorkbook<Policy>::compute(int id) {
+    Cell& cell = cells[id];
+    value_type value = 0;
+    ErrorKind error = ErrorKind::None;
+    size_t position = EvalError::npos;
+    int origin = id;
+
+    for (size_t i = 0; i < cell.inputs.size(); i++) {
+        const Cell& input = cells[cell.inputs[i]];
+        if (input.error == ErrorKind::None) {
+            cell.arguments[i] = input.value;
+        } else if (input.kind == CellKind::Undefined) {
+            error = ErrorKind::UnknownVariable;
+            position = variablePosition(cell.compiled, i);
+            break;
+        } else {
+            error = input.error;
+            position = input.errorPosition;
+            origin = input.errorCell;
+            break;
+        }
+    }
+    if (error == ErrorKind::None) {
+        try {
+            value = cell.compiled.run(cell.arguments);
+        } catch (const EvalError& e) {
+            error = e.kind();
+            position = e.position();
+        }
+    }
+
+    cell.changed = value != cell.value || error != cell.error || position != cell.errorPosition ||
+                   origin != cell.errorCell;
+    cell.value = value;
+    cell.error = error;
+    cell.errorPosition = position;
+    cell.errorCell = origin;
+}
+
+//Recompute every queued cell and what depends on the ones that changed
+
+template <class Policy>
+void BasicWorkbook<Policy>::recalculate() {
+    uint64_t evaluations = 0;
+
+    // A cell only depends on lower levels, so once a level is done nothing
+    // queues more work on it. The batch is moved out while it is processed
+    // since queueing dependents can grow the levels
+    std::vector<int> batch;
+    for (size_t level = 0; pendingCount > 0; level++) {
+        if (pending[level].empty()) continue;
+        batch.swap(pending[level]);
+
+        if (level > 0) {
+            if (pool && batch.size() >= ParallelLevelSize) {
+                pool->parallelFor(batch.size(), ParallelLevelSize / 4, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) compute(batch[i]);
+                });
+            } else {
+                for (int id : batch) compute(id);
+            }
+            evaluations += batch.size();
+        }
+
+        for (int id : batch) {
+            Cell& cell = cells[id];
+            cell.queued = false;
+            // Inputs and undefined cells are only queued when they changed
+            if (level == 0 || cell.changed) {
+                for (int dependent : cell.dependents) schedule(dependent);
+            }
+        }
+        pendingCount -= batch.size();
+        batch.clear();
+        batch.swap(pending[level]);
+    }
+
+    counters.updates++;
+    counters.evaluations += evaluations;
+    counters.lastEvaluations = evaluations;
+}
+
+//Make a cell a formula
+
+template <class Policy>
+void BasicWorkbook<Policy>::define(std::string_view name, std::string_view expr) {
+    Compiled compiled = evaluator.compile(expr);
+    int id = cellFor(name);
+
+    // Resolve the variables; a cycle exists if one of them is the cell
+    // itself or lies downstream of it
+    std::vector<int> inputs;
+    inputs.reserve(compiled.variables().size());
+    for (const std::string& variable : compiled.variables()) inputs.push_back(cellFor(variable));
+
+    generation++;
+    std::vector<int> work{id};
+    cells[id].visit = generation;
+    while (!work.empty()) {
+        const Cell& cell = cells[work.back()];
+        work.pop_back();
+        for (int dependent : cell.dependents) {
+            if (cells[dependent].visit != generation) {
+                cells[dependent].visit = generation;
+                work.push_back(dependent);
+            }
+        }
+    }
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (cells[inputs[i]].visit == generation) {
+            // Cells created for the variables stay behind as Undefined, like
+            // any other name that is only referenced
+            throw EvalError(ErrorKind::CircularReference, variablePosition(compiled, i));
+        }
+    }
+
+    detach(id);
+    Cell& cell = cells[id];
+    cell.kind = CellKind::Formula;
+    cell.compiled = std::move(compiled);
+    cell.inputs = std::move(inputs);
+    cell.arguments.assign(cell.inputs.size(), 0);
+    for (int input : cell.inputs) cells[input].dependents.push_back(id);
+    relevel(id);
+
+    schedule(id);
+    recalculate();
+}
+
+//Make a cell an input
+
+template <class Policy>
+void BasicWorkbook<Policy>::set(std::string_view name, value_type value) {
+    Assignment assignment{name, value};
+    set(std::span<const Assignment>(&assignment, 1));
+}
+
+//Set several inputs at once
+
+template <class Policy>
+void BasicWorkbook<Policy>::set(std::span<const Assignment> values) {
+    for (const Assignment& assignment : values) {
+        int id = cellFor(assignment.name);
+        Cell& cell = cells[id];
+        if (cell.kind == CellKind::Input && cell.error == ErrorKind::None && cell.value == assignment.value) {
+            continue;
+        }
+        if (cell.kind == CellKind::Formula) {
+            detach(id);
+            relevel(id);
+        }
+        cell.kind = CellKind::Input;
+        cell.value = assignment.value;
+        cell.error = ErrorKind::None;
+        cell.errorPosition = EvalError::npos;
+        cell.errorCell = id;
+        schedule(id);
+    }
+    if (pendingCount > 0) recalculate();
+}
+
+//Current value of a cell
+
+template <class Policy>
+typename Policy::value_type BasicWorkbook<Policy>::value(std::string_view name) const {
+    const Cell& cell = find(name);
+    if (cell.error != ErrorKind::None) throw EvalError(cell.error, cell.errorPosition);
+    return cell.value;
+}
+
+//Current value of a cell, with any error reported in the result
+
+template <class Policy>
+typename BasicWorkbook<Policy>::Result BasicWorkbook<Policy>::result(std::string_view name) const {
+    Result outcome;
+    auto found = index.find(name);
+    if (found == index.end() || cells[found->second].kind == CellKind::Undefined) {
+        outcome.error = ErrorKind::UnknownVariable;
+    } else {
+        const Cell& cell = cells[found->second];
+        outcome.value = cell.value;
+        outcome.error = cell.error;
+        outcome.position = cell.errorPosition;
+    }
+    if (!outcome.ok()) outcome.message = EvalError(outcome.error, outcome.position).what();
+    return outcome;
+}
+
+//Whether name is an input or a formula
+
+template <class Policy>
+bool BasicWorkbook<Policy>::contains(std::string_view name) const {
+    auto found = index.find(name);
+    return found != index.end() && cells[found->second].kind != CellKind::Undefined;
+}
+
+//Number of inputs and formulas
+
+template <class Policy>
+size_t BasicWorkbook<Policy>::size() const {
+    return static_cast<size_t>(std::count_if(cells.begin(), cells.end(),
+                                              [](const Cell& cell) { return cell.kind != CellKind::Undefined; }));
+}
+
+// The standard policies are instantiated once, in Workbook.cpp
+#define EVALUATOR_EXTERN_WORKBOOK(P) extern template class BasicWorkbook<P>;
+EVALUATOR_STANDARD_POLICIES(EVALUATOR_EXTERN_WORKBOOK)
+#undef EVALUATOR_EXTERN_WORKBOOK
+
+#endif // WORKBOOK_H
\ No newline at end of file
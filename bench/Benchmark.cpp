@@ -0,0 +1,379 @@
+/**
+ * Benchmark suite for the expression evaluator
+ * Generates deterministic corpora (see Corpus.h), measures every evaluation
+ * path on them and writes the results as JSON. Build it next to the library
+ * sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread bench/Benchmark.cpp AdaptiveExpression.cpp CompiledExpression.cpp \
+ *       EvalError.cpp Evaluator.cpp ExpressionCache.cpp Instrumentation.cpp ThreadPool.cpp -o benchmark
+ *
+ * Usage: benchmark [--out FILE] [--compare BASELINE] [--threshold PERCENT]
+ *                  [--filter TEXT] [--min-time SECONDS]
+ * With --compare, results are checked against a JSON file written by an
+ * earlier run: a benchmark more than PERCENT (default 10) slower, or that
+ * allocates more per expression, is reported and the exit status is 1.
+ */
+
+#include "../AdaptiveExpression.h"
+#include "../Evaluator.h"
+#include "Corpus.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Every heap allocation in the process is counted, so each benchmark can
+//report what one evaluation allocates
+static std::atomic<uint64_t> allocationCount{0};
+static std::atomic<uint64_t> allocatedBytes{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+// GCC can't tell these free() the memory the replaced operator new malloc()ed
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+#pragma GCC diagnostic pop
+
+//Keep the compiler from discarding a result nobody reads
+template <class T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+//Result of one benchmark
+struct Measurement {
+    std::string name;
+    size_t expressions = 0;
+    double bytesPerExpr = 0;        ///< Average expression length
+    double nsPerExpr = 0;           ///< Median over the timed rounds
+    double mbPerSec = 0;            ///< Expression text processed per second
+    double allocsPerExpr = 0;       ///< Heap allocations per expression
+    double allocBytesPerExpr = 0;   ///< Heap bytes allocated per expression
+};
+
+//Options from the command line
+struct BenchOptions {
+    std::string out;              ///< JSON output file (stdout when empty)
+    std::string compare;          ///< Baseline JSON to compare against
+    double threshold = 10;        ///< Allowed slowdown in percent
+    std::string filter;           ///< Only run benchmarks whose name contains this
+    double minSeconds = 0.2;      ///< Timed work per benchmark
+};
+
+/**
+ * Run body(i) over every expression of a corpus and measure it
+ * One untimed pass warms up caches and branch predictors, a second one
+ * counts allocations, then rounds over the whole corpus are timed until
+ * minSeconds have passed; the median round is reported.
+ */
+template <class Body>
+Measurement measure(const std::string& name, const Corpus& corpus, double minSeconds, Body body) {
+    using Clock = std::chrono::steady_clock;
+    size_t n = corpus.expressions.size();
+
+    Measurement m;
+    m.name = name;
+    m.expressions = n;
+    m.bytesPerExpr = corpus.averageLength();
+
+    for (size_t i = 0; i < n; i++) body(i);
+
+    uint64_t countBefore = allocationCount.load();
+    uint64_t bytesBefore = allocatedBytes.load();
+    for (size_t i = 0; i < n; i++) body(i);
+    m.allocsPerExpr = double(allocationCount.load() - countBefore) / n;
+    m.allocBytesPerExpr = double(allocatedBytes.load() - bytesBefore) / n;
+
+    std::vector<double> rounds;
+    Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                                    std::chrono::duration<double>(minSeconds));
+    do {
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < n; i++) body(i);
+        rounds.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n);
+    } while (Clock::now() < deadline || rounds.size() < 3);
+
+    std::nth_element(rounds.begin(), rounds.begin() + rounds.size() / 2, rounds.end());
+    m.nsPerExpr = rounds[rounds.size() / 2];
+    m.mbPerSec = m.bytesPerExpr / m.nsPerExpr * 1e3;  // bytes per ns = GB/s
+    return m;
+}
+
+//Expressions per corpus: about 1 MB of text, within sensible bounds
+static size_t corpusSize(size_t approximateLength) {
+    return std::clamp<size_t>((1 << 20) / std::max<size_t>(approximateLength, 1), 64, 10000);
+}
+
+//Generate every corpus; the seeds are fixed so runs are comparable
+static std::vector<Corpus> generateCorpora() {
+    std::vector<Corpus> corpora;
+    corpora.push_back(shortArithmetic(10000, 1));
+    for (size_t operands : {4, 16, 64, 256, 1024}) {
+        corpora.push_back(flatChain(corpusSize(operands * 4), operands, 2 + operands));
+    }
+    for (size_t depth : {8, 64, 512}) {
+        corpora.push_back(nestedParentheses(corpusSize(depth * 5), depth, 3 + depth));
+    }
+    corpora.push_back(unaryChains(10000, 4));
+    corpora.push_back(booleanRules(10000, 5));
+    corpora.push_back(formattedCode(corpusSize(300), 6));
+    return corpora;
+}
+
+//Run every benchmark whose name matches the filter
+static std::vector<Measurement> runBenchmarks(const BenchOptions& options) {
+    std::vector<Measurement> results;
+    Evaluator evaluator;
+
+    auto wanted = [&](const std::string& name) {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    };
+    auto report = [&](Measurement m) {
+        std::fprintf(stderr, "%-24s %10.1f ns/expr %9.1f MB/s %7.2f allocs/expr %9.1f B/expr\n",
+                     m.name.c_str(), m.nsPerExpr, m.mbPerSec, m.allocsPerExpr, m.allocBytesPerExpr);
+        results.push_back(std::move(m));
+    };
+
+    for (const Corpus& corpus : generateCorpora()) {
+        // Split into tokens only
+        std::string name = "lex/" + corpus.name;
+        if (wanted(name)) {
+            report(measure(name, corpus, options.minSeconds, [&](size_t i) {
+                Lexer lexer(corpus.views[i]);
+                size_t tokens = 0;
+                while (lexer.next().kind != TokenKind::End) tokens++;
+                keep(tokens);
+            }));
+        }
+
+        // Parse and evaluate in one pass
+        name = "eval/" + corpus.name;
+        if (wanted(name)) {
+            report(measure(name, corpus, options.minSeconds, [&](size_t i) {
+                keep(evaluator.eval(corpus.views[i]));
+            }));
+        }
+
+        // Build the optimized program
+        name = "compile/" + corpus.name;
+        if (wanted(name)) {
+            report(measure(name, corpus, options.minSeconds, [&](size_t i) {
+                keep(evaluator.compile(corpus.views[i]));
+            }));
+        }
+
+        // Execute programs compiled ahead of time
+        name = "run/" + corpus.name;
+        if (wanted(name)) {
+            std::vector<CompiledExpression> programs;
+            for (std::string_view e : corpus.views) programs.push_back(evaluator.compile(e));
+            report(measure(name, corpus, options.minSeconds, [&](size_t i) {
+                keep(programs[i].run());
+            }));
+        }
+
+        // Evaluate through a warm expression cache large enough for the corpus
+        name = "cached/" + corpus.name;
+        if (wanted(name)) {
+            Evaluator cached(std::make_shared<ExpressionCache>(corpus.expressions.size() * 2));
+            report(measure(name, corpus, options.minSeconds, [&](size_t i) {
+                keep(cached.eval(corpus.views[i]));
+            }));
+        }
+    }
+
+    // A few rules run over many rows of variables, as written and adaptively
+    if (wanted("run/skewed") || wanted("adaptive/skewed")) {
+        constexpr size_t RuleCount = 16;
+        Corpus rules = skewedRules(RuleCount, 8);
+        Corpus rows;
+        rows.name = "skewed";
+        for (size_t i = 0; i < 10000; i++) rows.add(rules.expressions[i % RuleCount]);
+        rows.finish();
+
+        // Row i binds the variables of rule i % RuleCount, in its variables() order
+        std::vector<CompiledExpression> programs;
+        std::vector<AdaptiveExpression> adaptive;
+        for (std::string_view rule : rules.views) {
+            programs.push_back(evaluator.compile(rule));
+            adaptive.emplace_back(rule);
+        }
+        CorpusRandom random(9);
+        std::vector<std::vector<int32_t>> bound(rows.expressions.size());
+        for (size_t i = 0; i < bound.size(); i++) {
+            int32_t values[5];
+            for (int32_t& value : values) value = static_cast<int32_t>(random.below(100));
+            for (const std::string& name : programs[i % RuleCount].variables()) {
+                bound[i].push_back(values[name[0] - 'a']);
+            }
+        }
+
+        if (wanted("run/skewed")) {
+            report(measure("run/skewed", rows, options.minSeconds, [&](size_t i) {
+                keep(programs[i % RuleCount].run(bound[i]));
+            }));
+        }
+        if (wanted("adaptive/skewed")) {
+            report(measure("adaptive/skewed", rows, options.minSeconds, [&](size_t i) {
+                keep(adaptive[i % RuleCount].run(bound[i]));
+            }));
+        }
+    }
+    return results;
+}
+
+//Write results as JSON
+static void writeJson(std::ostream& out, const std::vector<Measurement>& results) {
+    out << "{\n  \"version\": 1,\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Measurement& m = results[i];
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "    {\"name\": \"%s\", \"expressions\": %zu, \"bytes_per_expr\": %.2f, "
+                      "\"ns_per_expr\": %.2f, \"mb_per_sec\": %.2f, \"allocs_per_expr\": %.3f, "
+                      "\"alloc_bytes_per_expr\": %.1f}%s\n",
+                      m.name.c_str(), m.expressions, m.bytesPerExpr, m.nsPerExpr, m.mbPerSec,
+                      m.allocsPerExpr, m.allocBytesPerExpr, i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+//Value of a key in a flat JSON object written by writeJson()
+static std::string jsonField(std::string_view object, std::string_view key) {
+    std::string quoted = "\"" + std::string(key) + "\"";
+    size_t at = object.find(quoted);
+    if (at == std::string_view::npos) return "";
+    at = object.find(':', at + quoted.size());
+    if (at == std::string_view::npos) return "";
+    at = object.find_first_not_of(" \t\r\n", at + 1);
+    if (at == std::string_view::npos) return "";
+    if (object[at] == '"') {
+        size_t end = object.find('"', at + 1);
+        return std::string(object.substr(at + 1, end - at - 1));
+    }
+    size_t end = object.find_first_of(",} \t\r\n", at);
+    return std::string(object.substr(at, end - at));
+}
+
+//Read the benchmarks of a JSON file written by writeJson()
+static std::map<std::string, Measurement> readBaseline(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("Can't open baseline " + path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string json = contents.str();
+
+    std::map<std::string, Measurement> baseline;
+    size_t at = json.find("\"benchmarks\"");
+    while (at != std::string::npos && (at = json.find('{', at)) != std::string::npos) {
+        size_t end = json.find('}', at);
+        if (end == std::string::npos) break;
+        std::string_view object(json.data() + at, end - at + 1);
+        Measurement m;
+        m.name = jsonField(object, "name");
+        m.nsPerExpr = std::atof(jsonField(object, "ns_per_expr").c_str());
+        m.allocsPerExpr = std::atof(jsonField(object, "allocs_per_expr").c_str());
+        m.allocBytesPerExpr = std::atof(jsonField(object, "alloc_bytes_per_expr").c_str());
+        if (!m.name.empty()) baseline[m.name] = m;
+        at = end + 1;
+    }
+    return baseline;
+}
+
+/**
+ * Compare results against a baseline
+ * A benchmark regresses when it got more than threshold percent slower or
+ * allocates more per expression. Returns the number of regressions.
+ */
+static size_t compareResults(const std::vector<Measurement>& results,
+                             const std::map<std::string, Measurement>& baseline, double threshold) {
+    size_t regressions = 0;
+    std::fprintf(stderr, "\n%-24s %12s %12s %8s\n", "benchmark", "baseline ns", "current ns", "change");
+    for (const Measurement& m : results) {
+        auto found = baseline.find(m.name);
+        if (found == baseline.end()) {
+            std::fprintf(stderr, "%-24s %12s %12.1f %8s  new\n", m.name.c_str(), "-", m.nsPerExpr, "");
+            continue;
+        }
+        const Measurement& base = found->second;
+        double change = base.nsPerExpr > 0 ? (m.nsPerExpr - base.nsPerExpr) / base.nsPerExpr * 100 : 0;
+        bool slower = change > threshold;
+        bool allocates = m.allocsPerExpr > base.allocsPerExpr + 0.005 ||
+                         m.allocBytesPerExpr > base.allocBytesPerExpr * 1.01 + 0.5;
+        const char* verdict = slower ? "REGRESSION (time)" : allocates ? "REGRESSION (allocations)"
+                                                         : change < -threshold ? "faster" : "ok";
+        if (slower || allocates) regressions++;
+        std::fprintf(stderr, "%-24s %12.1f %12.1f %+7.1f%%  %s\n", m.name.c_str(), base.nsPerExpr,
+                     m.nsPerExpr, change, verdict);
+    }
+    std::fprintf(stderr, "%zu regression(s) beyond %.1f%%\n", regressions, threshold);
+    return regressions;
+}
+
+//Parse the command line; false after printing usage on a bad argument
+static bool parseArguments(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue) {
+            options.out = argv[++i];
+        } else if (arg == "--compare" && hasValue) {
+            options.compare = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            options.threshold = std::atof(argv[++i]);
+        } else if (arg == "--filter" && hasValue) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            options.minSeconds = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--out FILE] [--compare BASELINE] [--threshold PERCENT]"
+                      << " [--filter TEXT] [--min-time SECONDS]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseArguments(argc, argv, options)) return 2;
+
+    try {
+        // Read the baseline first so a bad path fails before the long run
+        std::map<std::string, Measurement> baseline;
+        if (!options.compare.empty()) baseline = readBaseline(options.compare);
+
+        std::vector<Measurement> results = runBenchmarks(options);
+
+        if (options.out.empty()) {
+            writeJson(std::cout, results);
+        } else {
+            std::ofstream file(options.out);
+            if (!file) throw std::runtime_error("Can't write " + options.out);
+            writeJson(file, results);
+        }
+
+        if (!options.compare.empty() && compareResults(results, baseline, options.threshold) > 0) {
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
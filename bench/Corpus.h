@@ -0,0 +1,255 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//class CorpusRandom
+//splitmix64: tiny, and produces the same sequence on every platform and
+//standard library, so generated corpora are identical everywhere
+class CorpusRandom {
+private:
+    uint64_t state;
+
+public:
+    explicit CorpusRandom(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    //Uniform value in [0, n)
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>(next() % n); }
+
+    //Literal in [low, high]
+    std::string literal(uint32_t low, uint32_t high) { return std::to_string(low + below(high - low + 1)); }
+
+    //One of the given spellings
+    template <size_t N>
+    const char* pick(const char* const (&choices)[N]) { return choices[below(N)]; }
+};
+
+//A named set of generated expressions
+struct Corpus {
+    std::string name;
+    std::vector<std::string> expressions;
+    std::vector<std::string_view> views;  ///< Views of expressions, ready for evalMany-style APIs
+    size_t bytes = 0;                     ///< Total length of all expressions
+
+    void add(std::string expression) {
+        bytes += expression.size();
+        expressions.push_back(std::move(expression));
+    }
+
+    //Fill views once every expression is added (the strings no longer move)
+    void finish() { views.assign(expressions.begin(), expressions.end()); }
+
+    double averageLength() const { return expressions.empty() ? 0 : double(bytes) / expressions.size(); }
+};
+
+//Binary operators that can't fail on the operands the generators produce
+inline constexpr const char* ArithmeticOps[] = {"+", "-", "*"};
+inline constexpr const char* DivisionOps[] = {"/", "%"};
+inline constexpr const char* ComparisonOps[] = {">", ">=", "<", "<=", "==", "!="};
+inline constexpr const char* PrefixOps[] = {"+", "-", "!", "++", "--"};
+
+//Short arithmetic such as "12*7-3" or "(4+9)%5"
+inline Corpus shortArithmetic(size_t count, uint64_t seed) {
+    CorpusRandom random(seed);
+    Corpus corpus;
+    corpus.name = "short";
+    for (size_t i = 0; i < count; i++) {
+        std::string e;
+        size_t operands = 2 + random.below(3);
+        bool grouped = random.below(4) == 0;
+        if (grouped) e += '(';
+        e += random.literal(0, 99);
+        for (size_t k = 1; k < operands; k++) {
+            // Divisors are never zero, so every expression evaluates
+            if (random.below(4) == 0) {
+                e += random.pick(DivisionOps);
+                e += random.literal(1, 99);
+            } else {
+                e += random.pick(ArithmeticOps);
+                e += random.literal(0, 99);
+            }
+            if (grouped && k == 1) e += ')';
+        }
+        corpus.add(std::move(e));
+    }
+    corpus.finish();
+    return corpus;
+}
+
+//Long flat chains of operands, e.g. "3+17*4-8/2+..." with the given operand count
+inline Corpus flatChain(size_t count, size_t operands, uint64_t seed) {
+    CorpusRandom random(seed);
+    Corpus corpus;
+    corpus.name = "chain-" + std::to_string(operands);
+    for (size_t i = 0; i < count; i++) {
+        std::string e = random.literal(0, 999);
+        for (size_t k = 1; k < operands; k++) {
+            if (random.below(5) == 0) {
+                e += random.pick(DivisionOps);
+                e += random.literal(1, 999);
+            } else {
+                e += random.pick(ArithmeticOps);
+                e += random.literal(0, 999);
+            }
+        }
+        corpus.add(std::move(e));
+    }
+    corpus.finish();
+    return corpus;
+}
+
+//Deeply nested parentheses: half left-deep "((((1+2)*3)-4)...)", half
+//right-deep "1+(2*(3-(...)))"
+inline Corpus nestedParentheses(size_t count, size_t depth, uint64_t seed) {
+    CorpusRandom random(seed);
+    Corpus corpus;
+    corpus.name = "nested-" + std::to_string(depth);
+    for (size_t i = 0; i < count; i++) {
+        std::string e;
+        if (i % 2 == 0) {
+            e.append(depth, '(');
+            e += random.literal(0, 99);
+            for (size_t k = 0; k < depth; k++) {
+                e += random.pick(ArithmeticOps);
+                e += random.literal(0, 99);
+                e += ')';
+            }
+        } else {
+            for (size_t k = 0; k < depth; k++) {
+                e += random.literal(0, 99);
+                e += random.pick(ArithmeticOps);
+                e += '(';
+            }
+            e += random.literal(0, 99);
+            e.append(depth, ')');
+        }
+        corpus.add(std::move(e));
+    }
+    corpus.finish();
+    return corpus;
+}
+
+//Operator-heavy unary chains such as "+++2-5*(3^2)" or "!-+--7+4"
+inline Corpus unaryChains(size_t count, uint64_t seed) {
+    CorpusRandom random(seed);
+    Corpus corpus;
+    corpus.name = "unary";
+    for (size_t i = 0; i < count; i++) {
+        std::string e;
+        size_t terms = 2 + random.below(4);
+        for (size_t k = 0; k < terms; k++) {
+            if (k > 0) e += random.pick(ArithmeticOps);
+            size_t prefixes = 1 + random.below(4);
+            for (size_t p = 0; p < prefixes; p++) e += random.pick(PrefixOps);
+            if (random.below(3) == 0) {
+                e += "(" + random.literal(0, 9) + "^" + random.literal(0, 3) + ")";
+            } else {
+                e += random.literal(0, 99);
+            }
+        }
+        corpus.add(std::move(e));
+    }
+    corpus.finish();
+    return corpus;
+}
+
+//Boolean-heavy rules such as "(12>7 && 3<=9) || !(4==5) && 8!=1"
+inline Corpus booleanRules(size_t count, uint64_t seed) {
+    CorpusRandom random(seed);
+    Corpus corpus;
+    corpus.name = "boolean";
+    for (size_t i = 0; i < count; i++) {
+        std::string e;
+        size_t clauses = 2 + random.below(5);
+        for (size_t k = 0; k < clauses; k++) {
+            if (k > 0) e += random.below(2) ? " && " : " || ";
+            bool negated = random.below(4) == 0;
+            bool grouped = random.below(3) == 0;
+            if (negated) e += '!';
+            if (negated || grouped) e += '(';
+            e += random.literal(0, 99) + random.pick(ComparisonOps) + random.literal(0, 99);
+            if (grouped) {
+                e += random.below(2) ? " && " : " || ";
+                e += random.literal(0, 99) + random.pick(ComparisonOps) + random.literal(0, 99);
+            }
+            if (negated || grouped) e += ')';
+        }
+        corpus.add(std::move(e));
+    }
+    corpus.finish();
+    return corpus;
+}
+
+//Rules over the variables a..e (each 0..99) written in an unlucky order:
+//costly clauses that hardly ever decide the rule come before cheap ones
+//that usually do, e.g. "a*b*c + d*e - b*d > -9000 && e == 3 && b < 90"
+inline Corpus skewedRules(size_t count, uint64_t seed) {
+    CorpusRandom random(seed);
+    Corpus corpus;
+    corpus.name = "skewed";
+    auto name = [&]() { return std::string(1, static_cast<char>('a' + random.below(5))); };
+    for (size_t i = 0; i < count; i++) {
+        // && rules end in rarely true clauses, || rules in usually true ones
+        bool isAnd = random.below(4) != 0;
+        const char* join = isAnd ? " && " : " || ";
+        std::string e;
+        size_t costly = 1 + random.below(2);
+        for (size_t k = 0; k < costly; k++) {
+            if (k > 0) e += join;
+            e += name() + "*" + name() + "*" + name() + " + " + name() + "*" + name() + " - " + name() + "*" +
+                 name() + (isAnd ? " > -9000" : " < -9000");
+        }
+        size_t cheap = 1 + random.below(2);
+        for (size_t k = 0; k < cheap; k++) {
+            e += join + name() + (isAnd ? " == " : " != ") + random.literal(0, 99);
+        }
+        corpus.add(std::move(e));
+    }
+    corpus.finish();
+    return corpus;
+}
+
+//Machine-formatted arithmetic as code generators write it: one term per
+//line, deep indentation and long literals, e.g.
+//  "(\n        123456789012 * 7\n        + (   4096   - 31   )\n ..."
+inline Corpus formattedCode(size_t count, uint64_t seed) {
+    CorpusRandom random(seed);
+    Corpus corpus;
+    corpus.name = "formatted";
+    for (size_t i = 0; i < count; i++) {
+        std::string e = "(\n";
+        size_t terms = 8 + random.below(8);
+        for (size_t k = 0; k < terms; k++) {
+            e.append(4 + 4 * random.below(4), ' ');
+            if (k > 0) {
+                e += random.pick(ArithmeticOps);
+                e += ' ';
+            }
+            if (random.below(3) == 0) {
+                e += "(   " + random.literal(0, 9999) + "   " + random.pick(ArithmeticOps) + "   " +
+                     random.literal(0, 99) + "   )";
+            } else {
+                // Up to 18 digits: the literal wraps for 32-bit values but never fails
+                e += random.literal(1, 999999999);
+                e.append(random.below(10), '0');
+            }
+            e += '\n';
+        }
+        e += ")";
+        corpus.add(std::move(e));
+    }
+    corpus.finish();
+    return corpus;
+}
+
+#endif // CORPUS_H
\ No newline at end of file
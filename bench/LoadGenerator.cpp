@@ -0,0 +1,163 @@
+/**
+ * Load generator for the evaluation server
+ * Opens several connections to a server started with --serve, keeps a fixed
+ * number of requests in flight on each (pipelining) for a while, and reports
+ * the throughput and the latency distribution of the requests. Build it next
+ * to the library sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread bench/LoadGenerator.cpp EvalClient.cpp EvalProtocol.cpp \
+ *       EvalError.cpp Instrumentation.cpp -o loadgen
+ *
+ * Usage: loadgen SOCKET [--connections N] [--depth N] [--seconds S] [--corpus NAME]
+ * The server must use the default int32 policy. The corpus is one of the
+ * benchmark corpora (see Corpus.h): short (default), boolean or chain.
+ */
+
+#include "../EvalClient.h"
+#include "../Instrumentation.h"
+#include "Corpus.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+//Settings of a run
+struct LoadOptions {
+    std::string socket;
+    size_t connections = 4;      ///< Client connections, one thread each
+    size_t depth = 64;           ///< Requests in flight per connection
+    double seconds = 5;          ///< Length of the measurement
+    std::string corpus = "short";
+};
+
+//What one connection measured
+struct LoadResult {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t maxNanoseconds = 0;
+    LatencyHistogram latency;
+    std::string failure;  ///< Why the connection stopped early, if it did
+};
+
+/**
+ * Drive one connection until the deadline
+ * The connection is topped up to depth requests in flight, flushed once, and
+ * then every response that has arrived is taken before topping it up again.
+ * The server answers in order, so the send times of the requests in flight
+ * are kept in a queue and each response belongs to the oldest.
+ */
+static void driveConnection(const LoadOptions& options, const Corpus& corpus, size_t offset, Clock::time_point deadline,
+                            LoadResult& result) {
+    try {
+        EvalClient client(options.socket);
+        std::deque<Clock::time_point> sentAt;
+        size_t next = offset;
+        EvalResponse response;
+
+        auto record = [&](Clock::time_point now) {
+            uint64_t nanoseconds = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - sentAt.front()).count());
+            sentAt.pop_front();
+            result.latency.counts[LatencyHistogram::bucketOf(nanoseconds)]++;
+            result.maxNanoseconds = std::max(result.maxNanoseconds, nanoseconds);
+            result.requests++;
+            if (!response.ok()) result.errors++;
+        };
+
+        for (Clock::time_point now = Clock::now(); now < deadline; now = Clock::now()) {
+            while (client.pending() < options.depth) {
+                client.send(corpus.views[next++ % corpus.views.size()]);
+                sentAt.push_back(now);
+            }
+            client.flush();
+            client.receive(response);
+            now = Clock::now();
+            record(now);
+            while (client.receive(response, false)) record(now);
+        }
+        while (client.receive(response)) {
+        }
+    } catch (const std::exception& e) {
+        result.failure = e.what();
+    }
+}
+
+//Parse the command line; false after printing usage on a bad argument
+static bool parseArguments(int argc, char* argv[], LoadOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--connections" && hasValue) {
+            options.connections = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--depth" && hasValue) {
+            options.depth = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--seconds" && hasValue) {
+            options.seconds = std::atof(argv[++i]);
+        } else if (arg == "--corpus" && hasValue) {
+            options.corpus = argv[++i];
+        } else if (options.socket.empty() && arg[0] != '-') {
+            options.socket = arg;
+        } else {
+            options.socket.clear();
+            break;
+        }
+    }
+    if (options.socket.empty() ||
+        (options.corpus != "short" && options.corpus != "boolean" && options.corpus != "chain")) {
+        std::cerr << "Usage: " << argv[0]
+                  << " SOCKET [--connections N] [--depth N] [--seconds S] [--corpus short|boolean|chain]\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    if (!parseArguments(argc, argv, options)) return 2;
+
+    Corpus corpus = options.corpus == "boolean" ? booleanRules(1 << 14, 7)
+                  : options.corpus == "chain"   ? flatChain(1 << 12, 32, 7)
+                                                : shortArithmetic(1 << 14, 7);
+    corpus.finish();
+
+    std::vector<LoadResult> results(options.connections);
+    std::vector<std::thread> threads;
+    Clock::time_point started = Clock::now();
+    Clock::time_point deadline = started + std::chrono::duration_cast<Clock::duration>(
+                                               std::chrono::duration<double>(options.seconds));
+    for (size_t i = 0; i < options.connections; i++) {
+        size_t offset = i * corpus.views.size() / options.connections;
+        threads.emplace_back(driveConnection, std::cref(options), std::cref(corpus), offset, deadline,
+                             std::ref(results[i]));
+    }
+    for (std::thread& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+
+    LoadResult total;
+    for (const LoadResult& result : results) {
+        if (!result.failure.empty()) {
+            std::cerr << "Connection failed: " << result.failure << std::endl;
+            return 1;
+        }
+        total.requests += result.requests;
+        total.errors += result.errors;
+        total.maxNanoseconds = std::max(total.maxNanoseconds, result.maxNanoseconds);
+        for (size_t b = 0; b < LatencyHistogram::BucketCount; b++) total.latency.counts[b] += result.latency.counts[b];
+    }
+
+    auto micros = [&](double fraction) { return total.latency.percentile(fraction) / 1e3; };
+    std::printf("%s corpus (%.1f bytes/expression), %zu connections x %zu in flight, %.2f s\n",
+                options.corpus.c_str(), corpus.averageLength(), options.connections, options.depth, seconds);
+    std::printf("requests:   %llu (%llu errors), %.0f requests/sec\n", (unsigned long long)total.requests,
+                (unsigned long long)total.errors, total.requests / seconds);
+    std::printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", micros(0.5), micros(0.9),
+                micros(0.99), micros(0.999), total.maxNanoseconds / 1e3);
+    return 0;
+}
\ No newline at end of file
@@ -1,4 +1,379 @@
 #include "Evaluator.h"
+#include "BulkEvaluator.h"
+#include "BulkIO.h"
+#include "EvalServer.h"
+#include "ExpressionImage.h"
+#include "StreamEvaluator.h"
+#include "Instrumentation.h"
+#include <cerrno>
+#include <csignal>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <optional>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+
+//Options of the batch mode
+struct BatchOptions {
+    std::string input;             ///< Input file, or "-" for stdin
+    std::string output = "-";      ///< Output file, or "-" for stdout
+    std::string policy = "int32";  ///< Numeric policy name
+    size_t threads = 1;            ///< Worker threads (0 = one per hardware thread)
+    bool cache = false;            ///< Look repeated expressions up in a cache
+    bool summary = true;           ///< Print the throughput summary to stderr
+    std::string stats;             ///< Instrumentation output format ("json" or "prometheus"), if any
+    std::string writeImage;        ///< Compile INPUT into this image file instead of evaluating it
+    bool image = false;            ///< INPUT is an image written by --write-image
+    bool stream = false;           ///< INPUT is a single expression, evaluated as it is read
+    std::string serve;             ///< Serve evaluation requests on this socket instead of reading INPUT
+};
+
+//Print the command line usage
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] INPUT\n"
+              << "       " << program << " [options] --serve SOCKET\n"
+              << "Evaluate one expression per line of INPUT (\"-\" for stdin)\n"
+              << "  -o FILE         write results to FILE instead of stdout\n"
+              << "  -j N            evaluate on N threads (0 = all hardware threads)\n"
+              << "  --policy NAME   int32 (default), int64, int128, checked32, checked64,\n"
+              << "                  saturating32, saturating64 or double\n"
+              << "  --cache         compile repeated expressions once\n"
+              << "  --quiet         don't print the throughput summary\n"
+              << "  --stats FORMAT  print instrumentation counters to stderr as json or prometheus\n"
+              << "                  (recorded in builds with -DEVALUATOR_INSTRUMENTATION=1)\n"
+              << "  --write-image FILE  compile every line into the image FILE instead\n"
+              << "  --image         INPUT is an image; evaluate each of its expressions\n"
+              << "  --stream        INPUT is one expression (newlines are spaces), evaluated\n"
+              << "                  as it is read without holding it in memory\n"
+              << "  --serve SOCKET  serve evaluation requests on the Unix domain socket SOCKET\n"
+              << "                  until interrupted (see EvalClient.h)\n";
+}
+
+//Parse the command line; nullopt after printing usage on a bad argument
+static std::optional<BatchOptions> parseArguments(int argc, char* argv[]) {
+    BatchOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-o" && hasValue) {
+            options.output = argv[++i];
+        } else if (arg == "-j" && hasValue) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--policy" && hasValue) {
+            options.policy = argv[++i];
+        } else if (arg == "--cache") {
+            options.cache = true;
+        } else if (arg == "--quiet") {
+            options.summary = false;
+        } else if (arg == "--stats" && hasValue && (std::string_view(argv[i + 1]) == "json" ||
+                                                    std::string_view(argv[i + 1]) == "prometheus")) {
+            options.stats = argv[++i];
+        } else if (arg == "--write-image" && hasValue) {
+            options.writeImage = argv[++i];
+        } else if (arg == "--image") {
+            options.image = true;
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--serve" && hasValue) {
+            options.serve = argv[++i];
+        } else if (options.input.empty() && (arg == "-" || arg[0] != '-')) {
+            options.input = arg;
+        } else {
+            printUsage(argv[0]);
+            return std::nullopt;
+        }
+    }
+    if (options.input.empty() == options.serve.empty() ||
+        (options.image && (options.input == "-" || !options.writeImage.empty()))) {
+        printUsage(argv[0]);
+        return std::nullopt;
+    }
+    return options;
+}
+
+//Print the throughput summary of a run to stderr
+static void printSummary(const char* done, const BulkStats& stats, std::chrono::steady_clock::time_point started) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    seconds = std::max(seconds, 1e-9);
+    std::cerr << std::fixed << std::setprecision(3)
+              << done << " " << stats.expressions << " expressions (" << stats.errors << " errors, "
+              << stats.bytes / 1e6 << " MB) in " << seconds << " s: "
+              << std::setprecision(0) << stats.expressions / seconds << " expressions/sec, "
+              << std::setprecision(1) << stats.bytes / 1e6 / seconds << " MB/sec" << std::endl;
+}
+
+//Open the output file of the options; stdout for "-", -1 after reporting a failure
+static int openOutput(const BatchOptions& options) {
+    if (options.output == "-") return STDOUT_FILENO;
+    int fd = ::open(options.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) std::cerr << "Can't open " << options.output << ": " << std::strerror(errno) << std::endl;
+    return fd;
+}
+
+//Compile every line of the input into an image file
+template <class Policy>
+static int writeImage(const BatchOptions& options) {
+    auto started = std::chrono::steady_clock::now();
+    BasicExpressionImageWriter<Policy> writer;
+    BulkStats stats;
+
+    auto addLines = [&](std::string_view text) {
+        stats.bytes += text.size();
+        while (!text.empty()) {
+            size_t newline = text.find('\n');
+            std::string_view line = text.substr(0, newline);
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            writer.add(line);
+        }
+    };
+
+    try {
+        if (options.input == "-") {
+            ChunkReader reader(STDIN_FILENO);
+            std::string_view lines;
+            while (reader.next(lines)) addLines(lines);
+        } else {
+            MappedFile file(options.input);
+            addLines(file.text());
+        }
+        writer.save(options.writeImage);
+    } catch (const std::system_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    stats.expressions = writer.size();
+    stats.errors = writer.errors();
+    if (options.summary) printSummary("Compiled", stats, started);
+    return 0;
+}
+
+/**
+ * Evaluate every expression of an image
+ * Results are written like those of runBatch(), one line per expression;
+ * expressions that failed to compile report their stored error.
+ */
+template <class Policy>
+static int runImage(const BatchOptions& options) {
+    auto started = std::chrono::steady_clock::now();
+    int outputFd = openOutput(options);
+    if (outputFd < 0) return 1;
+
+    BulkStats stats;
+    try {
+        BasicExpressionImage<Policy> image(options.input);
+        OutputBuffer out(outputFd);
+        std::string line;
+        for (size_t i = 0; i < image.size(); i++) {
+            line.clear();
+            try {
+                appendValue(line, image[i].run());
+            } catch (const EvalError& e) {
+                stats.errors++;
+                line += "error";
+                if (e.position() != EvalError::npos) {
+                    line += '@';
+                    appendValue(line, e.position());
+                }
+                line += ' ';
+                line += EvalError::describe(e.kind());
+            }
+            line += '\n';
+            out.append(line);
+        }
+        out.flush();
+        stats.expressions = image.size();
+        stats.bytes = image.bytes();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (outputFd != STDOUT_FILENO) ::close(outputFd);
+
+    if (options.summary) printSummary("Evaluated", stats, started);
+    return 0;
+}
+
+/**
+ * Evaluate the input as one expression while it is read
+ * The result (or the error, positioned in the whole input) is written as a
+ * single line like those of runBatch().
+ */
+template <class Policy>
+static int runStream(const BatchOptions& options) {
+    auto started = std::chrono::steady_clock::now();
+    int inputFd = STDIN_FILENO;
+    if (options.input != "-") {
+        inputFd = ::open(options.input.c_str(), O_RDONLY);
+        if (inputFd < 0) {
+            std::cerr << "Can't open " << options.input << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+    }
+    int outputFd = openOutput(options);
+    if (outputFd < 0) return 1;
+
+    BulkStats stats;
+    stats.expressions = 1;
+    std::string line;
+    std::vector<char> buffer(BasicStreamEvaluator<Policy>::ReadSize);
+    auto read = [&]() -> std::string_view {
+        ssize_t count;
+        do {
+            count = ::read(inputFd, buffer.data(), buffer.size());
+        } while (count < 0 && errno == EINTR);
+        if (count < 0) throw std::system_error(errno, std::generic_category(), "Can't read input");
+        stats.bytes += static_cast<size_t>(count);
+        return {buffer.data(), static_cast<size_t>(count)};
+    };
+
+    try {
+        try {
+            appendValue(line, BasicStreamEvaluator<Policy>::evalChunks(read));
+        } catch (const EvalError& e) {
+            stats.errors++;
+            line += "error";
+            if (e.position() != EvalError::npos) {
+                line += '@';
+                appendValue(line, e.position());
+            }
+            line += ' ';
+            line += EvalError::describe(e.kind());
+        }
+        line += '\n';
+        OutputBuffer out(outputFd);
+        out.append(line);
+        out.flush();
+    } catch (const std::system_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (inputFd != STDIN_FILENO) ::close(inputFd);
+    if (outputFd != STDOUT_FILENO) ::close(outputFd);
+
+    if (options.summary) printSummary("Evaluated", stats, started);
+    return 0;
+}
+
+//Server stopped by SIGINT and SIGTERM
+template <class Policy>
+static BasicEvalServer<Policy>* runningServer = nullptr;
+
+/**
+ * Serve evaluation requests on a Unix domain socket
+ * Runs until SIGINT or SIGTERM, then removes the socket and prints the
+ * throughput summary (counting requests as expressions).
+ */
+template <class Policy>
+static int runServer(const BatchOptions& options) {
+    auto started = std::chrono::steady_clock::now();
+    std::optional<ThreadPool> pool;
+    if (options.threads != 1) {
+        pool.emplace(options.threads == 0 ? std::thread::hardware_concurrency() : options.threads);
+    }
+
+    BasicEvaluator<Policy> evaluator;
+    if (options.cache) {
+        evaluator = BasicEvaluator<Policy>(std::make_shared<BasicExpressionCache<Policy>>());
+    }
+
+    BulkStats stats;
+    try {
+        BasicEvalServer<Policy> server(evaluator, options.serve, pool ? &*pool : nullptr);
+        runningServer<Policy> = &server;
+        auto stop = [](int) { runningServer<Policy>->stop(); };
+        std::signal(SIGINT, stop);
+        std::signal(SIGTERM, stop);
+        server.run();
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        runningServer<Policy> = nullptr;
+
+        stats.expressions = server.stats().requests;
+        stats.errors = server.stats().errors;
+        stats.bytes = server.stats().bytes;
+    } catch (const std::system_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (options.summary) printSummary("Served", stats, started);
+    if (!options.stats.empty()) {
+        InstrumentationSnapshot snapshot = Instrumentation::snapshot();
+        std::cerr << (options.stats == "json" ? snapshot.json() + "\n" : snapshot.prometheus());
+    }
+    return 0;
+}
+
+/**
+ * Evaluate every line of the input under a numeric policy
+ * A file is memory-mapped; stdin is streamed in large chunks. Results go
+ * through one large output buffer and a throughput summary goes to stderr.
+ */
+template <class Policy>
+static int runBatch(const BatchOptions& options) {
+    if (!options.serve.empty()) return runServer<Policy>(options);
+    if (!options.writeImage.empty()) return writeImage<Policy>(options);
+    if (options.image) return runImage<Policy>(options);
+    if (options.stream) return runStream<Policy>(options);
+
+    auto started = std::chrono::steady_clock::now();
+    int outputFd = openOutput(options);
+    if (outputFd < 0) return 1;
+
+    std::optional<ThreadPool> pool;
+    if (options.threads != 1) {
+        pool.emplace(options.threads == 0 ? std::thread::hardware_concurrency() : options.threads);
+    }
+
+    BasicEvaluator<Policy> evaluator;
+    if (options.cache) {
+        evaluator = BasicEvaluator<Policy>(std::make_shared<BasicExpressionCache<Policy>>());
+    }
+    BasicBulkEvaluator<Policy> bulk(evaluator, pool ? &*pool : nullptr);
+
+    try {
+        OutputBuffer out(outputFd);
+        if (options.input == "-") {
+            ChunkReader reader(STDIN_FILENO);
+            std::string_view lines;
+            while (reader.next(lines)) bulk.process(lines, out);
+        } else {
+            MappedFile file(options.input);
+            bulk.process(file.text(), out);
+        }
+        out.flush();
+    } catch (const std::system_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (outputFd != STDOUT_FILENO) ::close(outputFd);
+
+    if (options.summary) printSummary("Evaluated", bulk.stats(), started);
+    if (!options.stats.empty()) {
+        InstrumentationSnapshot snapshot = Instrumentation::snapshot();
+        std::cerr << (options.stats == "json" ? snapshot.json() + "\n" : snapshot.prometheus());
+    }
+    return 0;
+}
+
+//Run the batch mode with the numeric policy named in the options
+static int runBatch(const BatchOptions& options) {
+    if (options.policy == "int32")        return runBatch<Int32Policy>(options);
+    if (options.policy == "int64")        return runBatch<Int64Policy>(options);
+    if (options.policy == "int128")       return runBatch<Int128Policy>(options);
+    if (options.policy == "checked32")    return runBatch<CheckedInt32Policy>(options);
+    if (options.policy == "checked64")    return runBatch<CheckedInt64Policy>(options);
+    if (options.policy == "saturating32") return runBatch<SaturatingInt32Policy>(options);
+    if (options.policy == "saturating64") return runBatch<SaturatingInt64Policy>(options);
+    if (options.policy == "double")       return runBatch<DoublePolicy>(options);
+    std::cerr << "Unknown policy: " << options.policy << std::endl;
+    return 1;
+}
 
 /**
  * Main function for interactive expression evaluation
@@ -6,6 +381,9 @@
  * mathematical expressions and see their evaluated results. It continues
  * to prompt for expressions until the user chooses to quit.
  *
+ * Given an input file (or "-" for stdin) it runs in batch mode instead,
+ * evaluating one expression per line (see runBatch()).
+ *
  * Supported features:
  * - Arithmetic operators: +, -, *, /, %, ^
  * - Comparison operators: >, <, =
@@ -13,7 +391,12 @@
  * - Parentheses for grouping: ()
  * - Unary operators: +, -, !
  */
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        std::optional<BatchOptions> options = parseArguments(argc, argv);
+        return options ? runBatch(*options) : 2;
+    }
+
     // Create an instance of the Evaluator class
     Evaluator eval;
 
@@ -47,7 +430,7 @@ int main() {
     std::cout << "  1+3 > 2        -> 1 //or true if the type is bool" << std::endl;
     std::cout << "  (4>=4) && 0    -> 0 //or false if the type is bool" << std::endl;
     std::cout << "  (1+2)*3        -> 9" << std::endl;
-    std::cout << "  +++2-5*(3^2)   -> -41" << std::endl;
+    std::cout << "  +++2-5*(3^2)   -> -42" << std::endl;
     std::cout << std::endl;
 
     return 0;  // Program completed successfully
@@ -0,0 +1,128 @@
+/**
+ * Adaptive expressions
+ * Reordering && / || chains must never change a result: every run of a
+ * BasicAdaptiveExpression has to give the value or error of the compiled
+ * expression, before and after its chains have been reordered, with data
+ * whose distribution shifts halfway so the order changes again. Checked
+ * for every numeric policy on chains of predicates that differ in cost and
+ * selectivity, on random expressions using every operator, and on operands
+ * that can fail and so must keep their place. Build it next to the library
+ * sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/AdaptiveExpressionTest.cpp AdaptiveExpression.cpp CompiledExpression.cpp \
+ *       EvalError.cpp Evaluator.cpp ExpressionCache.cpp Instrumentation.cpp ThreadPool.cpp -o adaptive_test
+ */
+
+#include "../AdaptiveExpression.h"
+#include "Check.h"
+#include "Expressions.h"
+#include <string>
+#include <vector>
+
+//Random chains of predicates of different cost and selectivity over a..e
+class ChainGenerator {
+private:
+    ExpressionGenerator generator;
+
+    std::string name() { return std::string(1, "abcde"[generator.pick(5)]); }
+    std::string digit() { return std::to_string(generator.pick(10)); }
+
+    std::string predicate() {
+        switch (generator.pick(8)) {
+        case 0: return name() + " / " + name() + " > 1";
+        case 1: return name() + " * " + name() + " * " + name() + " + " + name() + " * 3 - " + name() + " > 20";
+        case 2: return name() + " == " + digit();
+        case 3: return name() + " % " + digit() + " != 0";
+        case 4: return "!(" + name() + " < " + digit() + ")";
+        case 5: return name() + " - " + digit();
+        case 6: return name() + " ^ " + digit() + " > 50";
+        default: return name() + " > " + digit();
+        }
+    }
+
+public:
+    explicit ChainGenerator(uint64_t seed) : generator(seed) {}
+
+    size_t pick(size_t n) { return generator.pick(n); }
+
+    std::string chain(int depth) {
+        std::string text;
+        for (size_t i = 0, n = 2 + generator.pick(4); i < n; i++) {
+            if (i > 0) text += generator.pick(2) ? " && " : " || ";
+            text += depth < 3 && generator.pick(3) == 0 ? "(" + chain(depth + 1) + ")" : predicate();
+        }
+        return text;
+    }
+};
+
+//Run the adaptive and the compiled expression over rows of values; values
+//run from low to high + low, and from the middle row on from low to high.
+//Returns the number of reorders.
+template <class Policy>
+static uint64_t checkRuns(const BasicEvaluator<Policy>& evaluator, const std::string& text, ChainGenerator& rng,
+                          int low, int high, size_t rows) {
+    using T = typename Policy::value_type;
+    // A syntax error is raised by both constructors alike
+    std::string compiles = check::outcome([&] { evaluator.compile(text); return true; });
+    CHECK_EQ(check::outcome([&] { BasicAdaptiveExpression<Policy> adaptive(text); return true; }), compiles);
+    if (compiles != "true") return 0;
+
+    typename BasicEvaluator<Policy>::Compiled compiled = evaluator.compile(text);
+    BasicAdaptiveExpression<Policy> adaptive(text);
+    CHECK((adaptive.variables() == compiled.variables()));
+    CHECK_EQ(check::outcome([&] { return adaptive.run(); }), check::outcome([&] { return compiled.run(); }));
+
+    std::vector<T> values(compiled.variables().size());
+    for (size_t row = 0; row < rows; row++) {
+        int span = row < rows / 2 ? high + low : high;
+        for (T& value : values) value = static_cast<T>(low + static_cast<int>(rng.pick(static_cast<size_t>(span - low))));
+        CHECK_EQ(check::outcome([&] { return adaptive.run(values); }), check::outcome([&] { return compiled.run(values); }));
+    }
+    return adaptive.reorders();
+}
+
+template <class Policy>
+static void checkPolicy(uint64_t seed) {
+    BasicEvaluator<Policy> evaluator;
+    ChainGenerator chains(seed);
+    uint64_t reorders = 0;
+    for (int i = 0; i < 100; i++) reorders += checkRuns(evaluator, chains.chain(0), chains, -3, 12, 3000);
+    CHECK(reorders > 0);
+
+    ExpressionGenerator generator(seed + 1, {"a", "b", "c", "d"});
+    for (int i = 0; i < 300; i++) checkRuns(evaluator, generator.expression(3), chains, -3, 8, 2100);
+
+    // The divisions can fail and keep their place, so they only run when
+    // the operands written before them let the chain continue
+    static const char* guarded[] = {"a > 3 && 100 / b > 1 && c == 1", "c == 1 || a < 2 || 10 % b > 4 || d > 5",
+                                    "(a > 0 && 7 / a) + (b && c > 8 && 9 / (b - c) < 0)",
+                                    "a * b * c * d > 100 && a != 5 && 5 / (a - 5) < 0 && d == 1"};
+    for (const char* text : guarded) checkRuns(evaluator, text, chains, 0, 10, 5000);
+}
+
+int main() {
+    uint64_t seed = 1;
+#define CHECK_POLICY(P) checkPolicy<P>(seed += 2);
+    EVALUATOR_STANDARD_POLICIES(CHECK_POLICY)
+#undef CHECK_POLICY
+
+    // A cheap, selective operand moves ahead of a costly one that rarely
+    // decides the chain
+    AdaptiveExpression adaptive("a * b * c + d * a - b * c > 0 && d == 7");
+    ChainGenerator rng(99);
+    int32_t values[4];
+    for (int row = 0; row < 5000; row++) {
+        for (int32_t& value : values) value = 1 + static_cast<int32_t>(rng.pick(9));
+        adaptive.run(values);
+    }
+    std::vector<AdaptiveClauseStats> statistics = adaptive.statistics();
+    CHECK_EQ(adaptive.chainCount(), size_t(1));
+    CHECK_EQ(statistics.size(), size_t(2));
+    if (statistics.size() == 2) {
+        CHECK_EQ(statistics[0].position, uint32_t(33));
+        CHECK_EQ(statistics[0].slot, size_t(0));
+        CHECK(statistics[0].rank <= statistics[1].rank);
+    }
+    CHECK(adaptive.reorders() > 0);
+
+    return check::finish("AdaptiveExpressionTest");
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+/**
+ * Batch mode
+ * One output line per input line, in input order: the value eval() gives
+ * the line, or "error@<position> <description>". Single threaded and on a
+ * pool, with the input in one piece or in several, CRLF line ends, empty
+ * lines and a last line without a newline. Build it next to the library
+ * sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/BulkEvaluatorTest.cpp BulkEvaluator.cpp BulkIO.cpp CompiledExpression.cpp \
+ *       EvalError.cpp Evaluator.cpp ExpressionCache.cpp Instrumentation.cpp ThreadPool.cpp -o bulk_test
+ */
+
+#include "../BulkEvaluator.h"
+#include "Check.h"
+#include "Expressions.h"
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Everything written through an OutputBuffer by write()
+template <class Write>
+static std::string captured(Write&& write) {
+    std::FILE* file = std::tmpfile();
+    {
+        OutputBuffer out(fileno(file), 4096);
+        write(out);
+    }
+    std::rewind(file);
+    std::string text;
+    char block[4096];
+    for (size_t n; (n = std::fread(block, 1, sizeof(block), file)) > 0;) text.append(block, n);
+    std::fclose(file);
+    return text;
+}
+
+int main() {
+    Evaluator evaluator;
+    ExpressionGenerator generator(21);
+    std::string input;
+    std::string expected;
+    uint64_t lines = 0, errors = 0;
+    while (input.size() < 4 * BulkEvaluator::MinShardBytes) {
+        std::string line = lines % 97 == 0 ? "" : generator.expression(3);
+        input += line + (lines % 5 == 0 ? "\r\n" : "\n");
+        lines++;
+        try {
+            expected += check::text(evaluator.eval(line));
+        } catch (const EvalError& e) {
+            errors++;
+            expected += "error";
+            if (e.position() != EvalError::npos) expected += "@" + std::to_string(e.position());
+            expected += std::string(" ") + EvalError::describe(e.kind());
+        }
+        expected += '\n';
+    }
+    input += "1 + 2";
+    expected += "3\n";
+    lines++;
+
+    BulkEvaluator single(evaluator);
+    CHECK_EQ(captured([&](OutputBuffer& out) { single.process(input, out); }), expected);
+    CHECK_EQ(single.stats().expressions, lines);
+    CHECK_EQ(single.stats().errors, errors);
+    CHECK_EQ(single.stats().bytes, input.size());
+
+    ThreadPool pool(4);
+    BulkEvaluator parallel(evaluator, &pool);
+    CHECK_EQ(captured([&](OutputBuffer& out) { parallel.process(input, out); }), expected);
+    CHECK_EQ(parallel.stats().expressions, lines);
+    CHECK_EQ(parallel.stats().errors, errors);
+
+    // The same input handed over in pieces cut at line ends; totals add up
+    BulkEvaluator pieces(evaluator, &pool);
+    std::string output = captured([&](OutputBuffer& out) {
+        std::string_view rest = input;
+        for (size_t piece = 1; !rest.empty(); piece *= 3) {
+            size_t end = rest.find('\n', std::min(rest.size(), piece * 100));
+            end = end == std::string_view::npos ? rest.size() : end + 1;
+            pieces.process(rest.substr(0, end), out);
+            rest.remove_prefix(end);
+        }
+    });
+    CHECK_EQ(output, expected);
+    CHECK_EQ(pieces.stats().expressions, lines);
+
+    CHECK_EQ(captured([&](OutputBuffer& out) { single.process("", out); }), "");
+    CHECK_EQ(captured([&](OutputBuffer& out) { single.process("\n", out); }), "error Empty expression\n");
+    return check::finish("BulkEvaluatorTest");
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+/**
+ * Character scans
+ * The vector scans of CharClass.h have to stop where a byte at a time scan
+ * stops, for runs of every length starting at every alignment, ending on
+ * every byte value or at the end of the text; and literals converted eight
+ * digits at a time have to wrap, fail or saturate like the digit by digit
+ * conversion. Each text is copied to a buffer of exactly its size so a scan
+ * reading past the end shows under a sanitizer. The lexer is then checked on
+ * expressions with long runs of whitespace, digits and name characters.
+ * Build it next to the library sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/CharScanTest.cpp CompiledExpression.cpp EvalError.cpp Evaluator.cpp \
+ *       ExpressionCache.cpp Instrumentation.cpp ThreadPool.cpp -o char_scan_test
+ */
+
+#include "../CharClass.h"
+#include "../Evaluator.h"
+#include "Check.h"
+#include <memory>
+#include <random>
+#include <string>
+
+//Offset of the first character at or after pos whose class isn't inside
+template <class Predicate>
+static size_t scanBytes(std::string_view text, size_t pos, Predicate test, bool inside) {
+    while (pos < text.size() && test(text[pos]) == inside) pos++;
+    return pos;
+}
+
+//Check every scan from every offset of text
+static void checkScans(const std::string& text) {
+    std::unique_ptr<char[]> buffer(new char[text.size()]);
+    text.copy(buffer.get(), text.size());
+    std::string_view view(buffer.get(), text.size());
+    for (size_t pos = 0; pos <= view.size(); pos++) {
+        CHECK_EQ(skipSpaces(view, pos), scanBytes(view, pos, isSpaceChar, true));
+        CHECK_EQ(skipDigits(view, pos), scanBytes(view, pos, isDigitChar, true));
+        CHECK_EQ(skipNameChars(view, pos), scanBytes(view, pos, isNameChar, true));
+        CHECK_EQ(findSpace(view, pos), scanBytes(view, pos, isSpaceChar, false));
+    }
+}
+
+//Convert a literal a digit at a time
+template <class T, OverflowMode Mode>
+static ErrorKind parseDigits(std::string_view digits, T& out) {
+    T value = 0;
+    bool overflowed = false;
+    for (char digit : digits) {
+        overflowed |= __builtin_mul_overflow(value, static_cast<T>(10), &value);
+        overflowed |= __builtin_add_overflow(value, static_cast<T>(digit - '0'), &value);
+    }
+    if (overflowed && Mode == OverflowMode::Check) return ErrorKind::NumberOutOfRange;
+    out = (overflowed && Mode == OverflowMode::Saturate) ? IntegerLimits<T>::max : value;
+    return ErrorKind::None;
+}
+
+//Check literals of every length up to 60 digits
+template <class T, OverflowMode Mode>
+static void checkLiterals(std::mt19937_64& rng) {
+    for (size_t length = 1; length <= 60; length++) {
+        for (int trial = 0; trial < 200; trial++) {
+            std::string digits;
+            for (size_t i = 0; i < length; i++) digits += static_cast<char>('0' + rng() % 10);
+            // Mostly nines or zeros, to land next to the limits
+            if (trial % 4 == 1) digits.replace(0, rng() % length, std::string(length, '9'), 0, length);
+            if (trial % 4 == 2) digits.replace(0, rng() % length, std::string(length, '0'), 0, length);
+            digits.resize(length);
+            T expected = 0, actual = 0;
+            ErrorKind expectedError = parseDigits<T, Mode>(digits, expected);
+            ErrorKind actualError = IntegerPolicy<T, Mode>::parseLiteral(digits, actual);
+            CHECK(actualError == expectedError);
+            if (expectedError == ErrorKind::None) CHECK_EQ(actual, expected);
+        }
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(19);
+
+    // Runs of every length up to a few vectors, at every alignment, ending
+    // on every byte value or at the end of the text
+    const std::string members[] = {" \t\n\v\f\r", "0123456789", "azAZ_09"};
+    for (const std::string& member : members) {
+        for (size_t length = 0; length <= 70; length++) {
+            std::string run;
+            for (size_t i = 0; i < length; i++) run += member[rng() % member.size()];
+            checkScans(run);
+            for (int stop = 0; stop < 256; stop += length % 8 == 0 ? 1 : 37) {
+                checkScans(run + static_cast<char>(stop) + run);
+            }
+        }
+    }
+    // Random mixtures of every byte value
+    for (int trial = 0; trial < 2000; trial++) {
+        std::string text;
+        for (size_t n = rng() % 100; n > 0; n--) {
+            text += rng() % 3 == 0 ? static_cast<char>(rng() % 256) : members[rng() % 3][rng() % 6];
+        }
+        checkScans(text);
+    }
+
+    checkLiterals<int32_t, OverflowMode::Wrap>(rng);
+    checkLiterals<int64_t, OverflowMode::Wrap>(rng);
+    checkLiterals<__int128, OverflowMode::Wrap>(rng);
+    checkLiterals<int32_t, OverflowMode::Check>(rng);
+    checkLiterals<int64_t, OverflowMode::Check>(rng);
+    checkLiterals<int32_t, OverflowMode::Saturate>(rng);
+    checkLiterals<int64_t, OverflowMode::Saturate>(rng);
+
+    // The lexer over long runs: leading zeros, whitespace and names of every
+    // length, and the position of an invalid character after each
+    Evaluator evaluator;
+    const char* spaces = " \t\n\v\f\r";
+    for (size_t length = 0; length <= 70; length++) {
+        std::string blank;
+        for (size_t i = 0; i < length; i++) blank += spaces[rng() % 6];
+        std::string zeros(length, '0');
+        std::string name = "v" + std::string(length, 'a') + "_9";
+
+        std::string literal = blank + zeros + "42" + blank;
+        CHECK_EQ(check::outcome([&] { return evaluator.eval(literal); }), "42");
+        std::string invalid = blank + zeros + "42" + blank + "$";
+        CHECK_EQ(check::outcome([&] { return evaluator.eval(invalid); }),
+                 "Invalid character @ char " + std::to_string(invalid.size() - 1));
+
+        Evaluator::Compiled compiled = evaluator.compile(blank + name + blank + "+" + blank + zeros + "1");
+        CHECK_EQ(compiled.variables().size(), size_t(1));
+        CHECK_EQ(compiled.variables()[0], name);
+        const int32_t values[] = {41};
+        CHECK_EQ(check::outcome([&] { return compiled.run(values); }), "42");
+        std::string unknown = blank + name;
+        CHECK_EQ(check::outcome([&] { return evaluator.eval(unknown); }),
+                 "Unknown variable @ char " + std::to_string(length));
+    }
+
+    return check::finish("CharScanTest");
+}
\ No newline at end of file
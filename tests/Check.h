@@ -0,0 +1,78 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <charconv>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include "../EvalError.h"
+
+//Minimal checks shared by the behaviour tests. Every test is a standalone
+//program, built next to the library sources (see the build line at its
+//top), that prints each failed check and exits with 1 if there was one.
+namespace check {
+
+inline int failures = 0;
+inline int total = 0;
+
+//Text of a value; unlike ==, it tells -0 from 0
+template <class T>
+std::string text(T value) {
+    char digits[64];
+    return std::string(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+}
+
+//std::to_chars has no __int128 overload
+inline std::string text(__int128 value) {
+    unsigned __int128 magnitude = value < 0 ? -static_cast<unsigned __int128>(value) : value;
+    std::string digits;
+    do {
+        digits.insert(digits.begin(), static_cast<char>('0' + magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
+    return value < 0 ? "-" + digits : digits;
+}
+
+inline std::string text(bool value) { return value ? "true" : "false"; }
+inline std::string text(const char* value) { return value; }
+inline std::string text(std::string_view value) { return std::string(value); }
+inline std::string text(const std::string& value) { return value; }
+
+//Outcome of a computation: the text of its value, or the message of the
+//EvalError it raised ("<description> @ char N")
+template <class F>
+std::string outcome(F&& compute) {
+    try {
+        return text(compute());
+    } catch (const EvalError& e) {
+        return e.what();
+    }
+}
+
+//Record a check, printing it when it fails
+inline void expect(bool ok, const std::string& what, const char* file, int line) {
+    total++;
+    if (ok) return;
+    failures++;
+    std::printf("%s:%d: FAILED %s\n", file, line, what.c_str());
+}
+
+template <class A, class B>
+void expectEqual(const A& actual, const B& expected, const char* what, const char* file, int line) {
+    expect(actual == expected, std::string(what) + "\n    got      " + text(actual) + "\n    expected " + text(expected),
+           file, line);
+}
+
+//Print the summary; returns the exit status of the test
+inline int finish(const char* name) {
+    std::printf("%s: %d checks, %d failed\n", name, total, failures);
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace check
+
+#define CHECK(condition) check::expect((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQ(actual, expected) \
+    check::expectEqual((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
+
+#endif // TESTS_CHECK_H
\ No newline at end of file
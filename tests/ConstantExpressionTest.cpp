@@ -0,0 +1,76 @@
+/**
+ * Expressions evaluated while the program is compiled
+ * evalConstant() has to fold to what eval() gives at run time; those checks
+ * are static_asserts, so this file only compiles if they hold. A
+ * StaticExpression has to run like the same text compiled at run time, for
+ * values and errors alike. Build it next to the library sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/ConstantExpressionTest.cpp CompiledExpression.cpp EvalError.cpp \
+ *       Evaluator.cpp ExpressionCache.cpp Instrumentation.cpp ThreadPool.cpp -o constant_test
+ */
+
+#include "../ConstantExpression.h"
+#include "../Evaluator.h"
+#include "Check.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+static_assert(evalConstant("1+2*3") == 7);
+static_assert(evalConstant("+++2-5*(3^2)") == -42);
+static_assert(evalConstant("2^3^2") == 64);
+static_assert(evalConstant("  (7 % 4) * -(2) ") == -6);
+static_assert(evalConstant("0 && 1/0") == 0);
+static_assert(evalConstant("1 || 1/0") == 1);
+static_assert(evalConstant("5 > 3 && 2 != 2 || !0") == 1);
+static_assert(evalConstant("2147483647 + 1") == INT32_MIN);
+static_assert(evalConstant<SaturatingInt32Policy>("2147483647 + 1") == INT32_MAX);
+static_assert(evalConstant<Int64Policy>("2^40") == 1099511627776);
+static_assert(evalConstant<Int128Policy>("2^100 / 2^99") == 2);
+static_assert(evalConstant<DoublePolicy>("7/2") == 3.5);
+
+//A StaticExpression against the compiled form of its text, on random rows
+template <FixedString Source, class Policy = Int32Policy>
+static void checkStatic(std::mt19937_64& rng) {
+    using T = typename Policy::value_type;
+    StaticExpression<Source, Policy> expression;
+    typename BasicEvaluator<Policy>::Compiled compiled = BasicEvaluator<Policy>().compile(Source.view());
+    CHECK_EQ(expression.variableCount, compiled.variables().size());
+    for (size_t v = 0; v < expression.variableCount && v < compiled.variables().size(); v++) {
+        CHECK_EQ(expression.variableName(v), compiled.variables()[v]);
+    }
+
+    std::vector<T> values(expression.variableCount);
+    for (int row = 0; row < 500; row++) {
+        for (T& value : values) value = static_cast<T>(static_cast<int>(rng() % 11) - 3);
+        CHECK_EQ(check::outcome([&] { return expression(std::span<const T>(values)); }),
+                 check::outcome([&] { return compiled.run(values); }));
+    }
+    if (expression.variableCount > 0) {
+        std::span<const T> none;
+        CHECK_EQ(check::outcome([&] { return expression(none); }), check::outcome([&] { return compiled.run(none); }));
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(13);
+    checkStatic<"price * qty - discount">(rng);
+    checkStatic<"a / b + a % b">(rng);
+    checkStatic<"b == 0 || a / b > 1">(rng);
+    checkStatic<"a && 10 / b">(rng);
+    checkStatic<"-a ^ b - --c + ++a">(rng);
+    checkStatic<"(a > b) + (a >= b) + (a < b) * 4 + (a <= b) * 8 + (a == b) * 16 + !(a != b)">(rng);
+    checkStatic<"a * a * a * a * a * a * a * a * a * a * a * a", CheckedInt32Policy>(rng);
+    checkStatic<"a - b && a", DoublePolicy>(rng);
+    checkStatic<"a / b - c ^ b", DoublePolicy>(rng);
+    checkStatic<"x ^ 63 + y", Int128Policy>(rng);
+    checkStatic<"42">(rng);
+
+    // The same values passed one by one
+    StaticExpression<"price * qty - discount"> total;
+    CHECK_EQ(total(12, 3, 5), 31);
+    StaticExpression<"x / y"> quotient;
+    CHECK_EQ(check::outcome([&] { return quotient(1, 0); }), "Division by zero @ char 2");
+
+    return check::finish("ConstantExpressionTest");
+}
\ No newline at end of file
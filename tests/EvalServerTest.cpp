@@ -0,0 +1,124 @@
+/**
+ * Evaluation server
+ * Every answer from a BasicEvalServer has to be what eval() gives for the
+ * same text, however the requests are sent: one at a time, through
+ * evalMany() with more in flight than its window, and pipelined from
+ * several connections at once so that batches are large enough to be split
+ * over the pool. Checked for every numeric policy, together with the longest
+ * accepted request, a client of another policy and the server's totals.
+ * Build it next to the library sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/EvalServerTest.cpp BulkIO.cpp CompiledExpression.cpp EvalClient.cpp \
+ *       EvalError.cpp EvalProtocol.cpp EvalServer.cpp Evaluator.cpp ExpressionCache.cpp ExpressionImage.cpp \
+ *       Instrumentation.cpp ThreadPool.cpp -o eval_server_test
+ */
+
+#include "../EvalClient.h"
+#include "../EvalServer.h"
+#include "Check.h"
+#include "Expressions.h"
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+//The outcome of a response, like check::outcome()
+template <class Response>
+static std::string describe(const Response& response) {
+    return response.ok() ? check::text(response.value) : EvalError(response.error, response.position).what();
+}
+
+//Send texts pipelined on a connection of its own and keep the outcomes, in
+//the order of the ids the responses carry
+template <class Policy>
+static void pipeline(const std::string& path, const std::vector<std::string>& texts, std::vector<std::string>& outcomes) {
+    BasicEvalClient<Policy> client(path);
+    typename BasicEvalClient<Policy>::Response response;
+    outcomes.assign(texts.size(), "no response");
+    for (size_t i = 0; i < texts.size(); i++) {
+        client.send(texts[i]);
+        if (i % 100 == 99) {
+            while (client.receive(response, false)) outcomes.at(response.id) = describe(response);
+        }
+    }
+    while (client.receive(response)) outcomes.at(response.id) = describe(response);
+}
+
+template <class Policy>
+static void checkServer(uint64_t seed, const std::string& path) {
+    BasicEvaluator<Policy> evaluator;
+    ExpressionGenerator generator(seed);
+    ThreadPool pool(4);
+    EvalServerLimits limits;
+    limits.maxRequest = 4096;
+    BasicEvalServer<Policy> server(evaluator, path, &pool, limits);
+    std::thread serving([&] { server.run(); });
+    uint64_t requests = 0;
+
+    std::vector<std::string> texts;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 3000; i++) {
+        texts.push_back(generator.expression(3));
+        expected.push_back(check::outcome([&] { return evaluator.eval(texts.back()); }));
+    }
+
+    // One request at a time, then all of them through evalMany()
+    BasicEvalClient<Policy> client(path);
+    for (size_t i = 0; i < 300; i++) {
+        CHECK_EQ(check::outcome([&] { return client.eval(texts[i]); }), expected[i]);
+    }
+    std::vector<std::string_view> views(texts.begin(), texts.end());
+    std::vector<typename BasicEvaluator<Policy>::Result> results = client.evalMany(views);
+    CHECK_EQ(results.size(), texts.size());
+    for (size_t i = 0; i < results.size() && i < texts.size(); i++) {
+        CHECK_EQ(results[i].ok() ? check::text(results[i].value) : results[i].message, expected[i]);
+    }
+    CHECK(client.evalMany({}).empty());
+    requests += 300 + texts.size();
+
+    // Several connections pipelining at once
+    std::vector<std::vector<std::string>> outcomes(4);
+    std::vector<std::thread> clients;
+    for (std::vector<std::string>& outcome : outcomes) {
+        clients.emplace_back([&] { pipeline<Policy>(path, texts, outcome); });
+    }
+    for (std::thread& thread : clients) thread.join();
+    for (const std::vector<std::string>& outcome : outcomes) {
+        for (size_t i = 0; i < texts.size(); i++) CHECK_EQ(outcome[i], expected[i]);
+        requests += texts.size();
+    }
+
+    // The longest request the server takes, and one byte more
+    std::string longest = "1";
+    while (longest.size() + 2 <= limits.maxRequest) longest += "+1";
+    longest.resize(limits.maxRequest, ' ');
+    CHECK_EQ(check::outcome([&] { return client.eval(longest); }), check::outcome([&] { return evaluator.eval(longest); }));
+    CHECK_EQ(check::outcome([&] { return client.eval(longest + " "); }), EvalError(ErrorKind::LimitExceeded).what());
+    requests++;
+
+    // A client of another numeric policy is turned away
+    using Other = std::conditional_t<std::is_same_v<Policy, DoublePolicy>, Int32Policy, DoublePolicy>;
+    bool refused = false;
+    try {
+        BasicEvalClient<Other> other(path);
+    } catch (const std::runtime_error&) {
+        refused = true;
+    }
+    CHECK(refused);
+
+    server.stop();
+    serving.join();
+    CHECK_EQ(server.stats().requests, requests);
+    CHECK_EQ(server.stats().connections, uint64_t(outcomes.size() + 2));
+}
+
+int main() {
+    std::string path = "/tmp/eval_server_test_" + std::to_string(::getpid()) + ".sock";
+    uint64_t seed = 1;
+#define CHECK_POLICY(P) checkServer<P>(seed += 2, path);
+    EVALUATOR_STANDARD_POLICIES(CHECK_POLICY)
+#undef CHECK_POLICY
+
+    return check::finish("EvalServerTest");
+}
\ No newline at end of file
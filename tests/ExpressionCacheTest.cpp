@@ -0,0 +1,121 @@
+/**
+ * Expression cache
+ * Keys drop whitespace that doesn't separate tokens, so differently spaced
+ * texts share one entry; errors found in the key are still reported at
+ * their position in the text that was evaluated. An evaluator with a cache
+ * has to give exactly what one without gives, hit or miss, including after
+ * evictions. Build it next to the library sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/ExpressionCacheTest.cpp CompiledExpression.cpp EvalError.cpp \
+ *       Evaluator.cpp ExpressionCache.cpp Instrumentation.cpp ThreadPool.cpp -o cache_test
+ */
+
+#include "../Evaluator.h"
+#include "../ExpressionCache.h"
+#include "Check.h"
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+//Text and its normalized key
+struct KeyCase {
+    const char* expression;
+    const char* key;
+};
+
+static const KeyCase keyCases[] = {
+    {"1 + 2", "1+2"},
+    {"\t1\n+\r\n2  ", " 1+2"},
+    {"  )1", " )1"},
+    {"1 2", "1 2"},
+    {"12 34 + 5", "12 34+5"},
+    {"rate * hours", "rate*hours"},
+    {"rate hours", "rate hours"},
+    {"- -5", "- -5"},
+    {"+ +5 - + 5", "+ +5-+5"},
+    {"1 < = 2", "1< =2"},
+    {"1 <= 2 != 3", "1<=2!=3"},
+    {"! = 1", "! =1"},
+    {"a & & b | | c", "a& &b| |c"},
+    {"a && b || c", "a&&b||c"},
+    {"", ""},
+    {"   ", " "},
+};
+
+static const char* const expressions[] = {
+    "1 + 2 * 3",
+    "(1 + 2) * 3",
+    "+++2-5*(3^2)",
+    "10 / (5 - 5)",
+    "7 % (2 - 2) + 1",
+    "1 && 2 || 0 / 0",
+    "0 && 1 / 0",
+    "2 ^ 31 - 1",
+    "((1 + 2)",
+    "1 + 2)",
+    ")",
+    "1 +",
+    "* 3",
+    "1 2",
+    "1 * * 2",
+    "3 $ 4",
+    "x + 1",
+    "- - 5",
+    "!!3 >= 1",
+};
+
+//The text with whitespace of random kinds and lengths inserted at random
+//places (which can split numbers and operators as well)
+static std::string respace(const std::string& text, std::mt19937_64& rng) {
+    static const char spaces[] = {' ', ' ', ' ', '\t', '\n', '\r'};
+    std::string spaced;
+    for (size_t i = 0; i <= text.size(); i++) {
+        while (rng() % 4 == 0) spaced += spaces[rng() % std::size(spaces)];
+        if (i < text.size()) spaced += text[i];
+    }
+    return spaced;
+}
+
+int main() {
+    std::string key;
+    for (const KeyCase& known : keyCases) {
+        ExpressionCache::normalize(known.expression, key);
+        CHECK_EQ(key, known.key);
+    }
+
+    // Spacing variants share an entry; leading whitespace is kept apart
+    auto cache = std::make_shared<ExpressionCache>(64, 4);
+    auto first = cache->lookup("1 + 2 * 3");
+    CHECK(cache->lookup("1+2*3") == first);
+    CHECK(cache->lookup(" 1+2*3") != first);
+    CHECK(cache->lookup("\n1 +2\t*3") == cache->lookup(" 1+2*3"));
+    CHECK_EQ(cache->stats().misses, 2u);
+    CHECK_EQ(cache->stats().hits, 3u);
+
+    // Outcomes and error positions match the evaluator without a cache,
+    // for a miss as well as for hits under another spacing
+    Evaluator plain;
+    Evaluator cached(cache);
+    std::mt19937_64 rng(3);
+    for (int round = 0; round < 200; round++) {
+        for (const char* expression : expressions) {
+            std::string text = round == 0 ? expression : respace(expression, rng);
+            std::string expected = check::outcome([&] { return plain.eval(text); });
+            CHECK_EQ(check::outcome([&] { return cached.eval(text); }), expected);
+            CHECK_EQ(check::outcome([&] { return cached.eval(text); }), expected);
+        }
+    }
+
+    // A small cache keeps giving the same outcomes while it evicts
+    auto small = std::make_shared<ExpressionCache>(8, 2);
+    Evaluator evicting(small);
+    for (int i = 0; i < 1000; i++) {
+        std::string text = std::to_string(i % 50) + " / (" + std::to_string(i % 7) + " - 3)";
+        CHECK_EQ(check::outcome([&] { return evicting.eval(text); }),
+                 check::outcome([&] { return plain.eval(text); }));
+    }
+    CHECK(small->stats().size <= small->stats().capacity);
+    CHECK(small->stats().evictions > 0);
+
+    return check::finish("ExpressionCacheTest");
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+/**
+ * Expression images
+ * Expressions saved to an image and mapped back have to run exactly as
+ * their compiled forms do, for values and errors alike, and keep their
+ * variable names and syntax errors. Images for another policy, and
+ * damaged, truncated or foreign files, have to be refused.
+ * Build it next to the library sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/ExpressionImageTest.cpp BulkIO.cpp CompiledExpression.cpp EvalError.cpp \
+ *       Evaluator.cpp ExpressionCache.cpp ExpressionImage.cpp Instrumentation.cpp ThreadPool.cpp -o image_test
+ */
+
+#include "../ExpressionImage.h"
+#include "Check.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+static const std::string_view expressions[] = {
+    "1 + 2 * 3",
+    "+++2-5*(3^2)",
+    "rate * hours + bonus",
+    "hours > 40 && (hours - 40) * rate / 2",
+    "x / y + x % y",
+    "y == 0 || x / y > 1",
+    "-x ^ 3 - --y",
+    "7 / 2",
+    "1 / 0",
+    "2147483647 + x",
+    "99999999999999999999",
+    "a_long_variable_name * another_one_2",
+    "",
+    "1 +",
+    "(x * (y)",
+    "x y",
+    "3 # 4",
+};
+
+//Whether loading path as an image of Policy throws Error
+template <class Policy, class Error>
+static bool refused(const std::string& path) {
+    try {
+        BasicExpressionImage<Policy> image(path);
+    } catch (const Error&) {
+        return true;
+    }
+    return false;
+}
+
+//Save the expressions, map them back and compare them with their compiled forms
+template <class Policy>
+static void checkRoundTrip(const std::string& path) {
+    using T = typename Policy::value_type;
+    BasicEvaluator<Policy> evaluator;
+    BasicExpressionImageWriter<Policy> writer;
+    for (std::string_view expression : expressions) writer.add(expression);
+    writer.save(path);
+
+    BasicExpressionImage<Policy> image(path);
+    CHECK_EQ(image.size(), std::size(expressions));
+    std::mt19937_64 rng(7);
+    for (size_t i = 0; i < image.size(); i++) {
+        typename BasicExpressionImage<Policy>::Expression mapped = image[i];
+        typename BasicEvaluator<Policy>::Compiled compiled;
+        std::string compileError = check::outcome([&] {
+            compiled = evaluator.compile(expressions[i]);
+            return 0;
+        });
+        CHECK_EQ(mapped.ok(), compileError == "0");
+        if (!mapped.ok()) {
+            CHECK_EQ(std::string(mapped.error().what()), compileError);
+            CHECK_EQ(check::outcome([&] { return mapped.run(); }), compileError);
+            continue;
+        }
+
+        CHECK_EQ(mapped.variableCount(), compiled.variables().size());
+        for (size_t v = 0; v < mapped.variableCount(); v++) {
+            CHECK_EQ(mapped.variableName(v), compiled.variables()[v]);
+            CHECK_EQ(mapped.variableIndex(compiled.variables()[v]), static_cast<int>(v));
+        }
+        std::vector<T> values(compiled.variables().size());
+        for (int row = 0; row < 200; row++) {
+            for (T& value : values) value = static_cast<T>(static_cast<int>(rng() % 13) - 3);
+            CHECK_EQ(check::outcome([&] { return mapped.run(values); }),
+                     check::outcome([&] { return compiled.run(values); }));
+        }
+    }
+}
+
+int main() {
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("expression_image_test_" + std::to_string(getpid()) + ".img")).string();
+    std::string damaged = path + ".damaged";
+
+#define CHECK_ROUND_TRIP(P) checkRoundTrip<P>(path);
+    EVALUATOR_STANDARD_POLICIES(CHECK_ROUND_TRIP)
+#undef CHECK_ROUND_TRIP
+
+    // The last image saved is a DoublePolicy one
+    CHECK((!refused<DoublePolicy, std::runtime_error>(path)));
+    CHECK((refused<Int64Policy, std::runtime_error>(path)));
+    CHECK((refused<Int32Policy, std::runtime_error>(path)));
+
+    // An empty image is still an image
+    std::string empty = path + ".empty";
+    ExpressionImageWriter().save(empty);
+    CHECK_EQ(ExpressionImage(empty).size(), 0u);
+    std::filesystem::remove(empty);
+
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    auto writeDamaged = [&](std::string_view contents) {
+        std::ofstream(damaged, std::ios::binary | std::ios::trunc).write(contents.data(), contents.size());
+    };
+
+    // A flipped byte past the header fails the checksum
+    std::string flipped = bytes;
+    flipped[sizeof(ImageHeader) + (flipped.size() - sizeof(ImageHeader)) / 2] ^= 0x40;
+    writeDamaged(flipped);
+    CHECK((refused<DoublePolicy, std::runtime_error>(damaged)));
+
+    writeDamaged(std::string_view(bytes).substr(0, bytes.size() / 2));
+    CHECK((refused<DoublePolicy, std::runtime_error>(damaged)));
+    writeDamaged(std::string_view(bytes).substr(0, sizeof(ImageHeader) / 2));
+    CHECK((refused<DoublePolicy, std::runtime_error>(damaged)));
+    writeDamaged("1 + 2\n3 * 4\n");
+    CHECK((refused<DoublePolicy, std::runtime_error>(damaged)));
+    std::filesystem::remove(damaged);
+    CHECK((refused<DoublePolicy, std::system_error>(damaged)));
+
+    std::filesystem::remove(path);
+    return check::finish("ExpressionImageTest");
+}
\ No newline at end of file
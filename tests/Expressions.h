@@ -0,0 +1,48 @@
+#ifndef TESTS_EXPRESSIONS_H
+#define TESTS_EXPRESSIONS_H
+
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+//class ExpressionGenerator
+//Random, mostly valid expressions over small literals and the given
+//variables, with every operator
+class ExpressionGenerator {
+private:
+    std::mt19937_64 rng;
+    std::vector<std::string> names;
+
+public:
+    explicit ExpressionGenerator(uint64_t seed, std::vector<std::string> variables = {})
+        : rng(seed), names(std::move(variables)) {}
+
+    size_t pick(size_t n) { return static_cast<size_t>(rng() % n); }
+
+    std::string operand() {
+        static const char* literals[] = {"0", "1", "2", "3", "7", "10", "65536", "2147483647"};
+        if (!names.empty() && pick(2) == 0) return names[pick(names.size())];
+        return literals[pick(std::size(literals))];
+    }
+
+    std::string expression(int depth) {
+        static const char* unary[] = {"-", "+", "!", "++", "--"};
+        static const char* binary[] = {"+", "-", "*", "/", "%", "^", "<", "<=", ">",
+                                       ">=", "==", "!=", "&&", "||"};
+        std::string text;
+        if (pick(4) == 0) text += unary[pick(std::size(unary))];
+        text += (depth > 0 && pick(3) == 0) ? "(" + expression(depth - 1) + ")" : operand();
+        for (size_t i = pick(4); i > 0; i--) {
+            text += pick(2) ? " " : "";
+            text += binary[pick(std::size(binary))];
+            text += pick(2) ? " " : "";
+            if (pick(6) == 0) text += unary[pick(std::size(unary))];
+            text += (depth > 0 && pick(3) == 0) ? "(" + expression(depth - 1) + ")" : operand();
+        }
+        return text;
+    }
+};
+
+#endif // TESTS_EXPRESSIONS_H
\ No newline at end of file
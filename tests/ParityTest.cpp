@@ -0,0 +1,369 @@
+/**
+ * Parity of the evaluation paths
+ * Every way of evaluating an expression has to agree with eval(), on the
+ * value as well as on the error and its position: compile().run(),
+ * evalMany() on a thread pool, runBatch() / evalBatch() over columns of
+ * variable values (64-bit columns too on the default evaluator), and the
+ * machine code of NativeExpression, which has to leave programs too deep for
+ * its stack frame to the interpreter. The expressions are a list of edge
+ * cases with known outcomes plus random ones; random expressions with
+ * variables are compared with eval() of the same text with the values
+ * written in. Guarded divisions check that && and || skip their right
+ * operand exactly when the left one decides, row by row in a batch. All of
+ * it runs for every standard policy; under DoublePolicy values include -0,
+ * which every path has to keep or drop alike, and under the integer policies
+ * the smallest and largest values of the type.
+ * Build it next to the library sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/ParityTest.cpp CompiledExpression.cpp EvalError.cpp Evaluator.cpp \
+ *       ExpressionCache.cpp Instrumentation.cpp NativeExpression.cpp ThreadPool.cpp -o parity_test
+ */
+
+#include "../Evaluator.h"
+#include "../NativeExpression.h"
+#include "../ThreadPool.h"
+#include "Check.h"
+#include "Expressions.h"
+#include <algorithm>
+#include <cctype>
+#include <span>
+#include <string>
+#include <vector>
+
+//An expression and what evaluating it gives
+struct KnownOutcome {
+    const char* expression;
+    const char* outcome;
+};
+
+static const KnownOutcome knownOutcomes[] = {
+    {"1+2*3", "7"},
+    {"(1+2)*3", "9"},
+    {"2^3^2", "64"},
+    {"+++2-5*(3^2)", "-42"},
+    {"-2^2", "4"},
+    {"7%3 + 7/2", "4"},
+    {"2 < 3 == 1", "1"},
+    {"!5 || 0", "0"},
+    {"2 && 3", "1"},
+    {"0 && 1/0", "0"},
+    {"1 || 1/0", "1"},
+    {"0 || 1/0", "Division by zero @ char 6"},
+    {"1 && 0 && 1/0", "0"},
+    {"(0 && 1/0) || 5", "1"},
+    {"0 && (1/0 || 1/0)", "0"},
+    {"1/0", "Division by zero @ char 1"},
+    {"5 % (3-3)", "Division by zero @ char 2"},
+    {"", "Empty expression"},
+    {"2 +", "Missing operand @ char 3"},
+    {"(1+2", "Mismatched parentheses"},
+    {"1 2", "Two operands in a row @ char 2"},
+    {"1 * / 2", "Two binary operators in a row @ char 4"},
+    {"1 # 2", "Invalid character @ char 2"},
+    {")1", "Expression can't start with a closing parenthesis @ char 0"},
+};
+
+//Outcomes under DoublePolicy, where a negative zero is a value of its own
+static const KnownOutcome knownDoubleOutcomes[] = {
+    {"7/2", "3.5"},
+    {"-0", "-0"},
+    {"0 * -1", "-0"},
+    {"-0 + 0", "0"},
+    {"-0 - 0", "-0"},
+    {"-0 && 1", "0"},
+    {"1 && -0", "0"},
+    {"-0 || -0", "0"},
+    {"-(0 && 1)", "-0"},
+    {"!-0", "1"},
+    {"-0 == 0", "1"},
+    {"1 % 0", "Division by zero @ char 2"},
+};
+
+//A value as expression text; the smallest integer has no literal of its own
+template <class T>
+static std::string valueText(T value) {
+    if constexpr (!std::is_floating_point_v<T>) {
+        if (value == IntegerLimits<T>::min) return "-" + check::text(IntegerLimits<T>::max) + " - 1";
+    }
+    return check::text(value);
+}
+
+//The expression with each variable replaced by its value in parentheses
+template <class T>
+static std::string substitute(const std::string& expression, const std::vector<std::string>& names,
+                              std::span<const T> values) {
+    std::string bound;
+    for (size_t i = 0; i < expression.size();) {
+        if (!std::isalpha(static_cast<unsigned char>(expression[i]))) {
+            bound += expression[i++];
+            continue;
+        }
+        size_t end = i;
+        while (end < expression.size() && std::isalnum(static_cast<unsigned char>(expression[end]))) end++;
+        size_t index = std::find(names.begin(), names.end(), expression.substr(i, end - i)) - names.begin();
+        bound += "(" + valueText(values[index]) + ")";
+        i = end;
+    }
+    return bound;
+}
+
+//The error of an outcome without its position, which moves when values are
+//written into the expression
+static std::string withoutPosition(const std::string& outcome) {
+    return outcome.substr(0, outcome.find(" @ char "));
+}
+
+//eval() and compile().run() of the same expression
+template <class Policy>
+static void checkCompiled(const BasicEvaluator<Policy>& evaluator, const std::string& expression) {
+    std::string evaluated = check::outcome([&] { return evaluator.eval(expression); });
+    std::string compiled = check::outcome([&] { return evaluator.compile(expression).run(); });
+    CHECK_EQ(compiled, evaluated);
+}
+
+//evalMany() on a pool against eval() one expression at a time; results
+//come back in input order
+static void checkMany(ThreadPool& pool) {
+    Evaluator evaluator;
+    ExpressionGenerator generator(pool.size());
+    std::vector<std::string> texts;
+    for (int i = 0; i < 5000; i++) texts.push_back(generator.expression(3));
+    std::vector<std::string_view> views(texts.begin(), texts.end());
+
+    std::vector<EvalResult> results = evaluator.evalMany(views, pool);
+    CHECK_EQ(results.size(), texts.size());
+    for (size_t i = 0; i < results.size() && i < texts.size(); i++) {
+        std::string expected = check::outcome([&] { return evaluator.eval(texts[i]); });
+        CHECK_EQ(results[i].ok() ? check::text(results[i].value) : results[i].message, expected);
+        if (!results[i].ok()) {
+            CHECK_EQ(EvalError(results[i].error, results[i].position).what(), results[i].message);
+        }
+    }
+    CHECK(evaluator.evalMany({}, pool).empty());
+}
+
+/**
+ * Run an expression with variables over rows of values
+ * Every row through run() has to match eval() of the bound text. runBatch()
+ * and evalBatch() (given the columns in another order) have to give the
+ * same values when no row fails, and otherwise raise the error of one of
+ * the failing rows. The rows span several batch chunks and end in a
+ * partial one. Returns whether any row failed.
+ */
+template <class Policy, class T = typename Policy::value_type>
+static bool checkRows(const BasicEvaluator<Policy>& evaluator, const std::string& expression,
+                      const std::vector<std::vector<T>>& columns, size_t rows) {
+    typename BasicEvaluator<Policy>::Compiled compiled = evaluator.compile(expression);
+    const std::vector<std::string>& names = compiled.variables();
+    std::vector<std::string> outcomes(rows);
+    std::vector<T> row(names.size());
+    bool anyFailed = false;
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t v = 0; v < names.size(); v++) row[v] = columns[v][r];
+        outcomes[r] = check::outcome([&] { return compiled.run(row); });
+        std::string bound = substitute<T>(expression, names, row);
+        std::string evaluated = check::outcome([&] { return evaluator.eval(bound); });
+        CHECK_EQ(withoutPosition(outcomes[r]), withoutPosition(evaluated));
+        anyFailed |= outcomes[r].find(" @ char ") != std::string::npos;
+    }
+
+    std::vector<std::span<const T>> spans(columns.begin(), columns.begin() + names.size());
+    std::vector<BasicColumn<T>> named;
+    for (size_t v = names.size(); v-- > 0;) named.push_back({names[v], columns[v]});
+    std::vector<T> batch(rows);
+    std::vector<T> byName(rows);
+    std::string batchError = check::outcome([&] {
+        compiled.runBatch(spans, batch);
+        return 0;
+    });
+    std::string byNameError = check::outcome([&] {
+        evaluator.evalBatch(expression, named, byName);
+        return 0;
+    });
+    CHECK_EQ(byNameError, batchError);
+    if (!anyFailed) {
+        CHECK_EQ(batchError, "0");
+        for (size_t r = 0; r < rows && batchError == "0"; r++) {
+            CHECK_EQ(check::text(batch[r]), outcomes[r]);
+            CHECK_EQ(check::text(byName[r]), check::text(batch[r]));
+        }
+    } else {
+        CHECK(std::find(outcomes.begin(), outcomes.end(), batchError) != outcomes.end());
+    }
+    return anyFailed;
+}
+
+//evalBatch() of the default evaluator over 64-bit columns: row by row the
+//same as the 64-bit policy, values past 32 bits included
+static void checkWideBatch() {
+    Evaluator evaluator;
+    BasicEvaluator<Int64Policy> wide;
+    ExpressionGenerator generator(5, {"a", "b"});
+    const size_t rows = 300;
+    std::vector<int64_t> a(rows), b(rows), out(rows);
+    for (size_t r = 0; r < rows; r++) {
+        a[r] = static_cast<int64_t>(generator.pick(1000)) << 31 | static_cast<int64_t>(generator.pick(5));
+        b[r] = static_cast<int64_t>(generator.pick(7)) - 3;
+    }
+    const Column columns[] = {{"b", b}, {"a", a}};
+    for (int i = 0; i < 200; i++) {
+        std::string expression = generator.expression(2);
+        std::string error = check::outcome([&] {
+            evaluator.evalBatch(expression, columns, out);
+            return 0;
+        });
+        CHECK_EQ(error, check::outcome([&] {
+            std::vector<int64_t> expected(rows);
+            wide.evalBatch(expression, columns, expected);
+            return 0;
+        }));
+        if (error != "0") continue;
+        BasicEvaluator<Int64Policy>::Compiled compiled = wide.compile(expression);
+        for (size_t r = 0; r < rows; r++) {
+            std::vector<int64_t> row;
+            for (const std::string& name : compiled.variables()) row.push_back(name == "a" ? a[r] : b[r]);
+            CHECK_EQ(check::text(out[r]), check::outcome([&] { return compiled.run(row); }));
+        }
+    }
+    CHECK_EQ(check::outcome([&] {
+        evaluator.evalBatch("a + c", columns, out);
+        return 0;
+    }), "Unknown variable @ char 4");
+}
+
+//Everything but the known outcomes, under one policy
+template <class Policy>
+static void checkPolicy(uint64_t seed) {
+    using T = typename Policy::value_type;
+    BasicEvaluator<Policy> evaluator;
+    ExpressionGenerator generator(seed);
+    for (int i = 0; i < 5000; i++) checkCompiled(evaluator, generator.expression(3));
+
+    // Small values, so that some rows divide by zero and others don't; the
+    // second batch of each expression leaves out zero and negative values
+    const size_t rows = 3 * BasicEvaluator<Policy>::Compiled::BatchChunkSize + 17;
+    ExpressionGenerator withVariables(seed + 1, {"a", "b", "c", "d"});
+    std::vector<std::vector<T>> columns(4, std::vector<T>(rows));
+    for (int i = 0; i < 100; i++) {
+        std::string expression = withVariables.expression(3);
+        for (int lowest : {-3, 1}) {
+            for (std::vector<T>& column : columns) {
+                for (T& value : column) value = static_cast<T>(lowest + static_cast<int>(withVariables.pick(10 - lowest)));
+            }
+            checkRows(evaluator, expression, columns, rows);
+        }
+    }
+
+    // b is 0 exactly where a is: the first chunk is decided by a in every
+    // row, the second in none, the rest in some
+    static const char* guarded[] = {"a && 10 / b", "!a || 10 % b", "(a && 100 / b) + (!a || 7 / b)",
+                                    "a && b && 1 / b || 5", "a && (b || 1 / 0) && 100 / b - a"};
+    for (size_t r = 0; r < rows; r++) {
+        size_t chunk = r / BasicEvaluator<Policy>::Compiled::BatchChunkSize;
+        int a = chunk == 0 ? 0 : chunk == 1 ? static_cast<int>(1 + r % 5) : (r % 3 == 0 ? 0 : 2);
+        columns[0][r] = static_cast<T>(a);
+        columns[1][r] = static_cast<T>(a == 0 ? 0 : static_cast<int>(r % 9) - 9);
+    }
+    for (const char* expression : guarded) CHECK(!checkRows(evaluator, expression, columns, rows));
+
+    // Signed zeros (the same as zeros for the integer policies)
+    static const double signedValues[] = {-0.0, 0.0, -0.0, 1, -1, 2};
+    for (int i = 0; i < 100; i++) {
+        std::string expression = withVariables.expression(2);
+        for (std::vector<T>& column : columns) {
+            for (T& value : column) value = static_cast<T>(signedValues[withVariables.pick(std::size(signedValues))]);
+        }
+        checkRows(evaluator, expression, columns, rows);
+    }
+
+    // The limits of the integer types, where wrapping, checking and
+    // saturating part ways
+    if constexpr (!std::is_floating_point_v<T>) {
+        const T limits[] = {Policy::minValue, static_cast<T>(Policy::minValue + 1), -1, 0, 1, 2,
+                            static_cast<T>(Policy::maxValue - 1), Policy::maxValue};
+        static const char* edges[] = {"-(-a)", "-(-(-a))", "-a * -b", "-(-a) - b", "-a / -1", "a % -1", "a + b",
+                                      "a - b", "a * b", "a / b", "a ^ 2", "a ^ 3 + b", "++a", "--a", "!-a",
+                                      "-a && b", "-(-a) == a"};
+        for (std::vector<T>& column : columns) {
+            for (T& value : column) value = limits[withVariables.pick(std::size(limits))];
+        }
+        for (const char* expression : edges) checkRows(evaluator, expression, columns, rows);
+        for (int i = 0; i < 100; i++) checkRows(evaluator, withVariables.expression(3), columns, rows);
+    }
+}
+
+//Native code against the interpreter, on random rows of small values
+static void checkNative() {
+    BasicEvaluator<Int64Policy> evaluator;
+    ExpressionGenerator generator(100, {"a", "b", "c", "d"});
+    std::vector<int64_t> row(4);
+    size_t lowered = 0;
+    for (int i = 0; i < 3000; i++) {
+        std::string expression = generator.expression(3);
+        NativeExpression::Compiled compiled;
+        try {
+            compiled = evaluator.compile(expression);
+        } catch (const EvalError&) {
+            continue;
+        }
+        std::unique_ptr<NativeExpression> native = NativeExpression::compile(compiled);
+        if (!native) continue;
+        lowered++;
+        for (int r = 0; r < 50; r++) {
+            for (int64_t& value : row) value = static_cast<int64_t>(generator.pick(13)) - 3;
+            std::span<const int64_t> bound(row.data(), compiled.variables().size());
+            CHECK_EQ(check::outcome([&] { return native->run(bound); }),
+                     check::outcome([&] { return compiled.run(bound); }));
+        }
+    }
+    CHECK(lowered > 2000);
+
+    // Nesting that needs the largest frame native code takes, one level
+    // more, and far more; the deeper ones stay with the interpreter, also
+    // once a HotExpression has run them often enough to promote them
+    const size_t largest = NativeExpression::MaxFrameSize / 8;
+    const int64_t values[] = {3, 5};
+    for (size_t depth : {largest - 1, largest, size_t(2000000)}) {
+        std::string expression;
+        for (size_t i = 0; i < depth; i++) expression += "a*b+(";
+        expression += "a" + std::string(depth, ')');
+        NativeExpression::Compiled compiled = evaluator.compile(expression);
+        std::string expected = check::text(static_cast<int64_t>(15 * depth + 3));
+        CHECK_EQ(check::outcome([&] { return compiled.run(values); }), expected);
+
+        std::unique_ptr<NativeExpression> native = NativeExpression::compile(compiled);
+        CHECK_EQ(native != nullptr, compiled.stackDepth() <= largest);
+        if (native) CHECK_EQ(check::outcome([&] { return native->run(values); }), expected);
+
+        HotExpression hot(std::move(compiled), 2);
+        for (int r = 0; r < 4; r++) CHECK_EQ(check::outcome([&] { return hot.run(values); }), expected);
+        CHECK_EQ(hot.isNative(), native != nullptr);
+    }
+}
+
+int main() {
+    Evaluator evaluator;
+    for (const KnownOutcome& known : knownOutcomes) {
+        std::string evaluated = check::outcome([&] { return evaluator.eval(known.expression); });
+        CHECK_EQ(evaluated, known.outcome);
+        checkCompiled(evaluator, known.expression);
+    }
+    BasicEvaluator<DoublePolicy> doubleEvaluator;
+    for (const KnownOutcome& known : knownDoubleOutcomes) {
+        std::string evaluated = check::outcome([&] { return doubleEvaluator.eval(known.expression); });
+        CHECK_EQ(evaluated, known.outcome);
+        checkCompiled(doubleEvaluator, known.expression);
+    }
+
+    ThreadPool pool(4);
+    checkMany(pool);
+    checkMany(ThreadPool::shared());
+    checkWideBatch();
+
+    uint64_t seed = 1;
+#define CHECK_POLICY(P) checkPolicy<P>(seed += 2);
+    EVALUATOR_STANDARD_POLICIES(CHECK_POLICY)
+#undef CHECK_POLICY
+    if (NativeExpression::available()) checkNative();
+
+    return check::finish("ParityTest");
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+/**
+ * Streamed evaluation
+ * An expression fed to a stream evaluator in chunks has to give what eval()
+ * gives for the whole text, value or error and position, wherever the
+ * chunks are cut: inside numbers, names and two-character operators, and in
+ * runs of whitespace. Tokens longer than the join buffer, limits and
+ * evalStream() are covered as well. Build it next to the library sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/StreamEvaluatorTest.cpp CompiledExpression.cpp EvalError.cpp \
+ *       Evaluator.cpp ExpressionCache.cpp Instrumentation.cpp StreamEvaluator.cpp ThreadPool.cpp -o stream_test
+ */
+
+#include "../StreamEvaluator.h"
+#include "Check.h"
+#include "Expressions.h"
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static const char* const expressions[] = {
+    "12345 + 678 * 90",
+    "1 <= 2 && 3 >= 3 || 4 != 4",
+    "10 == 10 && !0",
+    "--5 - ++6 + +-7",
+    "   1   +   2   ",
+    "0 && 1 / 0",
+    "1 / (2 - 2)",
+    "2147483647 + 1",
+    "99999999999999999999999",
+    "x + 1",
+    "1 2",
+    "1 + * 2",
+    "(1 + 2",
+    "1 + 2)",
+    "1 & 2",
+    "1 | 2",
+    "1 = 2",
+    "",
+    "      ",
+    "4 +",
+    ")",
+};
+
+//Feed text in the given chunk sizes (the last one repeats) and finish
+template <class Policy>
+static std::string streamed(std::string_view text, const std::vector<size_t>& sizes, StreamLimits limits = {}) {
+    return check::outcome([&] {
+        BasicStreamEvaluator<Policy> evaluator(limits);
+        for (size_t i = 0; !text.empty(); i += i + 1 < sizes.size()) {
+            size_t size = std::min(text.size(), sizes[i]);
+            evaluator.feed(text.substr(0, size));
+            text.remove_prefix(size);
+        }
+        return evaluator.finish();
+    });
+}
+
+//Every two-chunk cut, fixed chunk sizes and random ones
+template <class Policy>
+static void checkCuts(const std::string& text, std::mt19937_64& rng) {
+    BasicEvaluator<Policy> evaluator;
+    std::string expected = check::outcome([&] { return evaluator.eval(text); });
+    CHECK_EQ(streamed<Policy>(text, {text.size() + 1}), expected);
+    for (size_t cut = 0; cut <= text.size(); cut++) {
+        CHECK_EQ(streamed<Policy>(text, {cut, text.size()}), expected);
+    }
+    for (size_t size : {1, 2, 3, 5}) CHECK_EQ(streamed<Policy>(text, {size}), expected);
+    std::vector<size_t> sizes;
+    for (int i = 0; i < 16; i++) sizes.push_back(rng() % 6);
+    sizes.push_back(text.size());
+    CHECK_EQ(streamed<Policy>(text, sizes), expected);
+}
+
+int main() {
+    std::mt19937_64 rng(11);
+    for (const char* expression : expressions) {
+        checkCuts<Int32Policy>(expression, rng);
+        checkCuts<DoublePolicy>(expression, rng);
+    }
+    ExpressionGenerator generator(12);
+    for (int i = 0; i < 2000; i++) {
+        std::string expression = generator.expression(3);
+        checkCuts<Int32Policy>(expression, rng);
+        checkCuts<CheckedInt64Policy>(expression, rng);
+    }
+
+    // Tokens longer than the part of a chunk joined to them at a time
+    Evaluator evaluator;
+    std::string digits(1000, '7');
+    std::string name(1000, 'v');
+    for (const std::string& text : {digits + " + 1", "1 + " + digits, "1 + " + name, digits + digits}) {
+        std::string expected = check::outcome([&] { return evaluator.eval(text); });
+        for (size_t size : {1, 7, 255, 256, 257, 4096}) CHECK_EQ(streamed<Int32Policy>(text, {size}), expected);
+    }
+
+    // A long chain, at the sizes evalStream() reads and in odd ones
+    std::string chain = "1";
+    while (chain.size() < (1 << 20)) chain += " + 12345 * 3 - 98765 / 5";
+    std::string expected = check::outcome([&] { return evaluator.eval(chain); });
+    CHECK_EQ(streamed<Int32Policy>(chain, {StreamEvaluator::ReadSize}), expected);
+    CHECK_EQ(streamed<Int32Policy>(chain, {4093}), expected);
+    std::istringstream in(chain);
+    CHECK_EQ(check::outcome([&] { return StreamEvaluator::evalStream(in); }), expected);
+
+    // Limits hold and report the same token however the input is cut
+    StreamLimits limits;
+    limits.maxNesting = 3;
+    limits.maxTokenLength = 4;
+    limits.maxStack = 8;
+    const std::pair<const char*, const char*> limited[] = {
+        {"((1))", "1"},
+        {"(((1)))", "1"},
+        {"((((1))))", "Expression exceeds a size limit @ char 3"},
+        {"1234 + 1", "1235"},
+        {"12345 + 1", "Expression exceeds a size limit @ char 0"},
+        {"1 + abcde", "Expression exceeds a size limit @ char 4"},
+        {"1+2+3+4+5+6+7+8+9+10", "55"},
+        {"1-(2-(3-(4-5)))", "3"},
+        {"1||2&&3==4<5+6*7^-8", "1"},
+        {"1||2&&3==4<5+6*7^-!8", "Expression exceeds a size limit @ char 18"},
+    };
+    for (const auto& [text, outcome] : limited) {
+        for (size_t size : {1, 2, 3, 100}) CHECK_EQ(streamed<Int32Policy>(text, {size}, limits), outcome);
+    }
+
+    // No chunks at all is an empty expression
+    CHECK_EQ(streamed<Int32Policy>("", {1}), "Empty expression");
+
+    return check::finish("StreamEvaluatorTest");
+}
\ No newline at end of file
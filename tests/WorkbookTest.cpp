@@ -0,0 +1,165 @@
+/**
+ * Workbooks
+ * After every change a workbook recomputes only what depends on it; the
+ * values and errors of all cells then have to match recomputing every
+ * formula from scratch, with a failed cell passing its error on to the
+ * formulas that name it. Checked on a workbook of a few hundred formulas
+ * under random changes, single threaded and on a pool, and for cycles,
+ * unknown cells and cells changing kind. Build it next to the library
+ * sources, e.g.
+ *   g++ -std=c++20 -O2 -pthread tests/WorkbookTest.cpp CompiledExpression.cpp EvalError.cpp Evaluator.cpp \
+ *       ExpressionCache.cpp Instrumentation.cpp ThreadPool.cpp Workbook.cpp -o workbook_test
+ */
+
+#include "../Workbook.h"
+#include "Check.h"
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+//The outcome of a cell as text, like check::outcome()
+static std::string describe(const Workbook::Result& result) {
+    return result.ok() ? check::text(result.value) : result.message;
+}
+
+//class Model
+//Recomputes every formula from scratch, in an order where the cells a
+//formula names come first
+class Model {
+private:
+    Evaluator evaluator;
+
+public:
+    std::map<std::string, int32_t> inputs;
+    std::vector<std::pair<std::string, std::string>> formulas;  ///< Name and text, named cells first
+
+    //Outcome of every cell
+    std::map<std::string, std::string> outcomes() const {
+        std::map<std::string, std::string> outcome;
+        for (const auto& [name, value] : inputs) outcome[name] = check::text(value);
+        for (const auto& [name, text] : formulas) {
+            Evaluator::Compiled compiled = evaluator.compile(text);
+            std::vector<int32_t> values;
+            std::string failed;
+            for (const std::string& variable : compiled.variables()) {
+                const std::string& named = outcome.at(variable);
+                if (named.find(" @ char ") != std::string::npos) {
+                    failed = named;
+                    break;
+                }
+                values.push_back(static_cast<int32_t>(std::stol(named)));
+            }
+            outcome[name] = failed.empty() ? check::outcome([&] { return compiled.run(values); }) : failed;
+        }
+        return outcome;
+    }
+};
+
+//A random formula over the inputs and the formulas before the index-th
+static std::string randomFormula(std::mt19937_64& rng, size_t index, size_t inputCount) {
+    static const char* operators[] = {" + ", " - ", " * ", " / ", " % ", " > ", " && ", " || "};
+    auto cell = [&] {
+        size_t pick = rng() % (inputCount + index);
+        return pick < inputCount ? "i" + std::to_string(pick) : "f" + std::to_string(pick - inputCount);
+    };
+    std::string text = cell();
+    for (size_t n = rng() % 3; n > 0; n--) {
+        text += operators[rng() % std::size(operators)];
+        text += rng() % 4 == 0 ? std::to_string(rng() % 5) : cell();
+    }
+    return text;
+}
+
+int main() {
+    const size_t inputCount = 8;
+    const size_t formulaCount = 300;
+    std::mt19937_64 rng(17);
+    Model model;
+    ThreadPool pool(4);
+    Workbook serial;
+    Workbook parallel(&pool);
+    Workbook* books[] = {&serial, &parallel};
+
+    auto checkAll = [&] {
+        std::map<std::string, std::string> expected = model.outcomes();
+        for (Workbook* book : books) {
+            CHECK_EQ(book->size(), expected.size());
+            for (const auto& [name, outcome] : expected) CHECK_EQ(describe(book->result(name)), outcome);
+        }
+    };
+
+    for (size_t i = 0; i < inputCount; i++) {
+        std::string name = "i" + std::to_string(i);
+        model.inputs[name] = static_cast<int32_t>(i % 3);
+        for (Workbook* book : books) book->set(name, model.inputs[name]);
+    }
+    for (size_t f = 0; f < formulaCount; f++) {
+        std::string name = "f" + std::to_string(f);
+        std::string text = f < 100 ? "i" + std::to_string(f % inputCount) + " * 2" : randomFormula(rng, f, inputCount);
+        model.formulas.push_back({name, text});
+        for (Workbook* book : books) book->define(name, text);
+    }
+    checkAll();
+
+    for (int round = 0; round < 300; round++) {
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            std::string name = "i" + std::to_string(rng() % inputCount);
+            int32_t value = static_cast<int32_t>(rng() % 8) - 2;
+            model.inputs[name] = value;
+            for (Workbook* book : books) book->set(name, value);
+            break;
+        }
+        case 2: {
+            std::vector<std::string> names;
+            std::vector<Workbook::Assignment> assignments;
+            for (int n = 0; n < 3; n++) names.push_back("i" + std::to_string(rng() % inputCount));
+            for (const std::string& name : names) {
+                int32_t value = static_cast<int32_t>(rng() % 8) - 2;
+                model.inputs[name] = value;
+                assignments.push_back({name, value});
+            }
+            for (Workbook* book : books) book->set(assignments);
+            break;
+        }
+        default: {
+            size_t f = rng() % formulaCount;
+            std::string text = randomFormula(rng, f, inputCount);
+            model.formulas[f].second = text;
+            for (Workbook* book : books) book->define(model.formulas[f].first, text);
+            break;
+        }
+        }
+        checkAll();
+        CHECK(serial.stats().lastEvaluations <= formulaCount);
+    }
+
+    // A cycle is refused and changes nothing
+    for (Workbook* book : books) {
+        CHECK_EQ(check::outcome([&] { book->define("f0", "f299 + f0"); return 0; }), "Circular reference @ char 7");
+        CHECK_EQ(check::outcome([&] { book->define("f0", "1 +"); return 0; }), "Missing operand @ char 3");
+    }
+    checkAll();
+
+    // Naming an unknown cell fails; defining it later repairs the formula
+    Workbook book;
+    book.define("total", "price * qty");
+    CHECK_EQ(describe(book.result("total")), "Unknown variable @ char 0");
+    CHECK_EQ(describe(book.result("price")), "Unknown variable");
+    book.set("price", 12);
+    CHECK_EQ(describe(book.result("total")), "Unknown variable @ char 8");
+    book.define("qty", "2 + 1");
+    CHECK_EQ(describe(book.result("total")), "36");
+    book.set("qty", 0);
+    book.define("unit", "total / qty");
+    CHECK_EQ(describe(book.result("unit")), "Division by zero @ char 6");
+    book.define("report", "unit + 1");
+    CHECK_EQ(describe(book.result("report")), "Division by zero @ char 6");
+    book.set("qty", 4);
+    CHECK_EQ(describe(book.result("report")), "13");
+    CHECK_EQ(book.value("unit"), 12);
+
+    return check::finish("WorkbookTest");
+}
\ No newline at end of file